@@ -183,6 +183,8 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_ALLOW_DES3                   "allow_des3"
 #define KRB5_CONF_ALLOW_RC4                    "allow_rc4"
 #define KRB5_CONF_ALLOW_WEAK_CRYPTO            "allow_weak_crypto"
+#define KRB5_CONF_AUDIT_QUEUE_OVERFLOW         "audit_queue_overflow"
+#define KRB5_CONF_AUDIT_QUEUE_SIZE             "audit_queue_size"
 #define KRB5_CONF_AUTH_TO_LOCAL                "auth_to_local"
 #define KRB5_CONF_AUTH_TO_LOCAL_NAMES          "auth_to_local_names"
 #define KRB5_CONF_CANONICALIZE                 "canonicalize"
@@ -232,6 +234,7 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_IPROP_REPLICA_POLL           "iprop_replica_poll"
 #define KRB5_CONF_IPROP_SLAVE_POLL             "iprop_slave_poll"
 #define KRB5_CONF_IPROP_ULOGSIZE               "iprop_ulogsize"
+#define KRB5_CONF_IPROP_ULOG_SYNC_DELAY        "iprop_ulog_sync_delay"
 #define KRB5_CONF_K5LOGIN_AUTHORITATIVE        "k5login_authoritative"
 #define KRB5_CONF_K5LOGIN_DIRECTORY            "k5login_directory"
 #define KRB5_CONF_KADMIND_LISTEN               "kadmind_listen"
@@ -243,7 +246,10 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_KDC_DEFAULT_OPTIONS          "kdc_default_options"
 #define KRB5_CONF_KDC_LISTEN                   "kdc_listen"
 #define KRB5_CONF_KDC_MAX_DGRAM_REPLY_SIZE     "kdc_max_dgram_reply_size"
+#define KRB5_CONF_KDC_MAX_INFLIGHT             "kdc_max_inflight"
 #define KRB5_CONF_KDC_PORTS                    "kdc_ports"
+#define KRB5_CONF_KDC_SOURCE_BURST             "kdc_source_burst"
+#define KRB5_CONF_KDC_SOURCE_RATE              "kdc_source_rate"
 #define KRB5_CONF_KDC_TCP_PORTS                "kdc_tcp_ports"
 #define KRB5_CONF_KDC_TCP_LISTEN               "kdc_tcp_listen"
 #define KRB5_CONF_KDC_TCP_LISTEN_BACKLOG       "kdc_tcp_listen_backlog"
@@ -265,6 +271,7 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_LDAP_KDC_SASL_MECH           "ldap_kdc_sasl_mech"
 #define KRB5_CONF_LDAP_KDC_SASL_REALM          "ldap_kdc_sasl_realm"
 #define KRB5_CONF_LDAP_KERBEROS_CONTAINER_DN   "ldap_kerberos_container_dn"
+#define KRB5_CONF_LDAP_REPLICA_CACHE           "ldap_replica_cache"
 #define KRB5_CONF_LDAP_SERVERS                 "ldap_servers"
 #define KRB5_CONF_LDAP_SERVICE_PASSWORD_FILE   "ldap_service_password_file"
 #define KRB5_CONF_LIBDEFAULTS                  "libdefaults"
@@ -287,6 +294,7 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_PRIMARY_KDC                  "primary_kdc"
 #define KRB5_CONF_PROXIABLE                    "proxiable"
 #define KRB5_CONF_QUALIFY_SHORTNAME            "qualify_shortname"
+#define KRB5_CONF_QUEUE_SIZE                   "queue_size"
 #define KRB5_CONF_RDNS                         "rdns"
 #define KRB5_CONF_REALMS                       "realms"
 #define KRB5_CONF_REALM_TRY_DOMAINS            "realm_try_domains"
@@ -1384,6 +1392,17 @@ encode_krb5_as_rep(const krb5_kdc_rep *rep, krb5_data **code);
 krb5_error_code
 encode_krb5_tgs_rep(const krb5_kdc_rep *rep, krb5_data **code);
 
+/* Encode an AS-REP or TGS-REP without copying the enc-part ciphertext, whose
+ * data pointer must be hole_data.  Set *hole_out to the location in the
+ * encoding where the ciphertext should be written. */
+krb5_error_code
+k5_encode_as_rep_hole(const krb5_kdc_rep *rep, const void *hole_data,
+                      krb5_data **code, uint8_t **hole_out);
+
+krb5_error_code
+k5_encode_tgs_rep_hole(const krb5_kdc_rep *rep, const void *hole_data,
+                       krb5_data **code, uint8_t **hole_out);
+
 krb5_error_code
 encode_krb5_ap_req(const krb5_ap_req *rep, krb5_data **code);
 
@@ -1590,6 +1609,18 @@ decode_krb5_tgs_rep(const krb5_data *output, krb5_kdc_rep **rep);
 krb5_error_code
 decode_krb5_ap_req(const krb5_data *output, krb5_ap_req **rep);
 
+/*
+ * Decode an AP-REQ with the ticket and authenticator ciphertexts pointing into
+ * output->data rather than copied.  output must remain valid until the result
+ * is freed with k5_free_ap_req_alias().  That function frees only the ASN.1
+ * fields; the caller must free ticket->enc_part2 if it was set.
+ */
+krb5_error_code
+decode_krb5_ap_req_alias(const krb5_data *output, krb5_ap_req **rep);
+
+void
+k5_free_ap_req_alias(const krb5_data *output, krb5_ap_req *rep);
+
 krb5_error_code
 decode_krb5_ap_rep(const krb5_data *output, krb5_ap_rep **rep);
 
@@ -1669,6 +1700,16 @@ decode_krb5_etype_list(const krb5_data *, krb5_etype_list **);
 krb5_error_code
 decode_krb5_pa_fx_fast_request(const krb5_data *, krb5_fast_armored_req **);
 
+/* Decode a PA-FX-FAST request with octet string fields pointing into the
+ * input, which must remain valid until the result is freed with
+ * k5_free_pa_fx_fast_request_alias(). */
+krb5_error_code
+decode_krb5_pa_fx_fast_request_alias(const krb5_data *,
+                                     krb5_fast_armored_req **);
+
+void
+k5_free_pa_fx_fast_request_alias(const krb5_data *, krb5_fast_armored_req *);
+
 krb5_error_code
 decode_krb5_fast_req(const krb5_data *, krb5_fast_req **);
 
@@ -450,6 +450,10 @@ void krb5int_trace(krb5_context context, const char *fmt, ...);
           "not for \"{str}\"", hostname)
 #define TRACE_TLS_SERVER_NAME_MATCH(c, hostname)                        \
     TRACE(c, "TLS certificate name matched \"{str}\"", hostname)
+#define TRACE_TLS_SESSION_RESUME(c, hostname)                           \
+    TRACE(c, "Attempting to resume TLS session with \"{str}\"", hostname)
+#define TRACE_TLS_SESSION_RESUMED(c, hostname)                          \
+    TRACE(c, "Resumed TLS session with \"{str}\"", hostname)
 
 #define TRACE_TKT_CREDS(c, creds, cache)                            \
     TRACE(c, "Getting credentials {creds} using ccache {ccache}",   \
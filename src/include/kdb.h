@@ -131,6 +131,7 @@
 #define KRB5_DB_ITER_WRITE      0x00000001
 #define KRB5_DB_ITER_REV        0x00000002
 #define KRB5_DB_ITER_RECURSE    0x00000004
+#define KRB5_DB_ITER_NAMES_ONLY 0x00000008
 
 /* String attribute names recognized by krb5 */
 #define KRB5_KDB_SK_PAC_PRIVSVR_ENCTYPE         "pac_privsvr_enctype"
@@ -383,13 +384,37 @@ krb5_error_code krb5_db_rename_principal ( krb5_context kcontext,
 /*
  * Iterate over principals in the KDB.  If the callback may write to the DB,
  * the caller must get an exclusive lock with krb5_db_lock before iterating,
- * and release it with krb5_db_unlock after iterating.
+ * and release it with krb5_db_unlock after iterating.  If match_entry is not
+ * NULL, it is a shell-style glob which the module may use to skip principals
+ * which cannot match; the callback must still check each name it receives.
+ * If iterflags contains KRB5_DB_ITER_NAMES_ONLY, the module may pass entries
+ * with only the princ field filled in.
  */
 krb5_error_code krb5_db_iterate ( krb5_context kcontext,
                                   char *match_entry,
                                   int (*func) (krb5_pointer, krb5_db_entry *),
                                   krb5_pointer func_arg, krb5_flags iterflags );
 
+/*
+ * Return the length of the literal prefix of the shell-style glob pattern,
+ * up to the first wildcard or quoting character.  Every principal name
+ * matched by pattern begins with that many bytes of pattern.
+ */
+size_t krb5_db_glob_prefix_len(const char *pattern);
+
+/*
+ * Like krb5_db_iterate, but only invoke func for principals whose unparsed
+ * names sort bytewise after start (or for all principals if start is NULL),
+ * in ascending bytewise order of unparsed name.  Return
+ * KRB5_PLUGIN_OP_NOTSUPP if the module cannot iterate in that order.
+ */
+krb5_error_code krb5_db_iterate_after(krb5_context kcontext,
+                                      char *match_entry, const char *start,
+                                      int (*func)(krb5_pointer,
+                                                  krb5_db_entry *),
+                                      krb5_pointer func_arg,
+                                      krb5_flags iterflags);
+
 
 krb5_error_code krb5_db_store_master_key  ( krb5_context kcontext,
                                             char *keyfile,
@@ -1097,8 +1122,11 @@ typedef struct _kdb_vftabl {
     /*
      * Optional: For each principal entry in the database, invoke func with the
      * arguments func_arg and the entry data.  If match_entry is specified, the
-     * module may narrow the iteration to principal names matching that regular
-     * expression; a module may alternatively ignore match_entry.
+     * module may narrow the iteration to principal names matching that
+     * shell-style glob (krb5_db_glob_prefix_len() can be used to seek to the
+     * first candidate); a module may alternatively ignore match_entry.  If
+     * iterflags contains KRB5_DB_ITER_NAMES_ONLY, the module may skip decoding
+     * everything but the principal name.
      */
     krb5_error_code (*iterate)(krb5_context kcontext,
                                char *match_entry,
@@ -1450,6 +1478,23 @@ typedef struct _kdb_vftabl {
                                  krb5_data ***auth_indicators);
 
     /* End of minor version 0 for major version 9. */
+
+    /*
+     * Optional: Like iterate, but invoke func only for principals whose
+     * unparsed names sort bytewise after start (or for all principals if
+     * start is NULL), in ascending bytewise order of unparsed name.  The
+     * KRB5_DB_ITER_REV and KRB5_DB_ITER_RECURSE flags are not used with this
+     * method.  A module which cannot produce this order for the current
+     * database may return KRB5_PLUGIN_OP_NOTSUPP.
+     */
+    krb5_error_code (*iterate_after)(krb5_context kcontext,
+                                     char *match_entry, const char *start,
+                                     int (*func)(krb5_pointer,
+                                                 krb5_db_entry *),
+                                     krb5_pointer func_arg,
+                                     krb5_flags iterflags);
+
+    /* End of minor version 1 for major version 9. */
 } kdb_vftabl;
 
 #endif /* !defined(_WIN32) */
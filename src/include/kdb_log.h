@@ -19,15 +19,24 @@ extern "C" {
 #endif
 
 /*
- * DB macros
+ * DB macros.  The update log file consists of a header, an index of
+ * kdb_index_len slots locating each retained update by serial number, and a
+ * ring of variable-sized update entries of kdb_data_size bytes.
  */
-#define INDEX(ulog, i) (kdb_ent_header_t *)(void *)                     \
-    ((char *)(ulog) + sizeof(kdb_hlog_t) + (i) * ulog->kdb_block)
+#define ULOG_ALIGN(n) (((n) + 7) & ~(size_t)7)
+#define ULOG_DATA_OFFSET(nslots)                                        \
+    ULOG_ALIGN(sizeof(kdb_hlog_t) + (size_t)(nslots) * sizeof(kdb_ent_index_t))
+#define ULOG_SLOT(ulog, sno) ((kdb_ent_index_t *)(void *)                \
+    ((char *)(ulog) + sizeof(kdb_hlog_t)) + ((sno) - 1) % (ulog)->kdb_index_len)
+#define ULOG_DATA(ulog)                                                 \
+    ((char *)(ulog) + ULOG_DATA_OFFSET((ulog)->kdb_index_len))
+#define ULOG_INDEX_ENTRY(ulog, sno) ((kdb_ent_header_t *)(void *)       \
+    (ULOG_DATA(ulog) + ULOG_SLOT(ulog, sno)->kdb_offset))
 
 /*
  * Current DB version #
  */
-#define KDB_VERSION     1
+#define KDB_VERSION     2
 
 /*
  * DB log states
@@ -48,12 +57,16 @@ extern "C" {
 #define DEF_ULOGENTRIES 1000
 #define ULOG_IDLE_TIME  10              /* in seconds */
 /*
- * Max size of update entry + update header
- * We make this large since resizing can be costly.
+ * Initial entry data space per index slot.  The entry ring grows (up to
+ * MAXLOGLEN) when larger entries would otherwise displace retained updates.
  */
-#define ULOG_BLOCK      2048            /* Default size of principal record */
+#define ULOG_BLOCK      512
 
+#if ULONG_MAX > 0xffffffffUL
+#define MAXLOGLEN       0x40000000      /* 1 GB log file */
+#else
 #define MAXLOGLEN       0x10000000      /* 256 MB log file */
+#endif
 
 /*
  * Prototype declarations
@@ -76,6 +89,9 @@ update_status_t ulog_get_sno_status(krb5_context context,
                                     const kdb_last_t *last);
 krb5_error_code ulog_get_last(krb5_context context, kdb_last_t *last_out);
 krb5_error_code ulog_set_last(krb5_context context, const kdb_last_t *last);
+krb5_error_code ulog_sync(krb5_context context);
+void ulog_begin_batch(krb5_context context);
+void ulog_end_batch(krb5_context context);
 void ulog_fini(krb5_context context);
 
 typedef struct kdb_hlog {
@@ -87,9 +103,16 @@ typedef struct kdb_hlog {
     kdb_sno_t       kdb_first_sno;  /* First serial # in the update log */
     kdb_sno_t       kdb_last_sno;   /* Last serial # in the update log */
     uint16_t        kdb_state;      /* State of update log */
-    uint16_t        kdb_block;      /* Block size of each element */
+    uint32_t        kdb_index_len;  /* # of serial number index slots */
+    uint32_t        kdb_data_size;  /* Size of the entry ring */
+    uint32_t        kdb_data_head;  /* Ring offset for the next entry */
 } kdb_hlog_t;
 
+typedef struct kdb_ent_index {
+    uint32_t        kdb_offset;     /* Ring offset of the entry */
+    uint32_t        kdb_size;       /* Space used by the entry */
+} kdb_ent_index_t;
+
 typedef struct kdb_ent_header {
     uint32_t        kdb_umagic;     /* Update entry magic # */
     kdb_sno_t       kdb_entry_sno;  /* Serial # of entry */
@@ -104,6 +127,14 @@ typedef struct _kdb_log_context {
     kdb_hlog_t      *ulog;
     uint32_t        ulogentries;
     int             ulogfd;
+    /* Group commit: maximum msync latency in milliseconds (0 to sync every
+     * change), and the state of changes not yet synced. */
+    unsigned int    sync_delay;
+    krb5_boolean    sync_pending;
+    kdbe_time_t     sync_since;     /* Time of oldest unsynced change */
+    unsigned long   dirty_start;    /* Unsynced entry range (offsets) */
+    unsigned long   dirty_end;
+    int             batch_depth;    /* Nesting of ulog_begin_batch() calls */
 } kdb_log_context;
 
 #ifdef  __cplusplus
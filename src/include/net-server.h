@@ -73,6 +73,16 @@ krb5_error_code loop_setup_network(verto_ctx *ctx, void *handle,
                                    int tcp_listen_backlog);
 krb5_error_code loop_setup_signals(verto_ctx *ctx, void *handle,
                                    void (*reset)(void *));
+
+/*
+ * Fork num worker processes which share the loop's listener sockets, and
+ * return in each worker with signal handling set up as by
+ * loop_setup_signals(), which the caller should not call itself.  The
+ * calling process supervises the workers, forwarding SIGHUP to them, and
+ * exits once they have terminated; it only returns on error.
+ */
+krb5_error_code loop_create_workers(verto_ctx *ctx, int num, void *handle,
+                                    void (*reset)(void *));
 void loop_free(verto_ctx *ctx);
 
 /* to be supplied by the server application */
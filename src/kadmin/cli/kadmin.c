@@ -1385,6 +1385,353 @@ cleanup:
     free(ks_tuple);
 }
 
+/* Number of changes the batch command sends to the server at once. */
+#define BATCH_SIZE 100
+
+/* A line of a batch file, parsed into a kadm5_batch_op. */
+struct batch_line {
+    int lineno;
+    char *buf;                  /* Copy of the line, split into args */
+    char **args;
+    char *canon;
+};
+
+/* Split line in place into whitespace-separated words, which may be enclosed
+ * in double quotes to include whitespace. */
+static krb5_error_code
+split_line(char *line, char ***args_out, int *argc_out)
+{
+    char **args = NULL, **newargs, *p = line, *word;
+    int argc = 0;
+
+    *args_out = NULL;
+    *argc_out = 0;
+    for (;;) {
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            break;
+        if (*p == '"') {
+            word = ++p;
+            p = strchr(p, '"');
+            if (p == NULL) {
+                free(args);
+                return EINVAL;
+            }
+        } else {
+            word = p;
+            while (*p != '\0' && !isspace((unsigned char)*p))
+                p++;
+        }
+        if (*p != '\0')
+            *p++ = '\0';
+        newargs = realloc(args, (argc + 2) * sizeof(*args));
+        if (newargs == NULL) {
+            free(args);
+            return ENOMEM;
+        }
+        args = newargs;
+        args[argc++] = word;
+        args[argc] = NULL;
+    }
+    *args_out = args;
+    *argc_out = argc;
+    return 0;
+}
+
+static void
+free_batch_line(kadm5_batch_op *op, struct batch_line *bl)
+{
+    krb5_free_principal(context, op->rec.principal);
+    kadmin_free_tl_data(&op->rec.n_tl_data, &op->rec.tl_data);
+    free(op->ks_tuple);
+    free(bl->canon);
+    free(bl->args);
+    free(bl->buf);
+    memset(op, 0, sizeof(*op));
+    memset(bl, 0, sizeof(*bl));
+}
+
+/* Parse the arguments of a change_password -randkey command into op. */
+static int
+parse_batch_randkey(int argc, char *argv[], kadm5_batch_op *op)
+{
+    krb5_boolean randkey = FALSE;
+    int i;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-randkey")) {
+            randkey = TRUE;
+        } else if (!strcmp(argv[i], "-keepold")) {
+            op->keepold = TRUE;
+        } else if (!strcmp(argv[i], "-e") && i + 1 < argc - 1 &&
+                   op->ks_tuple == NULL) {
+            if (krb5_string_to_keysalts(argv[++i], NULL, NULL, 0,
+                                        &op->ks_tuple, &op->n_ks_tuple))
+                return -1;
+        } else {
+            return -1;
+        }
+    }
+    if (!randkey || argc < 2)
+        return -1;
+    return kadmin_parse_name(argv[argc - 1], &op->rec.principal) ? -1 : 0;
+}
+
+/*
+ * Parse a batch file command into op.  default_policy caches whether the
+ * "default" policy exists (-1 if not yet known).  Return -1 if the command is
+ * invalid.  Attribute flags in a modify_principal command are resolved later
+ * by resolve_batch_attributes().
+ */
+static kadm5_ret_t
+parse_batch_command(int argc, char *argv[], kadm5_batch_op *op,
+                    int *default_policy)
+{
+    krb5_boolean randkey, nokey;
+    const char *cmd = argv[0];
+    char *pass;
+
+    if (!strcmp(cmd, "add_principal") || !strcmp(cmd, "addprinc") ||
+        !strcmp(cmd, "ank")) {
+        op->op = KADM5_BATCH_CREATE;
+        if (kadmin_parse_princ_args(argc, argv, &op->rec, &op->mask, &pass,
+                                    &randkey, &nokey, &op->ks_tuple,
+                                    &op->n_ks_tuple, "batch"))
+            return -1;
+        if (nokey) {
+            pass = NULL;
+            op->mask |= KADM5_KEY_DATA;
+        } else if (randkey) {
+            pass = NULL;
+        } else if (pass == NULL) {
+            /* We can't prompt for passwords in a batch. */
+            return -1;
+        }
+        if (!(op->mask & (KADM5_POLICY | KADM5_POLICY_CLR))) {
+            if (*default_policy == -1)
+                *default_policy = policy_exists("default");
+            if (*default_policy) {
+                op->rec.policy = "default";
+                op->mask |= KADM5_POLICY;
+            }
+        }
+        op->mask &= ~KADM5_POLICY_CLR;
+        op->mask |= KADM5_PRINCIPAL;
+        op->password = pass;
+    } else if (!strcmp(cmd, "modify_principal") ||
+               !strcmp(cmd, "modprinc")) {
+        op->op = KADM5_BATCH_MODIFY;
+        if (kadmin_parse_princ_args(argc, argv, &op->rec, &op->mask, &pass,
+                                    &randkey, &nokey, &op->ks_tuple,
+                                    &op->n_ks_tuple, "batch"))
+            return -1;
+        if (op->ks_tuple != NULL || randkey || nokey || pass != NULL)
+            return -1;
+    } else if (!strcmp(cmd, "change_password") || !strcmp(cmd, "cpw")) {
+        op->op = KADM5_BATCH_RANDKEY;
+        if (parse_batch_randkey(argc, argv, op))
+            return -1;
+    } else if (!strcmp(cmd, "delete_principal") ||
+               !strcmp(cmd, "delprinc")) {
+        op->op = KADM5_BATCH_DELETE;
+        if (!(argc == 2 || (argc == 3 && !strcmp(argv[1], "-force"))))
+            return -1;
+        if (kadmin_parse_name(argv[argc - 1], &op->rec.principal))
+            return -1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Principal attribute flags in a modify_principal command are applied to the
+ * principal's current attributes.  Retrieve them and parse the command again
+ * on top of them.  Return -1 if the command is invalid.
+ */
+static kadm5_ret_t
+resolve_batch_attributes(int argc, char *argv[], kadm5_batch_op *op)
+{
+    kadm5_principal_ent_rec oldprinc;
+    krb5_boolean randkey, nokey;
+    krb5_error_code retval;
+    char *pass;
+
+    retval = kadm5_get_principal(handle, op->rec.principal, &oldprinc,
+                                 KADM5_ATTRIBUTES);
+    if (retval)
+        return retval;
+    krb5_free_principal(context, op->rec.principal);
+    kadmin_free_tl_data(&op->rec.n_tl_data, &op->rec.tl_data);
+    memset(&op->rec, 0, sizeof(op->rec));
+    op->rec.attributes = oldprinc.attributes;
+    kadm5_free_principal_ent(handle, &oldprinc);
+    if (kadmin_parse_princ_args(argc, argv, &op->rec, &op->mask, &pass,
+                                &randkey, &nokey, &op->ks_tuple,
+                                &op->n_ks_tuple, "batch"))
+        return -1;
+    return 0;
+}
+
+/* Return true if any of the first n ops in ops changes princ. */
+static krb5_boolean
+batch_touches(kadm5_batch_op *ops, int n, krb5_principal princ)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (krb5_principal_compare(context, ops[i].rec.principal, princ))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Report the result of a batch change. */
+static void
+report_batch_result(kadm5_batch_op *op, struct batch_line *bl,
+                    kadm5_ret_t result)
+{
+    const char *canon = bl->canon;
+    int lineno = bl->lineno;
+
+    if (op->op == KADM5_BATCH_CREATE) {
+        if (result) {
+            com_err("batch", result, _("while creating \"%s\" (line %d)"),
+                    canon, lineno);
+        } else {
+            info(_("Principal \"%s\" created.\n"), canon);
+        }
+    } else if (op->op == KADM5_BATCH_MODIFY) {
+        if (result) {
+            com_err("batch", result, _("while modifying \"%s\" (line %d)"),
+                    canon, lineno);
+        } else {
+            info(_("Principal \"%s\" modified.\n"), canon);
+        }
+    } else if (op->op == KADM5_BATCH_RANDKEY) {
+        if (result) {
+            com_err("batch", result,
+                    _("while randomizing key for \"%s\" (line %d)"), canon,
+                    lineno);
+        } else {
+            info(_("Key for \"%s\" randomized.\n"), canon);
+        }
+    } else {
+        if (result) {
+            com_err("batch", result,
+                    _("while deleting principal \"%s\" (line %d)"), canon,
+                    lineno);
+        } else {
+            info(_("Principal \"%s\" deleted.\n"), canon);
+        }
+    }
+}
+
+/* Send the parsed changes to the server and report the result of each. */
+static void
+flush_batch(kadm5_batch_op *ops, struct batch_line *lines, int n)
+{
+    kadm5_ret_t results[BATCH_SIZE];
+    kadm5_ret_t retval;
+    int i;
+
+    if (n == 0)
+        return;
+    retval = kadm5_batch(handle, ops, n, results);
+    if (retval) {
+        com_err("batch", retval, _("while applying lines %d-%d"),
+                lines[0].lineno, lines[n - 1].lineno);
+    }
+    for (i = 0; i < n; i++) {
+        if (!retval)
+            report_batch_result(&ops[i], &lines[i], results[i]);
+        free_batch_line(&ops[i], &lines[i]);
+    }
+}
+
+void
+kadmin_batch(int argc, char *argv[], int sci_idx, void *info_ptr)
+{
+    kadm5_batch_op ops[BATCH_SIZE];
+    struct batch_line lines[BATCH_SIZE], *bl;
+    char buf[8192];
+    int n = 0, lineno = 0, largc, default_policy = -1;
+    kadm5_ret_t retval;
+    FILE *fp;
+
+    if (argc != 2) {
+        error(_("usage: batch filename\n"));
+        return;
+    }
+    fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        com_err("batch", errno, _("while opening %s"), argv[1]);
+        return;
+    }
+
+    memset(ops, 0, sizeof(ops));
+    memset(lines, 0, sizeof(lines));
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        lineno++;
+        if (strchr(buf, '\n') == NULL && !feof(fp)) {
+            error(_("batch: line %d is too long\n"), lineno);
+            break;
+        }
+        bl = &lines[n];
+        bl->lineno = lineno;
+        bl->buf = strdup(buf);
+        if (bl->buf == NULL ||
+            split_line(bl->buf, &bl->args, &largc) != 0) {
+            error(_("batch: line %d: cannot parse line\n"), lineno);
+            free_batch_line(&ops[n], bl);
+            continue;
+        }
+        if (largc == 0 || *bl->args[0] == '#') {
+            free_batch_line(&ops[n], bl);
+            continue;
+        }
+        retval = parse_batch_command(largc, bl->args, &ops[n],
+                                     &default_policy);
+        if (!retval && ops[n].op == KADM5_BATCH_MODIFY &&
+            (ops[n].mask & KADM5_ATTRIBUTES)) {
+            /* Apply the queued changes to this principal before reading its
+             * current attributes, so that they are not lost. */
+            if (batch_touches(ops, n, ops[n].rec.principal)) {
+                flush_batch(ops, lines, n);
+                ops[0] = ops[n];
+                lines[0] = lines[n];
+                memset(&ops[n], 0, sizeof(ops[n]));
+                memset(&lines[n], 0, sizeof(lines[n]));
+                n = 0;
+                bl = &lines[0];
+            }
+            retval = resolve_batch_attributes(largc, bl->args, &ops[n]);
+        }
+        if (!retval) {
+            retval = krb5_unparse_name(context, ops[n].rec.principal,
+                                       &bl->canon);
+        }
+        if (retval == -1) {
+            error(_("batch: line %d: invalid %s command\n"), lineno,
+                  bl->args[0]);
+        } else if (retval) {
+            com_err("batch", retval, _("while reading \"%s\" (line %d)"),
+                    bl->args[largc - 1], lineno);
+        }
+        if (retval) {
+            free_batch_line(&ops[n], bl);
+            continue;
+        }
+        if (++n == BATCH_SIZE) {
+            flush_batch(ops, lines, n);
+            n = 0;
+        }
+    }
+    flush_batch(ops, lines, n);
+    fclose(fp);
+}
+
 void
 kadmin_getprinc(int argc, char *argv[], int sci_idx, void *info_ptr)
 {
@@ -1521,26 +1868,28 @@ cleanup:
     free(modprincstr);
 }
 
+static void
+print_name(void *data, const char *name)
+{
+    printf("%s\n", name);
+}
+
 void
 kadmin_getprincs(int argc, char *argv[], int sci_idx, void *info_ptr)
 {
     krb5_error_code retval;
-    char *expr, **names;
-    int i, count;
+    char *expr;
 
     expr = NULL;
     if (!(argc == 1 || (argc == 2 && (expr = argv[1])))) {
         error(_("usage: get_principals [expression]\n"));
         return;
     }
-    retval = kadm5_get_principals(handle, expr, &names, &count);
+    retval = kadm5_iter_principals(handle, expr, print_name, NULL);
     if (retval) {
         com_err("get_principals", retval, _("while retrieving list."));
         return;
     }
-    for (i = 0; i < count; i++)
-        printf("%s\n", names[i]);
-    kadm5_free_name_list(handle, names, count);
 }
 
 static int
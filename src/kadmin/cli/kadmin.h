@@ -47,6 +47,7 @@ extern void kadmin_addprinc(int argc, char *argv[], int sci_idx,
                             void *info_ptr);
 extern void kadmin_modprinc(int argc, char *argv[], int sci_idx,
                             void *info_ptr);
+extern void kadmin_batch(int argc, char *argv[], int sci_idx, void *info_ptr);
 extern void kadmin_getprinc(int argc, char *argv[], int sci_idx,
                             void *info_ptr);
 extern void kadmin_getprincs(int argc, char *argv[], int sci_idx,
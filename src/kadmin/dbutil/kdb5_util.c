@@ -55,6 +55,7 @@
 
 #include <k5-int.h>
 #include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
 #include <locale.h>
 #include <adm_proto.h>
 #include <time.h>
@@ -99,6 +100,7 @@ void usage(void)
             _("\tupdate_princ_encryption [-f] [-n] [-v] [princ-pattern]\n"
               "\tpurge_mkeys [-f] [-n] [-v]\n"
               "\ttabdump [-H] [-c] [-e] [-n] [-o outfile] dumptype\n"
+              "\tcompile_dict wordfile dictfile\n"
               "\nwhere,\n\t[-x db_args]* - any number of database specific "
               "arguments.\n"
               "\t\t\tLook at each database documentation for supported "
@@ -120,6 +122,7 @@ krb5_boolean dbactive = FALSE;
 static int open_db_and_mkey(void);
 
 static void add_random_key(int, char **);
+static void compile_dict(int, char **);
 
 typedef void (*cmd_func)(int, char **);
 
@@ -140,6 +143,7 @@ struct _cmd_table {
     {"update_princ_encryption", kdb5_update_princ_encryption, 1},
     {"purge_mkeys", kdb5_purge_mkeys, 1},
     {"tabdump", tabdump, 1},
+    {"compile_dict", compile_dict, 0},
     {NULL, NULL, 0},
 };
 
@@ -609,3 +613,20 @@ add_random_key(int argc, char **argv)
     }
     printf(_("%s changed\n"), pr_str);
 }
+
+static void
+compile_dict(int argc, char **argv)
+{
+    krb5_error_code ret;
+    size_t count;
+
+    if (argc != 3)
+        usage();
+    ret = k5_pwqual_compile_dict(util_context, argv[1], argv[2], &count);
+    if (ret) {
+        com_err(progname, ret, _("while compiling dictionary %s"), argv[2]);
+        exit_status++;
+        return;
+    }
+    printf(_("%lu words written to %s\n"), (unsigned long)count, argv[2]);
+}
@@ -59,6 +59,8 @@ kadm_1(struct svc_req *rqstp, SVCXPRT *transp)
 	  setkey3_arg setkey_principal3_2_arg;
 	  setkey4_arg setkey_principal4_2_arg;
 	  getpkeys_arg get_principal_keys_2_arg;
+	  gprincs_page_arg get_princs_page_2_arg;
+	  batch_arg batch_principals_2_arg;
      } argument;
      union {
 	  generic_ret gen_ret;
@@ -71,6 +73,8 @@ kadm_1(struct svc_req *rqstp, SVCXPRT *transp)
 	  chrand_ret chrand_principal3_2_ret;
 	  gstrings_ret get_string_2_ret;
 	  getpkeys_ret get_principal_keys_ret;
+	  gprincs_page_ret get_princs_page_2_ret;
+	  batch_ret batch_principals_2_ret;
      } result;
      bool_t retval;
      xdrproc_t xdr_argument, xdr_result;
@@ -241,6 +245,18 @@ kadm_1(struct svc_req *rqstp, SVCXPRT *transp)
 	  local = (bool_t (*)(char *, void *, struct svc_req *))get_principal_keys_2_svc;
 	  break;
 
+     case GET_PRINCS_PAGE:
+	  xdr_argument = (xdrproc_t)xdr_gprincs_page_arg;
+	  xdr_result = (xdrproc_t)xdr_gprincs_page_ret;
+	  local = (bool_t (*)(char *, void *, struct svc_req *))get_princs_page_2_svc;
+	  break;
+
+     case BATCH_PRINCIPALS:
+	  xdr_argument = (xdrproc_t)xdr_batch_arg;
+	  xdr_result = (xdrproc_t)xdr_batch_ret;
+	  local = (bool_t (*)(char *, void *, struct svc_req *))batch_principals_2_svc;
+	  break;
+
      default:
 	  krb5_klog_syslog(LOG_ERR, "Invalid KADM5 procedure number: %s, %d",
 			   client_addr(rqstp->rq_xprt), rqstp->rq_proc);
@@ -75,6 +75,7 @@ char *kprop_port = NULL;
 
 static krb5_context context;
 static char *progname;
+static int workers = 0;
 
 static void
 usage(void)
@@ -83,6 +84,7 @@ usage(void)
                       "[-port port-number]\n"
                       "\t\t[-proponly] [-p path-to-kdb5_util] [-F dump-file]\n"
                       "\t\t[-K path-to-kprop] [-k kprop-port] [-P pid_file]\n"
+                      "\t\t[-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -129,8 +131,17 @@ write_pid_file(const char *pid_file)
     return st1 ? st1 : st2;
 }
 
+/* Periodically sync update log changes deferred by group commit, so that no
+ * change waits longer than iprop_ulog_sync_delay while kadmind is idle. */
+static void
+sync_ulog(verto_ctx *ctx, verto_ev *ev)
+{
+    (void)ulog_sync(context);
+}
+
 /* Set up the main loop.  If proponly is set, don't set up ports for kpasswd or
- * kadmin.  May set *ctx_out even on error. */
+ * kadmin.  Signal handlers are set up later if worker processes will be
+ * created.  May set *ctx_out even on error. */
 static krb5_error_code
 setup_loop(kadm5_config_params *params, int proponly, verto_ctx **ctx_out)
 {
@@ -140,9 +151,11 @@ setup_loop(kadm5_config_params *params, int proponly, verto_ctx **ctx_out)
     *ctx_out = ctx = loop_init(VERTO_EV_TYPE_SIGNAL);
     if (ctx == NULL)
         return ENOMEM;
-    ret = loop_setup_signals(ctx, &global_server_handle, NULL);
-    if (ret)
-        return ret;
+    if (workers == 0) {
+        ret = loop_setup_signals(ctx, &global_server_handle, NULL);
+        if (ret)
+            return ret;
+    }
     if (!proponly) {
         ret = loop_add_udp_address(params->kpasswd_port,
                                    params->kpasswd_listen);
@@ -429,6 +442,13 @@ main(int argc, char *argv[])
             if (!argc)
                 usage();
             kprop_port = *argv;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--, argv++;
+            if (!argc)
+                usage();
+            workers = atoi(*argv);
+            if (workers <= 0)
+                usage();
         } else {
             break;
         }
@@ -516,6 +536,14 @@ main(int argc, char *argv[])
             fail_to_start(ret, _("creating PID file"));
     }
 
+    /* Each worker process serves requests on its own connections with its own
+     * server handle.  The KDB and update log are locked across processes. */
+    if (workers > 0) {
+        ret = loop_create_workers(vctx, workers, &global_server_handle, NULL);
+        if (ret)
+            fail_to_start(ret, _("creating worker processes"));
+    }
+
     ret = kadm5_init(context, "kadmind", NULL, NULL, &params,
                      KADM5_STRUCT_VERSION, KADM5_API_VERSION_4, db_args,
                      &global_server_handle);
@@ -529,6 +557,11 @@ main(int argc, char *argv[])
         if (ret)
             fail_to_start(ret, _("mapping update log"));
 
+        if (context->kdblog_context->sync_delay > 0 &&
+            verto_add_timeout(vctx, VERTO_EV_FLAG_PERSIST, sync_ulog,
+                              context->kdblog_context->sync_delay) == NULL)
+            fail_to_start(ENOMEM, _("setting up update log sync timer"));
+
         if (nofork) {
             fprintf(stderr,
                     _("%s: create IPROP svc (PROG=%d, VERS=%d)\n"),
@@ -11,6 +11,7 @@
 #include <krb5.h>
 #include <kadm5/admin.h>
 #include <kadm5/kadm_rpc.h>
+#include <kadm5/admin_xdr.h>
 #include <kadm5/server_internal.h>
 #include <syslog.h>
 #include <adm_proto.h>  /* krb5_klog_syslog */
@@ -792,6 +793,121 @@ exit_func:
     return TRUE;
 }
 
+bool_t
+get_princs_page_2_svc(gprincs_page_arg *arg, gprincs_page_ret *ret,
+                      struct svc_req *rqstp)
+{
+    char                            *prime_arg = NULL;
+    gss_buffer_desc                 client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc                 service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t           handle;
+    const char                      *errmsg = NULL;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    prime_arg = arg->exp;
+    if (prime_arg == NULL)
+        prime_arg = "*";
+
+    if (CHANGEPW_SERVICE(rqstp) ||
+        !stub_auth(handle, OP_LISTPRINCS, NULL, NULL, NULL, NULL)) {
+        ret->code = KADM5_AUTH_LIST;
+        log_unauth("kadm5_get_principals_page", prime_arg,
+                   &client_name, &service_name, rqstp);
+    } else {
+        ret->code = kadm5_get_principals_page(handle, arg->exp, arg->after,
+                                              arg->max, &ret->princs,
+                                              &ret->count, &ret->more);
+        if (ret->code != 0)
+            errmsg = krb5_get_error_message(handle->context, ret->code);
+
+        /* Log only the first page of a listing. */
+        if (arg->after == NULL || ret->code != 0) {
+            log_done("kadm5_get_principals_page", prime_arg, errmsg,
+                     &client_name, &service_name, rqstp);
+        }
+
+        if (errmsg != NULL)
+            krb5_free_error_message(handle->context, errmsg);
+    }
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
+/*
+ * Perform each item of a batch as if it were a separate request, so that each
+ * is authorized and logged individually, but hold the database lock and defer
+ * update log syncs across the batch.
+ */
+bool_t
+batch_principals_2_svc(batch_arg *arg, batch_ret *ret, struct svc_req *rqstp)
+{
+    gss_buffer_desc                 client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc                 service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t           handle;
+    batch_item                      *item;
+    generic_ret                     gret;
+    chrand_ret                      cret;
+    krb5_boolean                    locked;
+    int                             i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    if (arg->n_items < 0 || arg->n_items > KADM5_MAX_BATCH) {
+        ret->code = EINVAL;
+        goto exit_func;
+    }
+    if (arg->n_items == 0)
+        goto exit_func;
+    ret->codes = calloc(arg->n_items, sizeof(*ret->codes));
+    if (ret->codes == NULL) {
+        ret->code = ENOMEM;
+        goto exit_func;
+    }
+
+    locked = kdb_begin_batch(handle);
+    for (i = 0; i < arg->n_items; i++) {
+        item = &arg->items[i];
+        memset(&gret, 0, sizeof(gret));
+        switch (item->op) {
+        case KADM5_BATCH_CREATE:
+            create_principal3_2_svc(&item->u.cprinc, &gret, rqstp);
+            ret->codes[i] = gret.code;
+            break;
+        case KADM5_BATCH_MODIFY:
+            modify_principal_2_svc(&item->u.mprinc, &gret, rqstp);
+            ret->codes[i] = gret.code;
+            break;
+        case KADM5_BATCH_RANDKEY:
+            memset(&cret, 0, sizeof(cret));
+            chrand_principal3_2_svc(&item->u.chrand, &cret, rqstp);
+            ret->codes[i] = cret.code;
+            xdr_free((xdrproc_t)xdr_chrand_ret, &cret);
+            break;
+        case KADM5_BATCH_DELETE:
+            delete_principal_2_svc(&item->u.dprinc, &gret, rqstp);
+            ret->codes[i] = gret.code;
+            break;
+        }
+    }
+    kdb_end_batch(handle, locked);
+    ret->n_codes = arg->n_items;
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
 bool_t
 chpass_principal_2_svc(chpass_arg *arg, generic_ret *ret,
                        struct svc_req *rqstp)
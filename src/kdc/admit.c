@@ -0,0 +1,297 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/admit.c - Admission control for incoming KDC requests */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Admission control sheds excess load before a request is decoded, so that a
+ * flood from a few sources cannot starve everyone else.  Two limits may be
+ * configured in [kdcdefaults]:
+ *
+ * - kdc_source_rate and kdc_source_burst give each source address a token
+ *   bucket.  A TGS request costs one token and an AS request, which is more
+ *   expensive to process, costs two.
+ *
+ * - kdc_max_inflight limits the number of requests in progress at once.
+ *   Only AS requests can wait (for asynchronous preauth modules), so only AS
+ *   requests are refused at the limit; TGS requests run to completion and
+ *   are always admitted.
+ *
+ * Lookaside cache hits are answered before admission control is applied.
+ * The state is per process; with worker processes, each worker applies the
+ * limits to the requests it receives.
+ */
+
+#include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
+#include "kdc_util.h"
+#include "extern.h"
+#include "adm_proto.h"
+#include <syslog.h>
+
+/* Token amounts are kept in thousandths of a token. */
+#define TOKEN           1000
+#define TGS_COST        (1 * TOKEN)
+#define AS_COST         (2 * TOKEN)
+
+#ifndef ADMIT_MAX_SOURCES
+#define ADMIT_MAX_SOURCES 65536
+#endif
+
+/* How often to report shed requests, in milliseconds. */
+#define REPORT_INTERVAL (60 * 1000)
+
+struct source {
+    K5_TAILQ_ENTRY(source) links;
+    int64_t tokens;
+    int64_t last;               /* Time of last refill, in milliseconds */
+    size_t addrlen;
+    uint8_t addr[16];
+};
+
+K5_TAILQ_HEAD(source_queue, source);
+
+static struct k5_hashtab *source_table;
+static struct source_queue lru_queue;
+static int num_sources;
+
+static krb5_int32 source_rate;          /* Tokens per second, or 0 */
+static krb5_int32 source_burst;         /* Bucket capacity in tokens */
+static krb5_int32 max_inflight;         /* Or 0 for no limit */
+static int inflight;
+
+static unsigned long shed_rate_as, shed_rate_tgs, shed_inflight;
+static int64_t last_report;
+
+/* Return the current time in milliseconds, or -1 on error. */
+static int64_t
+now_ms(krb5_context context)
+{
+    krb5_timestamp sec;
+    krb5_int32 usec;
+
+    if (krb5_us_timeofday(context, &sec, &usec) != 0)
+        return -1;
+    return (int64_t)ts2tt(sec) * 1000 + usec / 1000;
+}
+
+/* Return the number of tokens src would hold at time now. */
+static int64_t
+refilled(const struct source *src, int64_t now)
+{
+    int64_t elapsed = now - src->last, max = (int64_t)source_burst * TOKEN;
+
+    /* Don't refill if the clock went backwards; cap elapsed so that the
+     * product below cannot overflow. */
+    if (elapsed <= 0)
+        return src->tokens;
+    if (elapsed > (int64_t)source_burst * 1000)
+        return max;
+    return min(max, src->tokens + elapsed * source_rate);
+}
+
+static void
+discard_source(struct source *src)
+{
+    k5_hashtab_remove(source_table, src->addr, src->addrlen);
+    K5_TAILQ_REMOVE(&lru_queue, src, links);
+    num_sources--;
+    free(src);
+}
+
+/*
+ * Return the bucket for addr, creating a full one if necessary.  Sources whose
+ * buckets have refilled completely are discarded first, since a full bucket is
+ * equivalent to no entry.  If the table is still full, discard the least
+ * recently used source.
+ */
+static struct source *
+get_source(const krb5_address *addr, int64_t now)
+{
+    struct source *src, *next;
+
+    src = k5_hashtab_get(source_table, addr->contents, addr->length);
+    if (src != NULL) {
+        K5_TAILQ_REMOVE(&lru_queue, src, links);
+        K5_TAILQ_INSERT_TAIL(&lru_queue, src, links);
+        return src;
+    }
+
+    K5_TAILQ_FOREACH_SAFE(src, &lru_queue, links, next) {
+        if (refilled(src, now) < (int64_t)source_burst * TOKEN &&
+            num_sources < ADMIT_MAX_SOURCES)
+            break;
+        discard_source(src);
+    }
+
+    src = calloc(1, sizeof(*src));
+    if (src == NULL)
+        return NULL;
+    src->tokens = (int64_t)source_burst * TOKEN;
+    src->last = now;
+    src->addrlen = addr->length;
+    memcpy(src->addr, addr->contents, addr->length);
+    if (k5_hashtab_add(source_table, src->addr, src->addrlen, src) != 0) {
+        free(src);
+        return NULL;
+    }
+    K5_TAILQ_INSERT_TAIL(&lru_queue, src, links);
+    num_sources++;
+    return src;
+}
+
+/* Log the number of requests shed since the last report, if any and if the
+ * report interval has passed. */
+static void
+report_shed(int64_t now)
+{
+    unsigned long total = shed_rate_as + shed_rate_tgs + shed_inflight;
+
+    if (total == 0 || now - last_report < REPORT_INTERVAL)
+        return;
+    krb5_klog_syslog(LOG_WARNING, _("DISPATCH: shed %lu requests (%lu AS and "
+                                    "%lu TGS over per-source rate, %lu AS "
+                                    "over in-flight limit)"), total,
+                     shed_rate_as, shed_rate_tgs, shed_inflight);
+    shed_rate_as = shed_rate_tgs = shed_inflight = 0;
+    last_report = now;
+}
+
+krb5_error_code
+kdc_init_admission(krb5_context context)
+{
+    krb5_error_code ret;
+    krb5_pointer aprof = context->profile;
+    const char *hierarchy[3];
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    hierarchy[0] = KRB5_CONF_KDCDEFAULTS;
+    hierarchy[2] = NULL;
+    hierarchy[1] = KRB5_CONF_KDC_SOURCE_RATE;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &source_rate) ||
+        source_rate < 0)
+        source_rate = 0;
+    hierarchy[1] = KRB5_CONF_KDC_SOURCE_BURST;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &source_burst) ||
+        source_burst <= 0)
+        source_burst = source_rate;
+    /* An AS request needs two tokens. */
+    if (source_burst < AS_COST / TOKEN)
+        source_burst = AS_COST / TOKEN;
+    hierarchy[1] = KRB5_CONF_KDC_MAX_INFLIGHT;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &max_inflight) ||
+        max_inflight < 0)
+        max_inflight = 0;
+
+    if (source_rate == 0)
+        return 0;
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        return ret;
+    ret = k5_hashtab_create(seed, 8192, &source_table);
+    if (ret)
+        return ret;
+    K5_TAILQ_INIT(&lru_queue);
+    return 0;
+}
+
+/*
+ * Decide whether to process pkt from remote_addr, before decoding it.  If the
+ * request is admitted, return true; the caller must then call
+ * kdc_release_request() when it is finished.  Return false if the request
+ * should be discarded.
+ */
+krb5_boolean
+kdc_admit_request(krb5_context context, const krb5_fulladdr *remote_addr,
+                  const krb5_data *pkt)
+{
+    krb5_boolean is_as = krb5_is_as_req(pkt);
+    const krb5_address *addr = remote_addr->address;
+    struct source *src;
+    int64_t now, cost = is_as ? AS_COST : TGS_COST;
+
+    if (source_rate == 0 && max_inflight == 0) {
+        inflight++;
+        return TRUE;
+    }
+
+    now = now_ms(context);
+    if (now < 0) {
+        inflight++;
+        return TRUE;
+    }
+    report_shed(now);
+
+    if (is_as && max_inflight > 0 && inflight >= max_inflight) {
+        shed_inflight++;
+        return FALSE;
+    }
+
+    if (source_rate > 0 && addr->length <= sizeof(src->addr)) {
+        src = get_source(addr, now);
+        if (src != NULL) {
+            src->tokens = refilled(src, now);
+            src->last = now;
+            if (src->tokens < cost) {
+                if (is_as)
+                    shed_rate_as++;
+                else
+                    shed_rate_tgs++;
+                return FALSE;
+            }
+            src->tokens -= cost;
+        }
+    }
+
+    inflight++;
+    return TRUE;
+}
+
+/* Note that an admitted request has finished. */
+void
+kdc_release_request(void)
+{
+    inflight--;
+}
+
+void
+kdc_free_admission(void)
+{
+    struct source *src, *next;
+
+    if (source_table == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(src, &lru_queue, links, next)
+        discard_source(src);
+    k5_hashtab_free(source_table);
+    source_table = NULL;
+}
@@ -40,6 +40,7 @@ struct dispatch_state {
     void *arg;
     krb5_data *request;
     int is_tcp;
+    krb5_boolean admitted;
     kdc_realm_t *active_realm;
     krb5_context kdc_err_context;
 };
@@ -62,6 +63,8 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
                              error_message(code));
     }
 
+    if (state->admitted)
+        kdc_release_request();
     free(state);
     (*oldrespond)(oldarg, code, response);
 }
@@ -135,7 +138,18 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
         finish_dispatch(state, response ? 0 : KRB5KDC_ERR_DISCARD, response);
         return;
     }
+#endif
 
+    /* Shed load before doing any work on the request.  Respond with neither
+     * an error nor a reply so that discarded requests are not logged one by
+     * one. */
+    if (!kdc_admit_request(kdc_err_context, remote_addr, pkt)) {
+        finish_dispatch(state, 0, NULL);
+        return;
+    }
+    state->admitted = TRUE;
+
+#ifndef NOCACHE
     /* Insert a NULL entry into the lookaside to indicate that this request
      * is currently being processed. */
     kdc_insert_lookaside(kdc_err_context, pkt, NULL);
@@ -288,7 +288,7 @@ decrypt_2ndtkt(krb5_context context, krb5_kdc_req *req, krb5_flags flags,
         *status = "2ND_TKT_DECRYPT";
         goto cleanup;
     }
-    retval = get_verified_pac(context, stkt->enc_part2, server, key, local_tgt,
+    retval = get_verified_pac(context, stkt, server, key, local_tgt,
                               local_tgt_key, pac_out);
     if (retval != 0) {
         *status = "2ND_TKT_PAC";
@@ -655,7 +655,7 @@ gather_tgs_req_info(kdc_realm_t *realm, krb5_kdc_req **reqptr, krb5_data *pkt,
     }
 
     /* Decode and verify the header ticket PAC. */
-    ret = get_verified_pac(context, header_enc, t->header_server,
+    ret = get_verified_pac(context, t->header_tkt, t->header_server,
                            t->header_key, t->local_tgt, &t->local_tgt_key,
                            &t->header_pac);
     if (ret) {
@@ -1128,7 +1128,6 @@ tgs_issue_ticket(kdc_realm_t *realm, struct tgs_req_info *t,
 cleanup:
     zapfree(ticket_reply.enc_part.ciphertext.data,
             ticket_reply.enc_part.ciphertext.length);
-    zapfree(reply.enc_part.ciphertext.data, reply.enc_part.ciphertext.length);
     krb5_free_pa_data(context, reply.padata);
     krb5_free_pa_data(context, reply_encpart.enc_padata);
     krb5_free_authdata(context, enc_tkt_reply.authorization_data);
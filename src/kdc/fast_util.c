@@ -134,9 +134,9 @@ kdc_find_fast(krb5_kdc_req **requestptr,
     krb5_context context = state->realm_data->realm_context;
     krb5_error_code retval = 0;
     krb5_pa_data *fast_padata;
-    krb5_data scratch, plaintext, *inner_body = NULL;
+    krb5_data scratch, fast_data, plaintext, *inner_body = NULL;
     krb5_fast_req * fast_req = NULL;
-    krb5_kdc_req *request = *requestptr;
+    krb5_kdc_req *request = *requestptr, *outer_request = NULL;
     krb5_fast_armored_req *fast_armored_req = NULL;
     krb5_checksum *cksum;
     krb5_boolean cksum_valid;
@@ -150,9 +150,11 @@ kdc_find_fast(krb5_kdc_req **requestptr,
     fast_padata = krb5int_find_pa_data(context, request->padata,
                                        KRB5_PADATA_FX_FAST);
     if (fast_padata !=  NULL){
-        scratch.length = fast_padata->length;
-        scratch.data = (char *) fast_padata->contents;
-        retval = decode_krb5_pa_fx_fast_request(&scratch, &fast_armored_req);
+        /* The armored request is only read here, so let its ciphertext and
+         * armor alias the padata contents. */
+        fast_data = make_data(fast_padata->contents, fast_padata->length);
+        retval = decode_krb5_pa_fx_fast_request_alias(&fast_data,
+                                                      &fast_armored_req);
         if (retval == 0 &&fast_armored_req->armor) {
             switch (fast_armored_req->armor->armor_type) {
             case KRB5_FAST_ARMOR_AP_REQUEST:
@@ -229,7 +231,9 @@ kdc_find_fast(krb5_kdc_req **requestptr,
         if (retval == 0) {
             state->fast_options = fast_req->fast_options;
             fast_req->req_body->msg_type = request->msg_type;
-            krb5_free_kdc_req(context, request);
+            /* Free the outer request after fast_armored_req, which points
+             * into its padata. */
+            outer_request = request;
             *requestptr = fast_req->req_body;
             fast_req->req_body = NULL;
         }
@@ -242,7 +246,8 @@ kdc_find_fast(krb5_kdc_req **requestptr,
     if (fast_req)
         krb5_free_fast_req(context, fast_req);
     if (fast_armored_req)
-        krb5_free_fast_armored_req(context, fast_armored_req);
+        k5_free_pa_fx_fast_request_alias(&fast_data, fast_armored_req);
+    krb5_free_kdc_req(context, outer_request);
     return retval;
 }
 
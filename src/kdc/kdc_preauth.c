@@ -77,6 +77,8 @@
  */
 
 #include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
 #include "kdc_util.h"
 #include "extern.h"
 #include <stdio.h>
@@ -90,6 +92,11 @@
 /* Let freshness tokens be valid for ten minutes. */
 #define FRESHNESS_LIFETIME 600
 
+/* The number of encoded etype-info messages to remember. */
+#ifndef ETYPE_INFO_CACHE_SIZE
+#define ETYPE_INFO_CACHE_SIZE 4096
+#endif
+
 typedef struct preauth_system_st {
     const char *name;
     int type;
@@ -112,6 +119,9 @@ make_etype_info(krb5_context context, krb5_boolean etype_info2,
                 krb5_principal client, krb5_key_data *client_key,
                 krb5_enctype enctype, krb5_data **der_out);
 
+static void
+free_etype_info_cache(void);
+
 /* Get all available kdcpreauth vtables and a count of preauth types they
  * support.  Return an empty list on failure. */
 static void
@@ -272,6 +282,7 @@ unload_preauth_plugins(krb5_context context)
     free(preauth_systems);
     preauth_systems = NULL;
     n_preauth_systems = 0;
+    free_etype_info_cache();
 }
 
 /*
@@ -1548,9 +1559,9 @@ cleanup:
 /* Encode an etype-info or etype-info2 message for client_key with the given
  * enctype, using client to compute the salt if necessary. */
 static krb5_error_code
-make_etype_info(krb5_context context, krb5_boolean etype_info2,
-                krb5_principal client, krb5_key_data *client_key,
-                krb5_enctype enctype, krb5_data **der_out)
+encode_etype_info(krb5_context context, krb5_boolean etype_info2,
+                  krb5_principal client, krb5_key_data *client_key,
+                  krb5_enctype enctype, krb5_data **der_out)
 {
     krb5_error_code retval;
     krb5_etype_info_entry **entry = NULL;
@@ -1575,6 +1586,159 @@ cleanup:
     return retval;
 }
 
+/*
+ * Encoded etype-info messages are cached, since clients which authenticate
+ * repeatedly receive the same message each time.  The cache key is made of all
+ * of the inputs to the encoding (the message type, enctype, salt type,
+ * explicit salt, and client principal name), so a changed key or salt simply
+ * misses the cache.  The oldest entries are discarded when the cache is full.
+ */
+struct einfo_entry {
+    K5_TAILQ_ENTRY(einfo_entry) links;
+    krb5_data key;
+    krb5_data der;
+};
+
+K5_TAILQ_HEAD(einfo_queue, einfo_entry);
+
+static struct k5_hashtab *einfo_table;
+static struct einfo_queue einfo_queue;
+static int einfo_count;
+
+static void
+discard_einfo(struct einfo_entry *ent)
+{
+    k5_hashtab_remove(einfo_table, ent->key.data, ent->key.length);
+    K5_TAILQ_REMOVE(&einfo_queue, ent, links);
+    einfo_count--;
+    free(ent->key.data);
+    free(ent->der.data);
+    free(ent);
+}
+
+static void
+free_etype_info_cache(void)
+{
+    struct einfo_entry *ent, *next;
+
+    if (einfo_table == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(ent, &einfo_queue, links, next)
+        discard_einfo(ent);
+    k5_hashtab_free(einfo_table);
+    einfo_table = NULL;
+}
+
+/* Add a length-prefixed field to buf. */
+static void
+add_einfo_field(struct k5buf *buf, const void *data, size_t len)
+{
+    uint8_t lenbuf[4];
+
+    store_32_be(len, lenbuf);
+    k5_buf_add_len(buf, lenbuf, 4);
+    k5_buf_add_len(buf, data, len);
+}
+
+/* Construct the cache key for an etype-info message into buf. */
+static void
+make_einfo_key(struct k5buf *buf, krb5_boolean etype_info2,
+               krb5_const_principal client, const krb5_key_data *client_key,
+               krb5_enctype enctype)
+{
+    uint8_t hdr[8];
+    krb5_int16 stype;
+    int i;
+
+    stype = (client_key->key_data_ver < 2) ? KRB5_KDB_SALTTYPE_NORMAL :
+        client_key->key_data_type[1];
+    hdr[0] = etype_info2;
+    hdr[1] = 0;
+    store_16_be(stype, hdr + 2);
+    store_32_be(enctype, hdr + 4);
+    k5_buf_add_len(buf, hdr, sizeof(hdr));
+    if (stype == KRB5_KDB_SALTTYPE_SPECIAL) {
+        add_einfo_field(buf, client_key->key_data_contents[1],
+                        client_key->key_data_length[1]);
+    }
+    add_einfo_field(buf, client->realm.data, client->realm.length);
+    for (i = 0; i < client->length; i++)
+        add_einfo_field(buf, client->data[i].data, client->data[i].length);
+}
+
+/* Remember der as the encoding for key, discarding old entries as needed.
+ * Fail silently on memory exhaustion. */
+static void
+cache_etype_info(krb5_context context, const struct k5buf *key,
+                 const krb5_data *der)
+{
+    krb5_error_code ret;
+    struct einfo_entry *ent;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    if (einfo_table == NULL) {
+        if (krb5_c_random_make_octets(context, &d) != 0)
+            return;
+        if (k5_hashtab_create(seed, 1024, &einfo_table) != 0)
+            return;
+        K5_TAILQ_INIT(&einfo_queue);
+    }
+
+    while (einfo_count >= ETYPE_INFO_CACHE_SIZE)
+        discard_einfo(K5_TAILQ_FIRST(&einfo_queue));
+
+    ent = calloc(1, sizeof(*ent));
+    if (ent == NULL)
+        return;
+    if (krb5int_copy_data_contents(context, der, &ent->der) != 0)
+        goto error;
+    ent->key.data = k5memdup(key->data, key->len, &ret);
+    if (ent->key.data == NULL)
+        goto error;
+    ent->key.length = key->len;
+    if (k5_hashtab_add(einfo_table, ent->key.data, ent->key.length, ent) != 0)
+        goto error;
+    K5_TAILQ_INSERT_TAIL(&einfo_queue, ent, links);
+    einfo_count++;
+    return;
+
+error:
+    free(ent->key.data);
+    free(ent->der.data);
+    free(ent);
+}
+
+/* Return an etype-info or etype-info2 message for client_key with the given
+ * enctype, from the cache if possible. */
+static krb5_error_code
+make_etype_info(krb5_context context, krb5_boolean etype_info2,
+                krb5_principal client, krb5_key_data *client_key,
+                krb5_enctype enctype, krb5_data **der_out)
+{
+    krb5_error_code retval;
+    struct einfo_entry *ent = NULL;
+    struct k5buf key;
+    char keybuf[512];
+
+    *der_out = NULL;
+
+    /* The key buffer is left in an error state for very long principal
+     * names, which are not cached. */
+    k5_buf_init_fixed(&key, keybuf, sizeof(keybuf));
+    make_einfo_key(&key, etype_info2, client, client_key, enctype);
+    if (einfo_table != NULL && key.data != NULL)
+        ent = k5_hashtab_get(einfo_table, key.data, key.len);
+    if (ent != NULL)
+        return krb5_copy_data(context, &ent->der, der_out);
+
+    retval = encode_etype_info(context, etype_info2, client, client_key,
+                               enctype, der_out);
+    if (retval == 0 && key.data != NULL)
+        cache_etype_info(context, &key, *der_out);
+    return retval;
+}
+
 /*
  * Returns TRUE if the PAC should be included
  */
@@ -52,6 +52,8 @@
  */
 
 #include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
 #include "kdc_util.h"
 #include "extern.h"
 #include <stdio.h>
@@ -555,6 +557,146 @@ cleanup:
     return ret;
 }
 
+/*
+ * Tickets whose PACs have been verified are remembered, so that a TGT presented
+ * repeatedly has its PAC signatures checked only once.  Entries are keyed by
+ * the ticket ciphertext, which can only have been produced by the holder of
+ * the ticket key and so determines the ticket contents.  Each entry records
+ * the keys the PAC was verified with; a lookup with different keys (after a
+ * key change, for instance) misses.  Entries are discarded when the ticket
+ * expires or when the cache is full, oldest first.
+ */
+
+#ifndef VERIFIED_PAC_CACHE_SIZE
+#define VERIFIED_PAC_CACHE_SIZE 1024
+#endif
+
+struct pac_entry {
+    K5_TAILQ_ENTRY(pac_entry) links;
+    krb5_data ciphertext;
+    krb5_keyblock *server_key;
+    krb5_keyblock *tgt_key;
+    krb5_timestamp endtime;
+};
+
+K5_TAILQ_HEAD(pac_queue, pac_entry);
+
+static struct k5_hashtab *pac_table;
+static struct pac_queue pac_queue;
+static int pac_count;
+
+static void
+discard_pac_entry(struct pac_entry *ent)
+{
+    k5_hashtab_remove(pac_table, ent->ciphertext.data, ent->ciphertext.length);
+    K5_TAILQ_REMOVE(&pac_queue, ent, links);
+    pac_count--;
+    free(ent->ciphertext.data);
+    krb5_free_keyblock(NULL, ent->server_key);
+    krb5_free_keyblock(NULL, ent->tgt_key);
+    free(ent);
+}
+
+/* Return true if a and b are both null or hold the same key. */
+static krb5_boolean
+same_key(const krb5_keyblock *a, const krb5_keyblock *b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+    return a->enctype == b->enctype && a->length == b->length &&
+        k5_bcmp(a->contents, b->contents, a->length) == 0;
+}
+
+/* Return true if ticket's PAC was previously verified with server_key and
+ * tgt_key. */
+static krb5_boolean
+pac_verified(krb5_context context, const krb5_ticket *ticket,
+             const krb5_keyblock *server_key, const krb5_keyblock *tgt_key)
+{
+    struct pac_entry *ent;
+    krb5_timestamp now;
+
+    if (pac_table == NULL)
+        return FALSE;
+    ent = k5_hashtab_get(pac_table, ticket->enc_part.ciphertext.data,
+                         ticket->enc_part.ciphertext.length);
+    if (ent == NULL)
+        return FALSE;
+    if (krb5_timeofday(context, &now) != 0)
+        return FALSE;
+    if (ts_after(now, ent->endtime)) {
+        discard_pac_entry(ent);
+        return FALSE;
+    }
+    return same_key(ent->server_key, server_key) &&
+        same_key(ent->tgt_key, tgt_key);
+}
+
+/* Remember that ticket's PAC verified with server_key and tgt_key.  Fail
+ * silently on memory exhaustion. */
+static void
+cache_verified_pac(krb5_context context, const krb5_ticket *ticket,
+                   const krb5_keyblock *server_key,
+                   const krb5_keyblock *tgt_key)
+{
+    struct pac_entry *ent;
+    const krb5_data *ctext = &ticket->enc_part.ciphertext;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    if (pac_table == NULL) {
+        if (krb5_c_random_make_octets(context, &d) != 0)
+            return;
+        if (k5_hashtab_create(seed, 256, &pac_table) != 0)
+            return;
+        K5_TAILQ_INIT(&pac_queue);
+    }
+
+    /* Replace any entry for this ticket recorded with other keys. */
+    ent = k5_hashtab_get(pac_table, ctext->data, ctext->length);
+    if (ent != NULL)
+        discard_pac_entry(ent);
+    while (pac_count >= VERIFIED_PAC_CACHE_SIZE)
+        discard_pac_entry(K5_TAILQ_FIRST(&pac_queue));
+
+    ent = calloc(1, sizeof(*ent));
+    if (ent == NULL)
+        return;
+    ent->endtime = ticket->enc_part2->times.endtime;
+    if (krb5int_copy_data_contents(context, ctext, &ent->ciphertext) != 0)
+        goto error;
+    if (krb5_copy_keyblock(context, server_key, &ent->server_key) != 0)
+        goto error;
+    if (tgt_key != NULL &&
+        krb5_copy_keyblock(context, tgt_key, &ent->tgt_key) != 0)
+        goto error;
+    if (k5_hashtab_add(pac_table, ent->ciphertext.data,
+                       ent->ciphertext.length, ent) != 0)
+        goto error;
+    K5_TAILQ_INSERT_TAIL(&pac_queue, ent, links);
+    pac_count++;
+    return;
+
+error:
+    free(ent->ciphertext.data);
+    krb5_free_keyblock(context, ent->server_key);
+    krb5_free_keyblock(context, ent->tgt_key);
+    free(ent);
+}
+
+void
+kdc_free_pac_cache(void)
+{
+    struct pac_entry *ent, *next;
+
+    if (pac_table == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(ent, &pac_queue, links, next)
+        discard_pac_entry(ent);
+    k5_hashtab_free(pac_table);
+    pac_table = NULL;
+}
+
 /* Try verifying a ticket's PAC using a privsvr key either equal to or derived
  * from tgt_key, respecting the server's pac_privsvr_enctype value if set. */
 static krb5_error_code
@@ -575,17 +717,19 @@ try_verify_pac(krb5_context context, const krb5_enc_tkt_part *enc_tkt,
 }
 
 /*
- * If a PAC is present in enc_tkt, verify it and place it in *pac_out.  sprinc
- * is the canonical name of the server principal entry used to decrypt enc_tkt.
- * server_key is the ticket decryption key.  tgt is the local krbtgt entry for
- * the ticket server realm, and tgt_key is its first key.
+ * If a PAC is present in the decrypted ticket, verify it and place it in
+ * *pac_out.  sprinc is the canonical name of the server principal entry used
+ * to decrypt ticket.  server_key is the ticket decryption key.  tgt is the
+ * local krbtgt entry for the ticket server realm, and tgt_key is its first
+ * key.
  */
 krb5_error_code
-get_verified_pac(krb5_context context, const krb5_enc_tkt_part *enc_tkt,
+get_verified_pac(krb5_context context, const krb5_ticket *ticket,
                  krb5_db_entry *server, krb5_keyblock *server_key,
                  krb5_db_entry *tgt, krb5_keyblock *tgt_key, krb5_pac *pac_out)
 {
     krb5_error_code ret;
+    const krb5_enc_tkt_part *enc_tkt = ticket->enc_part2;
     krb5_key_data *kd;
     krb5_keyblock old_key;
     krb5_kvno kvno;
@@ -594,14 +738,26 @@ get_verified_pac(krb5_context context, const krb5_enc_tkt_part *enc_tkt,
     *pac_out = NULL;
 
     /* For local or cross-realm TGTs we only check the server signature. */
-    if (krb5_is_tgs_principal(server->princ)) {
-        return krb5_kdc_verify_ticket(context, enc_tkt, server->princ,
-                                      server_key, NULL, pac_out);
+    if (krb5_is_tgs_principal(server->princ))
+        tgt_key = NULL;
+
+    /* If we have verified this ticket's PAC before, just parse it. */
+    if (pac_verified(context, ticket, server_key, tgt_key)) {
+        return krb5_kdc_verify_ticket(context, enc_tkt, server->princ, NULL,
+                                      NULL, pac_out);
     }
 
-    ret = try_verify_pac(context, enc_tkt, server, server_key, tgt_key,
-                         pac_out);
-    if (ret != KRB5KRB_AP_ERR_MODIFIED && ret != KRB5_BAD_ENCTYPE)
+    if (tgt_key == NULL) {
+        ret = krb5_kdc_verify_ticket(context, enc_tkt, server->princ,
+                                     server_key, NULL, pac_out);
+    } else {
+        ret = try_verify_pac(context, enc_tkt, server, server_key, tgt_key,
+                             pac_out);
+    }
+    if (ret == 0 && *pac_out != NULL)
+        cache_verified_pac(context, ticket, server_key, tgt_key);
+    if (tgt_key == NULL ||
+        (ret != KRB5KRB_AP_ERR_MODIFIED && ret != KRB5_BAD_ENCTYPE))
         return ret;
 
     /* There is no kvno in PAC signatures, so try two previous versions. */
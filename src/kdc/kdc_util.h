@@ -242,6 +242,14 @@ handle_authdata(kdc_realm_t *realm, unsigned int flags, krb5_db_entry *client,
                 krb5_data ***auth_indicators,
                 krb5_enc_tkt_part *enc_tkt_reply);
 
+/* admit.c */
+krb5_error_code kdc_init_admission(krb5_context context);
+krb5_boolean kdc_admit_request(krb5_context context,
+                               const krb5_fulladdr *remote_addr,
+                               const krb5_data *pkt);
+void kdc_release_request(void);
+void kdc_free_admission(void);
+
 /* replay.c */
 krb5_error_code kdc_init_lookaside(krb5_context context);
 krb5_boolean kdc_check_lookaside (krb5_context, krb5_data *, krb5_data **);
@@ -257,11 +265,13 @@ pac_privsvr_key(krb5_context context, krb5_db_entry *server,
                 const krb5_keyblock *tgt_key, krb5_keyblock **key_out);
 
 krb5_error_code
-get_verified_pac(krb5_context context, const krb5_enc_tkt_part *enc_tkt,
+get_verified_pac(krb5_context context, const krb5_ticket *ticket,
                  krb5_db_entry *server, krb5_keyblock *server_key,
                  krb5_db_entry *tgt, krb5_keyblock *tgt_key,
                  krb5_pac *pac_out);
 
+void kdc_free_pac_cache(void);
+
 krb5_error_code
 get_pac_princ_with_realm(krb5_context context, krb5_pac pac,
                          krb5_principal *princ_out,
@@ -45,7 +45,6 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <ctype.h>
-#include <sys/wait.h>
 
 #if defined(NEED_DAEMON_PROTO)
 extern int daemon(int, int);
@@ -62,8 +61,6 @@ static int nofork = 0;
 static int workers = 0;
 static int time_offset = 0;
 static const char *pid_file = NULL;
-static volatile int signal_received = 0;
-static volatile int sighup_received = 0;
 
 #define KRB5_KDC_MAX_REALMS     32
 
@@ -424,158 +421,6 @@ whoops:
     return(kret);
 }
 
-static void
-on_monitor_signal(int signo)
-{
-    signal_received = signo;
-}
-
-static void
-on_monitor_sighup(int signo)
-{
-    sighup_received = 1;
-}
-
-/*
- * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
- * are set to -1, and wait for them to exit (so that we know the ports are no
- * longer in use).
- */
-static void
-terminate_workers(pid_t *pids, int bound)
-{
-    int i, status, num_active = 0;
-    pid_t pid;
-
-    /* Kill the active worker pids. */
-    for (i = 0; i < bound; i++) {
-        if (pids[i] == -1)
-            continue;
-        kill(pids[i], SIGTERM);
-        num_active++;
-    }
-
-    /* Wait for them to exit. */
-    while (num_active > 0) {
-        pid = wait(&status);
-        if (pid >= 0)
-            num_active--;
-    }
-}
-
-/*
- * Create num worker processes and return successfully in each child.  The
- * parent process will act as a supervisor and will only return from this
- * function in error cases.
- */
-static krb5_error_code
-create_workers(verto_ctx *ctx, int num)
-{
-    krb5_error_code retval;
-    int i, status;
-    pid_t pid, *pids;
-#ifdef POSIX_SIGNALS
-    struct sigaction s_action;
-#endif /* POSIX_SIGNALS */
-
-    /*
-     * Setup our signal handlers which will forward to the children.
-     * These handlers will be overridden in the child processes.
-     */
-#ifdef POSIX_SIGNALS
-    (void) sigemptyset(&s_action.sa_mask);
-    s_action.sa_flags = 0;
-    s_action.sa_handler = on_monitor_signal;
-    (void) sigaction(SIGINT, &s_action, (struct sigaction *) NULL);
-    (void) sigaction(SIGTERM, &s_action, (struct sigaction *) NULL);
-    (void) sigaction(SIGQUIT, &s_action, (struct sigaction *) NULL);
-    s_action.sa_handler = on_monitor_sighup;
-    (void) sigaction(SIGHUP, &s_action, (struct sigaction *) NULL);
-#else  /* POSIX_SIGNALS */
-    signal(SIGINT, on_monitor_signal);
-    signal(SIGTERM, on_monitor_signal);
-    signal(SIGQUIT, on_monitor_signal);
-    signal(SIGHUP, on_monitor_sighup);
-#endif /* POSIX_SIGNALS */
-
-    /* Create child worker processes; return in each child. */
-    krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), num);
-    pids = calloc(num, sizeof(pid_t));
-    if (pids == NULL)
-        return ENOMEM;
-    for (i = 0; i < num; i++) {
-        pid = fork();
-        if (pid == 0) {
-            free(pids);
-            if (!verto_reinitialize(ctx)) {
-                krb5_klog_syslog(LOG_ERR,
-                                 _("Unable to reinitialize main loop"));
-                return ENOMEM;
-            }
-            retval = loop_setup_signals(ctx, &shandle, reset_for_hangup);
-            if (retval) {
-                krb5_klog_syslog(LOG_ERR, _("Unable to initialize signal "
-                                            "handlers in pid %d"), pid);
-                return retval;
-            }
-
-            /* Avoid race condition */
-            if (signal_received)
-                exit(0);
-
-            /* Return control to main() in the new worker process. */
-            return 0;
-        }
-        if (pid == -1) {
-            /* Couldn't fork enough times. */
-            status = errno;
-            terminate_workers(pids, i);
-            free(pids);
-            return status;
-        }
-        pids[i] = pid;
-    }
-
-    /* We're going to use our own main loop here. */
-    loop_free(ctx);
-
-    /* Supervise the worker processes. */
-    while (!signal_received) {
-        /* Wait until a worker process exits or we get a signal. */
-        pid = wait(&status);
-        if (pid >= 0) {
-            krb5_klog_syslog(LOG_ERR, _("worker %ld exited with status %d"),
-                             (long) pid, status);
-
-            /* Remove the pid from the table. */
-            for (i = 0; i < num; i++) {
-                if (pids[i] == pid)
-                    pids[i] = -1;
-            }
-
-            /* When one worker process exits, terminate them all, so that KDC
-             * crashes behave similarly with or without worker processes. */
-            break;
-        }
-
-        /* Propagate HUP signal to worker processes if we received one. */
-        if (sighup_received) {
-            sighup_received = 0;
-            for (i = 0; i < num; i++) {
-                if (pids[i] != -1)
-                    kill(pids[i], SIGHUP);
-            }
-        }
-    }
-    if (signal_received)
-        krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
-                         signal_received);
-
-    terminate_workers(pids, num);
-    free(pids);
-    exit(0);
-}
-
 static void
 usage(char *name)
 {
@@ -949,6 +794,13 @@ int main(int argc, char **argv)
     }
 #endif
 
+    retval = kdc_init_admission(kcontext);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing admission control"));
+        finish_realms();
+        return 1;
+    }
+
     ctx = loop_init(VERTO_EV_TYPE_NONE);
     if (!ctx) {
         kdc_err(kcontext, ENOMEM, _("while creating main loop"));
@@ -1015,7 +867,8 @@ int main(int argc, char **argv)
         }
     }
     if (workers > 0) {
-        retval = create_workers(ctx, workers);
+        retval = loop_create_workers(ctx, workers, &shandle,
+                                     reset_for_hangup);
         if (retval) {
             kdc_err(kcontext, errno, _("creating worker processes"));
             return 1;
@@ -1050,6 +903,8 @@ int main(int argc, char **argv)
 #ifndef NOCACHE
     kdc_free_lookaside(kcontext);
 #endif
+    kdc_free_admission();
+    kdc_free_pac_cache();
     loop_free(ctx);
     krb5_free_context(kcontext);
     return errout;
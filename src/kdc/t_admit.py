@@ -0,0 +1,22 @@
+from k5test import *
+
+# Allow each client address one TGS request per second, with a burst
+# of two.  An AS request costs two tokens, so a second AS request
+# right after the first must be discarded and retried by the client.
+kdc_conf = {'kdcdefaults': {'kdc_source_rate': '1',
+                            'kdc_source_burst': '2'}}
+realm = K5Realm(kdc_conf=kdc_conf, get_creds=False)
+realm.kinit(realm.user_princ, password('user'))
+realm.kinit(realm.user_princ, password('user'))
+realm.run([kvno, realm.host_princ])
+
+# The next request after a discard reports the discarded requests.
+realm.stop()
+with open(os.path.join(realm.testdir, 'kdc.log')) as f:
+    shed = [line for line in f if 'DISPATCH: shed' in line]
+if not shed:
+    fail('Expected a log message for discarded requests')
+if 'over per-source rate' not in shed[0]:
+    fail('Unexpected shed log message: ' + shed[0])
+
+success('KDC admission control')
@@ -313,11 +313,10 @@ print_attr(kdbe_val_t *val, int vverbose)
  * Print the update entry information
  */
 static void
-print_update(kdb_hlog_t *ulog, uint32_t entry, uint32_t ulogentries,
-             unsigned int verbose)
+print_update(kdb_hlog_t *ulog, uint32_t entry, unsigned int verbose)
 {
     XDR xdrs;
-    uint32_t start_sno, i, j, indx;
+    uint32_t start_sno, i, j;
     char *dbprinc;
     kdb_ent_header_t *indx_log;
     kdb_incr_update_t upd;
@@ -328,9 +327,7 @@ print_update(kdb_hlog_t *ulog, uint32_t entry, uint32_t ulogentries,
         start_sno = ulog->kdb_first_sno - 1;
 
     for (i = start_sno; i < ulog->kdb_last_sno; i++) {
-        indx = i % ulogentries;
-
-        indx_log = INDEX(ulog, indx);
+        indx_log = ULOG_INDEX_ENTRY(ulog, i + 1);
 
         /*
          * Check for corrupt update entry
@@ -517,7 +514,7 @@ main(int argc, char **argv)
         printf(_("Unknown state: %d\n"), ulog->kdb_state);
         break;
     }
-    printf(_("\tEntry block size : %u\n"), ulog->kdb_block);
+    printf(_("\tEntry data size : %u\n"), ulog->kdb_data_size);
     printf(_("\tNumber of entries : %u\n"), ulog->kdb_num);
 
     if (ulog->kdb_last_sno == 0) {
@@ -549,7 +546,7 @@ main(int argc, char **argv)
     }
 
     if (!headeronly && ulog->kdb_num)
-        print_update(ulog, entry, params.iprop_ulogsize, verbose);
+        print_update(ulog, entry, verbose);
 
     printf("\n");
 
@@ -25,6 +25,7 @@
  */
 
 #include "k5-int.h"
+#include "k5-queue.h"
 #include "adm_proto.h"
 #include <sys/ioctl.h>
 #include <syslog.h>
@@ -61,6 +62,7 @@
 #include "net-server.h"
 #include <signal.h>
 #include <netdb.h>
+#include <sys/wait.h>
 
 #include "udppktinfo.h"
 
@@ -157,8 +159,10 @@ struct connection {
     sg_buf *sgp;
     int sgnum;
 
-    /* Crude denial-of-service avoidance support (TCP or RPC) */
-    time_t start_time;
+    /* Crude denial-of-service avoidance support (TCP or RPC).  ev is the
+     * currently registered event, or NULL while a request is dispatched. */
+    K5_TAILQ_ENTRY(connection) links;
+    verto_ev *ev;
 
     /* RPC-specific fields */
     SVCXPRT *transp;
@@ -213,7 +217,17 @@ struct bind_address {
     struct rpc_svc_data rpc_svc_data;
 };
 
-static SET(verto_ev *) events;
+/* Registered events, indexed by file descriptor.  n is the number of non-null
+ * entries and max is the allocated size of data. */
+static struct {
+    verto_ev **data;
+    size_t n, max;
+} events;
+
+/* TCP and RPC connections, least recently accepted first. */
+static K5_TAILQ_HEAD(, connection) connections =
+    K5_TAILQ_HEAD_INITIALIZER(connections);
+
 static SET(struct bind_address) bind_addresses;
 
 verto_ctx *
@@ -456,6 +470,8 @@ free_connection(struct connection *conn)
 {
     if (!conn)
         return;
+    if (conn->type == CONN_TCP || conn->type == CONN_RPC)
+        K5_TAILQ_REMOVE(&connections, conn, links);
     if (conn->response)
         krb5_free_data(get_context(conn->handle), conn->response);
     if (conn->buffer)
@@ -465,18 +481,48 @@ free_connection(struct connection *conn)
     free(conn);
 }
 
+/* Record ev in the events table.  Return 0 on success, ENOMEM on allocation
+ * failure, or EEXIST if another event is registered for the same fd. */
+static int
+add_event_to_set(verto_ev *ev)
+{
+    int fd = verto_get_fd(ev);
+    size_t newmax;
+    verto_ev **newdata;
+
+    if (fd < 0)
+        return EINVAL;
+    if ((size_t)fd >= events.max) {
+        newmax = (events.max > 0) ? events.max : 16;
+        while (newmax <= (size_t)fd)
+            newmax *= 2;
+        newdata = realloc(events.data, newmax * sizeof(*events.data));
+        if (newdata == NULL)
+            return ENOMEM;
+        memset(newdata + events.max, 0,
+               (newmax - events.max) * sizeof(*events.data));
+        events.data = newdata;
+        events.max = newmax;
+    }
+    if (events.data[fd] != NULL)
+        return EEXIST;
+    events.data[fd] = ev;
+    events.n++;
+    return 0;
+}
+
 static void
 remove_event_from_set(verto_ev *ev)
 {
-    verto_ev *tmp;
-    int i;
+    struct connection *conn = verto_get_private(ev);
+    int fd = verto_get_fd(ev);
 
-    /* Remove the event from the events. */
-    FOREACH_ELT(events, i, tmp)
-        if (tmp == ev) {
-            DEL(events, i);
-            break;
-        }
+    if (fd >= 0 && (size_t)fd < events.max && events.data[fd] == ev) {
+        events.data[fd] = NULL;
+        events.n--;
+    }
+    if (conn != NULL && conn->ev == ev)
+        conn->ev = NULL;
 }
 
 static void
@@ -528,7 +574,7 @@ make_event(verto_ctx *ctx, verto_ev_flag flags, verto_callback callback,
            int sock, struct connection *conn)
 {
     verto_ev *ev;
-    void *tmp;
+    int ret;
 
     ev = verto_add_io(ctx, flags, callback, sock);
     if (!ev) {
@@ -536,13 +582,15 @@ make_event(verto_ctx *ctx, verto_ev_flag flags, verto_callback callback,
         return NULL;
     }
 
-    if (!ADD(events, ev, tmp)) {
-        com_err(conn->prog, ENOMEM, _("cannot save event"));
+    ret = add_event_to_set(ev);
+    if (ret) {
+        com_err(conn->prog, ret, _("cannot save event"));
         verto_del(ev);
         return NULL;
     }
 
     verto_set_private(ev, conn, free_socket);
+    conn->ev = ev;
     return ev;
 }
 
@@ -573,6 +621,15 @@ add_fd(int sock, enum conn_type conntype, verto_ev_flag flags, void *handle,
     newconn->type = conntype;
 
     *ev_out = make_event(ctx, flags, callback, sock, newconn);
+    if (*ev_out == NULL) {
+        free(newconn);
+        return ENOMEM;
+    }
+
+    /* Connections are accepted in order, so appending keeps the list sorted
+     * from least to most recently accepted. */
+    if (conntype == CONN_TCP || conntype == CONN_RPC)
+        K5_TAILQ_INSERT_TAIL(&connections, newconn, links);
     return 0;
 }
 
@@ -902,17 +959,17 @@ loop_setup_network(verto_ctx *ctx, void *handle, const char *prog,
                    int tcp_listen_backlog)
 {
     krb5_error_code ret;
-    verto_ev *ev;
-    int i;
+    size_t i;
 
     /* Check to make sure that at least one address was added to the loop. */
     if (bind_addresses.n == 0)
         return EINVAL;
 
     /* Close any open connections. */
-    FOREACH_ELT(events, i, ev)
-        verto_del(ev);
-    events.n = 0;
+    for (i = 0; i < events.max; i++) {
+        if (events.data[i] != NULL)
+            verto_del(events.data[i]);
+    }
 
     krb5_klog_syslog(LOG_INFO, _("setting up network..."));
     ret = setup_addresses(ctx, handle, prog, tcp_listen_backlog);
@@ -1101,39 +1158,28 @@ process_packet(verto_ctx *ctx, verto_ev *ev)
              &state->request, 0, ctx, process_packet_response, state);
 }
 
-static int
+static void
 kill_lru_tcp_or_rpc_connection(void *handle, verto_ev *newev)
 {
-    struct connection *c = NULL, *oldest_c = NULL;
-    verto_ev *ev, *oldest_ev = NULL;
-    int i, fd = -1;
+    struct connection *c;
 
     krb5_klog_syslog(LOG_INFO, _("too many connections"));
 
-    FOREACH_ELT (events, i, ev) {
-        if (ev == newev)
-            continue;
-
-        c = verto_get_private(ev);
-        if (!c)
-            continue;
-        if (c->type != CONN_TCP && c->type != CONN_RPC)
-            continue;
-        if (oldest_c == NULL
-            || oldest_c->start_time > c->start_time) {
-            oldest_ev = ev;
-            oldest_c = c;
-        }
+    /* Find the least recently accepted connection which has an event
+     * registered.  Connections with a request being dispatched have no event
+     * and are skipped; there are normally few of them. */
+    K5_TAILQ_FOREACH(c, &connections, links) {
+        if (c->ev != NULL && c->ev != newev)
+            break;
     }
-    if (oldest_c != NULL) {
+    if (c != NULL) {
         krb5_klog_syslog(LOG_INFO, _("dropping %s fd %d from %s"),
                          c->type == CONN_RPC ? "rpc" : "tcp",
-                         verto_get_fd(oldest_ev), oldest_c->addrbuf);
-        if (oldest_c->type == CONN_RPC)
-            oldest_c->rpc_force_close = 1;
-        verto_del(oldest_ev);
+                         verto_get_fd(c->ev), c->addrbuf);
+        if (c->type == CONN_RPC)
+            c->rpc_force_close = 1;
+        verto_del(c->ev);
     }
-    return fd;
 }
 
 static void
@@ -1189,7 +1235,6 @@ accept_tcp_connection(verto_ctx *ctx, verto_ev *ev)
     newconn->addrlen = addrlen;
     newconn->bufsiz = 1024 * 1024;
     newconn->buffer = malloc(newconn->bufsiz);
-    newconn->start_time = time(0);
 
     if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
         kill_lru_tcp_or_rpc_connection(conn->handle, newev);
@@ -1266,8 +1311,8 @@ prepare_for_dispatch(verto_ctx *ctx, verto_ev *ev)
     state->conn = verto_get_private(ev);
     state->sock = verto_get_fd(ev);
     state->ctx = ctx;
-    verto_set_private(ev, NULL, NULL); /* Don't close the fd or free conn! */
     remove_event_from_set(ev); /* Remove it from the set. */
+    verto_set_private(ev, NULL, NULL); /* Don't close the fd or free conn! */
     verto_del(ev);
     return state;
 }
@@ -1423,21 +1468,173 @@ loop_free(verto_ctx *ctx)
     FOREACH_ELT(bind_addresses, i, val)
         free(val.address);
     FREE_SET_DATA(bind_addresses);
-    FREE_SET_DATA(events);
+    free(events.data);
+    events.data = NULL;
+    events.n = events.max = 0;
 }
 
-static int
-have_event_for_fd(int fd)
+static volatile int signal_received = 0;
+static volatile int sighup_received = 0;
+
+static void
+on_monitor_signal(int signo)
 {
-    verto_ev *ev;
-    int i;
+    signal_received = signo;
+}
 
-    FOREACH_ELT(events, i, ev) {
-        if (verto_get_fd(ev) == fd)
-            return 1;
+static void
+on_monitor_sighup(int signo)
+{
+    sighup_received = 1;
+}
+
+/*
+ * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
+ * are set to -1, and wait for them to exit (so that we know the ports are no
+ * longer in use).
+ */
+static void
+terminate_workers(pid_t *pids, int bound)
+{
+    int i, status, num_active = 0;
+    pid_t pid;
+
+    /* Kill the active worker pids. */
+    for (i = 0; i < bound; i++) {
+        if (pids[i] == -1)
+            continue;
+        kill(pids[i], SIGTERM);
+        num_active++;
     }
 
-    return 0;
+    /* Wait for them to exit. */
+    while (num_active > 0) {
+        pid = wait(&status);
+        if (pid >= 0)
+            num_active--;
+    }
+}
+
+/*
+ * Create num worker processes and return successfully in each child, after
+ * setting up signal handling in the child as loop_setup_signals() does.  The
+ * parent process will act as a supervisor and will only return from this
+ * function in error cases.
+ */
+krb5_error_code
+loop_create_workers(verto_ctx *ctx, int num, void *handle,
+                    void (*reset)(void *))
+{
+    krb5_error_code retval;
+    int i, status;
+    pid_t pid, *pids;
+#ifdef POSIX_SIGNALS
+    struct sigaction s_action;
+#endif /* POSIX_SIGNALS */
+
+    /*
+     * Setup our signal handlers which will forward to the children.
+     * These handlers will be overridden in the child processes.
+     */
+#ifdef POSIX_SIGNALS
+    (void) sigemptyset(&s_action.sa_mask);
+    s_action.sa_flags = 0;
+    s_action.sa_handler = on_monitor_signal;
+    (void) sigaction(SIGINT, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGTERM, &s_action, (struct sigaction *) NULL);
+    (void) sigaction(SIGQUIT, &s_action, (struct sigaction *) NULL);
+    s_action.sa_handler = on_monitor_sighup;
+    (void) sigaction(SIGHUP, &s_action, (struct sigaction *) NULL);
+#else  /* POSIX_SIGNALS */
+    signal(SIGINT, on_monitor_signal);
+    signal(SIGTERM, on_monitor_signal);
+    signal(SIGQUIT, on_monitor_signal);
+    signal(SIGHUP, on_monitor_sighup);
+#endif /* POSIX_SIGNALS */
+
+    /* Create child worker processes; return in each child. */
+    krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), num);
+    pids = calloc(num, sizeof(pid_t));
+    if (pids == NULL)
+        return ENOMEM;
+    for (i = 0; i < num; i++) {
+        pid = fork();
+        if (pid == 0) {
+            free(pids);
+            if (!verto_reinitialize(ctx)) {
+                krb5_klog_syslog(LOG_ERR,
+                                 _("Unable to reinitialize main loop"));
+                return ENOMEM;
+            }
+            retval = loop_setup_signals(ctx, handle, reset);
+            if (retval) {
+                krb5_klog_syslog(LOG_ERR, _("Unable to initialize signal "
+                                            "handlers in pid %d"), pid);
+                return retval;
+            }
+
+            /* Avoid race condition */
+            if (signal_received)
+                exit(0);
+
+            /* Return control to main() in the new worker process. */
+            return 0;
+        }
+        if (pid == -1) {
+            /* Couldn't fork enough times. */
+            status = errno;
+            terminate_workers(pids, i);
+            free(pids);
+            return status;
+        }
+        pids[i] = pid;
+    }
+
+    /* We're going to use our own main loop here. */
+    loop_free(ctx);
+
+    /* Supervise the worker processes. */
+    while (!signal_received) {
+        /* Wait until a worker process exits or we get a signal. */
+        pid = wait(&status);
+        if (pid >= 0) {
+            krb5_klog_syslog(LOG_ERR, _("worker %ld exited with status %d"),
+                             (long) pid, status);
+
+            /* Remove the pid from the table. */
+            for (i = 0; i < num; i++) {
+                if (pids[i] == pid)
+                    pids[i] = -1;
+            }
+
+            /* When one worker process exits, terminate them all, so that
+             * server crashes behave similarly with or without worker
+             * processes. */
+            break;
+        }
+
+        /* Propagate HUP signal to worker processes if we received one. */
+        if (sighup_received) {
+            sighup_received = 0;
+            for (i = 0; i < num; i++) {
+                if (pids[i] != -1)
+                    kill(pids[i], SIGHUP);
+            }
+        }
+    }
+    if (signal_received)
+        krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
+                         signal_received);
+
+    terminate_workers(pids, num);
+    free(pids);
+    exit(0);
+}
+
+static int
+have_event_for_fd(int fd)
+{
+    return fd >= 0 && (size_t)fd < events.max && events.data[fd] != NULL;
 }
 
 static void
@@ -1497,7 +1694,6 @@ accept_rpc_connection(verto_ctx *ctx, verto_ev *ev)
 
         newconn->addr_s = addr_s;
         newconn->addrlen = addrlen;
-        newconn->start_time = time(0);
 
         if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
             kill_lru_tcp_or_rpc_connection(newconn->handle, newev);
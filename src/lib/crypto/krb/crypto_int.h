@@ -53,6 +53,13 @@
 #define K5_BUILTIN_RC4
 #define K5_OPENSSL_KDF
 #define K5_OPENSSL_CMAC
+/*
+ * Looking up an OpenSSL 3.0 algorithm implementation by name is expensive, so
+ * fetch the ones we use once, and cache keyed contexts within krb5_key
+ * objects.
+ */
+#define K5_OPENSSL_FETCH
+#include <openssl/types.h>
 #else
 #define K5_OPENSSL_DES_KEY_PARITY
 #define K5_OPENSSL_MD4
@@ -559,6 +566,51 @@ krb5_error_code krb5int_camellia_encrypt(krb5_key key, const krb5_data *ivec,
                                          krb5_crypto_iov *data,
                                          size_t num_data);
 
+#ifdef K5_OPENSSL_FETCH
+
+/* Algorithm implementations fetched once per process from the default OpenSSL
+ * library context.  A field is NULL if the algorithm could not be fetched. */
+struct k5_openssl_algs {
+    EVP_MAC *hmac;
+    EVP_MAC *cmac;
+    EVP_KDF *kbkdf;
+    EVP_KDF *krb5kdf;
+    EVP_CIPHER *aes128_cts;
+    EVP_CIPHER *aes256_cts;
+    EVP_CIPHER *camellia128_cts;
+    EVP_CIPHER *camellia256_cts;
+};
+
+/* Return the fetched algorithms, or NULL if library initialization failed. */
+const struct k5_openssl_algs *k5_openssl_get_algs(void);
+
+/*
+ * Return a cipher context for key, initialized with iv for encryption or
+ * decryption.  If key belongs to an enctype whose enc provider uses
+ * k5_openssl_key_cleanup(), the context is kept in the key's cache and is
+ * only keyed on first use; *cached_out is set to true and the caller must not
+ * free the context.  Otherwise the caller must free the context with
+ * EVP_CIPHER_CTX_free().  Return NULL on failure.
+ */
+EVP_CIPHER_CTX *k5_openssl_cipher_ctx(krb5_key key, const EVP_CIPHER *cipher,
+                                      const OSSL_PARAM *params,
+                                      const unsigned char *iv, int encrypt,
+                                      krb5_boolean *cached_out);
+
+/*
+ * Return an initialized MAC context for key, like k5_openssl_cipher_ctx().
+ * type identifies the parameters the context is keyed with, so that the
+ * cached context is not reused for a different hash or cipher.
+ */
+EVP_MAC_CTX *k5_openssl_mac_ctx(krb5_key key, EVP_MAC *mac, const void *type,
+                                const OSSL_PARAM *params,
+                                krb5_boolean *cached_out);
+
+/* key_cleanup method for enc providers whose keys may cache contexts. */
+void k5_openssl_key_cleanup(krb5_key key);
+
+#endif /* K5_OPENSSL_FETCH */
+
 /*** Inline helper functions ***/
 
 /* Find an enctype by number in the enctypes table. */
@@ -0,0 +1,209 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/openssl/cache.c - Cached OpenSSL algorithms and contexts */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * With OpenSSL 3.0, each use of an algorithm by name (or through a legacy
+ * EVP_CIPHER or EVP_MD object) performs an implicit fetch, which takes locks
+ * on the provider store and compares names.  This file fetches the algorithms
+ * we use once per process, and maintains keyed cipher and MAC contexts in the
+ * cache field of krb5_key objects so that repeated operations with the same
+ * key need not set up the key each time.  Like the builtin key schedule
+ * caches, the cached contexts assume that a krb5_key is not used by multiple
+ * threads at once.
+ */
+
+#include "crypto_int.h"
+
+#ifdef K5_OPENSSL_FETCH
+
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+
+/* Keyed contexts stored in the cache field of a krb5_key. */
+struct key_cache {
+    EVP_CIPHER_CTX *encrypt;
+    EVP_CIPHER_CTX *decrypt;
+    EVP_MAC_CTX *mac;
+    const void *mac_type;
+};
+
+static struct k5_openssl_algs algs;
+
+MAKE_INIT_FUNCTION(k5_openssl_fetch_init);
+MAKE_FINI_FUNCTION(k5_openssl_fetch_fini);
+
+int
+k5_openssl_fetch_init(void)
+{
+    /* A failed fetch leaves a null field, which is reported as an error when
+     * the algorithm is used. */
+    algs.hmac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    algs.cmac = EVP_MAC_fetch(NULL, "CMAC", NULL);
+    algs.kbkdf = EVP_KDF_fetch(NULL, "KBKDF", NULL);
+    algs.krb5kdf = EVP_KDF_fetch(NULL, "KRB5KDF", NULL);
+    algs.aes128_cts = EVP_CIPHER_fetch(NULL, "AES-128-CBC-CTS", NULL);
+    algs.aes256_cts = EVP_CIPHER_fetch(NULL, "AES-256-CBC-CTS", NULL);
+    algs.camellia128_cts = EVP_CIPHER_fetch(NULL, "CAMELLIA-128-CBC-CTS",
+                                            NULL);
+    algs.camellia256_cts = EVP_CIPHER_fetch(NULL, "CAMELLIA-256-CBC-CTS",
+                                            NULL);
+    return 0;
+}
+
+void
+k5_openssl_fetch_fini(void)
+{
+    if (!INITIALIZER_RAN(k5_openssl_fetch_init) || PROGRAM_EXITING())
+        return;
+    EVP_MAC_free(algs.hmac);
+    EVP_MAC_free(algs.cmac);
+    EVP_KDF_free(algs.kbkdf);
+    EVP_KDF_free(algs.krb5kdf);
+    EVP_CIPHER_free(algs.aes128_cts);
+    EVP_CIPHER_free(algs.aes256_cts);
+    EVP_CIPHER_free(algs.camellia128_cts);
+    EVP_CIPHER_free(algs.camellia256_cts);
+    memset(&algs, 0, sizeof(algs));
+}
+
+const struct k5_openssl_algs *
+k5_openssl_get_algs(void)
+{
+    if (CALL_INIT_FUNCTION(k5_openssl_fetch_init) != 0)
+        return NULL;
+    return &algs;
+}
+
+/* Return the context cache for key, creating it if necessary.  Return NULL if
+ * key's enc provider would not free the cache, or on allocation failure. */
+static struct key_cache *
+get_key_cache(krb5_key key)
+{
+    const struct krb5_keytypes *ktp;
+
+    ktp = find_enctype(key->keyblock.enctype);
+    if (ktp == NULL || ktp->enc->key_cleanup != k5_openssl_key_cleanup)
+        return NULL;
+    if (key->cache == NULL)
+        key->cache = calloc(1, sizeof(struct key_cache));
+    return key->cache;
+}
+
+EVP_CIPHER_CTX *
+k5_openssl_cipher_ctx(krb5_key key, const EVP_CIPHER *cipher,
+                      const OSSL_PARAM *params, const unsigned char *iv,
+                      int encrypt, krb5_boolean *cached_out)
+{
+    struct key_cache *cache = get_key_cache(key);
+    EVP_CIPHER_CTX *ctx, **slot = NULL;
+
+    *cached_out = FALSE;
+
+    if (cache != NULL) {
+        slot = encrypt ? &cache->encrypt : &cache->decrypt;
+        if (*slot != NULL &&
+            EVP_CIPHER_CTX_get0_cipher(*slot) == cipher) {
+            /* Reset the IV and cipher state, keeping the key schedule. */
+            if (!EVP_CipherInit_ex2(*slot, NULL, NULL, iv, encrypt, NULL))
+                return NULL;
+            *cached_out = TRUE;
+            return *slot;
+        }
+    }
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return NULL;
+    if (!EVP_CipherInit_ex2(ctx, cipher, key->keyblock.contents, iv, encrypt,
+                            params)) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+
+    if (slot != NULL) {
+        EVP_CIPHER_CTX_free(*slot);
+        *slot = ctx;
+        *cached_out = TRUE;
+    }
+    return ctx;
+}
+
+EVP_MAC_CTX *
+k5_openssl_mac_ctx(krb5_key key, EVP_MAC *mac, const void *type,
+                   const OSSL_PARAM *params, krb5_boolean *cached_out)
+{
+    struct key_cache *cache;
+    EVP_MAC_CTX *ctx;
+
+    *cached_out = FALSE;
+
+    /* A null key argument to EVP_MAC_init() means to reuse the current key,
+     * so we cannot cache a context for an empty key. */
+    cache = (key->keyblock.length > 0) ? get_key_cache(key) : NULL;
+    if (cache != NULL && cache->mac != NULL && cache->mac_type == type) {
+        if (!EVP_MAC_init(cache->mac, NULL, 0, NULL))
+            return NULL;
+        *cached_out = TRUE;
+        return cache->mac;
+    }
+
+    ctx = EVP_MAC_CTX_new(mac);
+    if (ctx == NULL)
+        return NULL;
+    if (!EVP_MAC_init(ctx, key->keyblock.contents, key->keyblock.length,
+                      params)) {
+        EVP_MAC_CTX_free(ctx);
+        return NULL;
+    }
+
+    if (cache != NULL) {
+        EVP_MAC_CTX_free(cache->mac);
+        cache->mac = ctx;
+        cache->mac_type = type;
+        *cached_out = TRUE;
+    }
+    return ctx;
+}
+
+void
+k5_openssl_key_cleanup(krb5_key key)
+{
+    struct key_cache *cache = key->cache;
+
+    EVP_CIPHER_CTX_free(cache->encrypt);
+    EVP_CIPHER_CTX_free(cache->decrypt);
+    EVP_MAC_CTX_free(cache->mac);
+    free(cache);
+    key->cache = NULL;
+}
+
+#endif /* K5_OPENSSL_FETCH */
@@ -44,11 +44,12 @@ krb5int_cmac_checksum(const struct krb5_enc_provider *enc, krb5_key key,
                       krb5_data *output)
 {
     int ok;
-    EVP_MAC *mac = NULL;
+    const struct k5_openssl_algs *algs = k5_openssl_get_algs();
     EVP_MAC_CTX *ctx = NULL;
     OSSL_PARAM params[2], *p = params;
     size_t i = 0, md_len;
     char *cipher;
+    krb5_boolean cached = FALSE;
 
     if (enc == &krb5int_enc_camellia128)
         cipher = "CAMELLIA-128-CBC";
@@ -57,21 +58,15 @@ krb5int_cmac_checksum(const struct krb5_enc_provider *enc, krb5_key key,
     else
         return KRB5_CRYPTO_INTERNAL;
 
-    mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
-    if (mac == NULL)
+    if (algs == NULL || algs->cmac == NULL)
         return KRB5_CRYPTO_INTERNAL;
 
-    ctx = EVP_MAC_CTX_new(mac);
-    if (ctx == NULL) {
-        ok = 0;
-        goto cleanup;
-    }
-
     *p++ = OSSL_PARAM_construct_utf8_string(OSSL_ALG_PARAM_CIPHER, cipher, 0);
     *p = OSSL_PARAM_construct_end();
 
-    ok = EVP_MAC_init(ctx, key->keyblock.contents, key->keyblock.length,
-                      params);
+    /* Use a context keyed on a previous call with this key, if we can. */
+    ctx = k5_openssl_mac_ctx(key, algs->cmac, enc, params, &cached);
+    ok = (ctx != NULL);
     for (i = 0; ok && i < num_data; i++) {
         const krb5_crypto_iov *iov = &data[i];
         if (!SIGN_IOV(iov))
@@ -85,8 +80,8 @@ krb5int_cmac_checksum(const struct krb5_enc_provider *enc, krb5_key key,
     output->length = md_len;
 
 cleanup:
-    EVP_MAC_free(mac);
-    EVP_MAC_CTX_free(ctx);
+    if (!cached)
+        EVP_MAC_CTX_free(ctx);
     return ok ? 0 : KRB5_CRYPTO_INTERNAL;
 }
 
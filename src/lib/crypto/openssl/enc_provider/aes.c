@@ -146,7 +146,9 @@ do_cts(krb5_key key, const krb5_data *ivec, krb5_crypto_iov *data,
     struct iov_cursor cursor;
     OSSL_PARAM params[2], *p = params;
     EVP_CIPHER_CTX *ctx = NULL;
-    EVP_CIPHER *cipher = NULL;
+    const EVP_CIPHER *cipher = NULL;
+    const struct k5_openssl_algs *algs;
+    krb5_boolean cached = FALSE;
 
     memset(iv_cts, 0, sizeof(iv_cts));
     if (ivec != NULL && ivec->data != NULL){
@@ -155,17 +157,17 @@ do_cts(krb5_key key, const krb5_data *ivec, krb5_crypto_iov *data,
         memcpy(iv_cts, ivec->data, ivec->length);
     }
 
-    if (key->keyblock.length == 16)
-        cipher = EVP_CIPHER_fetch(NULL, "AES-128-CBC-CTS", NULL);
-    else if (key->keyblock.length == 32)
-        cipher = EVP_CIPHER_fetch(NULL, "AES-256-CBC-CTS", NULL);
+    algs = k5_openssl_get_algs();
+    if (algs != NULL && key->keyblock.length == 16)
+        cipher = algs->aes128_cts;
+    else if (algs != NULL && key->keyblock.length == 32)
+        cipher = algs->aes256_cts;
     if (cipher == NULL)
         return KRB5_CRYPTO_INTERNAL;
 
     oblock = OPENSSL_malloc(dlen);
     dbuf = OPENSSL_malloc(dlen);
-    ctx = EVP_CIPHER_CTX_new();
-    if (oblock == NULL || dbuf == NULL || ctx == NULL) {
+    if (oblock == NULL || dbuf == NULL) {
         ret = ENOMEM;
         goto cleanup;
     }
@@ -176,8 +178,9 @@ do_cts(krb5_key key, const krb5_data *ivec, krb5_crypto_iov *data,
     *p++ = OSSL_PARAM_construct_utf8_string(OSSL_CIPHER_PARAM_CTS_MODE,
                                             "CS3", 0);
     *p = OSSL_PARAM_construct_end();
-    if (!EVP_CipherInit_ex2(ctx, cipher, key->keyblock.contents, iv_cts,
-                            encrypt, params) ||
+    ctx = k5_openssl_cipher_ctx(key, cipher, params, iv_cts, encrypt,
+                                &cached);
+    if (ctx == NULL ||
         !EVP_CipherUpdate(ctx, oblock, &outlen, dbuf, dlen) ||
         !EVP_CipherFinal_ex(ctx, oblock + outlen, &len)) {
         ret = KRB5_CRYPTO_INTERNAL;
@@ -196,8 +199,8 @@ do_cts(krb5_key key, const krb5_data *ivec, krb5_crypto_iov *data,
 cleanup:
     OPENSSL_clear_free(oblock, dlen);
     OPENSSL_clear_free(dbuf, dlen);
-    EVP_CIPHER_CTX_free(ctx);
-    EVP_CIPHER_free(cipher);
+    if (!cached)
+        EVP_CIPHER_CTX_free(ctx);
     return ret;
 }
 
@@ -364,6 +367,10 @@ krb5int_aes_decrypt(krb5_key key, const krb5_data *ivec,
     return ret;
 }
 
+#ifndef K5_OPENSSL_FETCH
+#define k5_openssl_key_cleanup NULL
+#endif
+
 static krb5_error_code
 krb5int_aes_init_state (const krb5_keyblock *key, krb5_keyusage usage,
                         krb5_data *state)
@@ -382,7 +389,8 @@ const struct krb5_enc_provider krb5int_enc_aes128 = {
     krb5int_aes_decrypt,
     NULL,
     krb5int_aes_init_state,
-    krb5int_default_free_state
+    krb5int_default_free_state,
+    k5_openssl_key_cleanup      /* NULL if K5_OPENSSL_FETCH not defined */
 };
 
 const struct krb5_enc_provider krb5int_enc_aes256 = {
@@ -392,7 +400,8 @@ const struct krb5_enc_provider krb5int_enc_aes256 = {
     krb5int_aes_decrypt,
     NULL,
     krb5int_aes_init_state,
-    krb5int_default_free_state
+    krb5int_default_free_state,
+    k5_openssl_key_cleanup      /* NULL if K5_OPENSSL_FETCH not defined */
 };
 
 #endif /* K5_OPENSSL_AES */
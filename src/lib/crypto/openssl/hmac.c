@@ -121,39 +121,35 @@ map_digest(const struct krb5_hash_provider *hash)
 
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 
-krb5_error_code
-krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
-                      const krb5_keyblock *keyblock,
-                      const krb5_crypto_iov *data, size_t num_data,
-                      krb5_data *output)
+/* Check the key and output lengths for hash, and set up the HMAC parameters
+ * in params (which must have room for two entries). */
+static krb5_error_code
+hmac_params(const struct krb5_hash_provider *hash, size_t keylen,
+            const krb5_data *output, OSSL_PARAM *params)
 {
-    int ok;
     const EVP_MD *md = map_digest(hash);
-    EVP_MAC *mac = NULL;
-    EVP_MAC_CTX *ctx = NULL;
-    OSSL_PARAM params[2], *p = params;
-    size_t i = 0, md_len;
 
-    if (md == NULL || keyblock->length > hash->blocksize)
+    if (md == NULL || keylen > hash->blocksize)
         return KRB5_CRYPTO_INTERNAL;
     if (output->length < hash->hashsize)
         return KRB5_BAD_MSIZE;
 
-    mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
-    if (mac == NULL)
-        return KRB5_CRYPTO_INTERNAL;
-
-    ctx = EVP_MAC_CTX_new(mac);
-    if (ctx == NULL) {
-        ok = 0;
-        goto cleanup;
-    }
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_ALG_PARAM_DIGEST,
+                                                 (char *)EVP_MD_get0_name(md),
+                                                 0);
+    params[1] = OSSL_PARAM_construct_end();
+    return 0;
+}
 
-    *p++ = OSSL_PARAM_construct_utf8_string(OSSL_ALG_PARAM_DIGEST,
-                                            (char *)EVP_MD_get0_name(md), 0);
-    *p = OSSL_PARAM_construct_end();
+/* Process data with the initialized context ctx and store the MAC in
+ * output. */
+static krb5_error_code
+hmac_finish(EVP_MAC_CTX *ctx, const krb5_crypto_iov *data, size_t num_data,
+            krb5_data *output)
+{
+    int ok = 1;
+    size_t i, md_len;
 
-    ok = EVP_MAC_init(ctx, keyblock->contents, keyblock->length, params);
     for (i = 0; ok && i < num_data; i++) {
         const krb5_crypto_iov *iov = &data[i];
         if (!SIGN_IOV(iov))
@@ -163,13 +159,64 @@ krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
     ok = ok && EVP_MAC_final(ctx, (uint8_t *)output->data, &md_len,
                              output->length);
     if (!ok)
-        goto cleanup;
+        return KRB5_CRYPTO_INTERNAL;
     output->length = md_len;
+    return 0;
+}
+
+krb5_error_code
+krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
+                      const krb5_keyblock *keyblock,
+                      const krb5_crypto_iov *data, size_t num_data,
+                      krb5_data *output)
+{
+    krb5_error_code ret;
+    const struct k5_openssl_algs *algs = k5_openssl_get_algs();
+    EVP_MAC_CTX *ctx;
+    OSSL_PARAM params[2];
+
+    ret = hmac_params(hash, keyblock->length, output, params);
+    if (ret)
+        return ret;
+    if (algs == NULL || algs->hmac == NULL)
+        return KRB5_CRYPTO_INTERNAL;
 
-cleanup:
-    EVP_MAC_free(mac);
+    ctx = EVP_MAC_CTX_new(algs->hmac);
+    if (ctx == NULL)
+        return KRB5_CRYPTO_INTERNAL;
+    if (EVP_MAC_init(ctx, keyblock->contents, keyblock->length, params))
+        ret = hmac_finish(ctx, data, num_data, output);
+    else
+        ret = KRB5_CRYPTO_INTERNAL;
     EVP_MAC_CTX_free(ctx);
-    return ok ? 0 : KRB5_CRYPTO_INTERNAL;
+    return ret;
+}
+
+krb5_error_code
+krb5int_hmac(const struct krb5_hash_provider *hash, krb5_key key,
+             const krb5_crypto_iov *data, size_t num_data,
+             krb5_data *output)
+{
+    krb5_error_code ret;
+    const struct k5_openssl_algs *algs = k5_openssl_get_algs();
+    EVP_MAC_CTX *ctx;
+    OSSL_PARAM params[2];
+    krb5_boolean cached;
+
+    ret = hmac_params(hash, key->keyblock.length, output, params);
+    if (ret)
+        return ret;
+    if (algs == NULL || algs->hmac == NULL)
+        return KRB5_CRYPTO_INTERNAL;
+
+    /* Use a context keyed on a previous call with this key, if we can. */
+    ctx = k5_openssl_mac_ctx(key, algs->hmac, hash, params, &cached);
+    if (ctx == NULL)
+        return KRB5_CRYPTO_INTERNAL;
+    ret = hmac_finish(ctx, data, num_data, output);
+    if (!cached)
+        EVP_MAC_CTX_free(ctx);
+    return ret;
 }
 
 #else /* OPENSSL_VERSION_NUMBER < 0x30000000L */
@@ -218,8 +265,6 @@ krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
     return ok ? 0 : KRB5_CRYPTO_INTERNAL;
 }
 
-#endif /* OPENSSL_VERSION_NUMBER < 0x30000000L */
-
 krb5_error_code
 krb5int_hmac(const struct krb5_hash_provider *hash, krb5_key key,
              const krb5_crypto_iov *data, size_t num_data,
@@ -228,4 +273,6 @@ krb5int_hmac(const struct krb5_hash_provider *hash, krb5_key key,
     return krb5int_hmac_keyblock(hash, &key->keyblock, data, num_data, output);
 }
 
+#endif /* OPENSSL_VERSION_NUMBER < 0x30000000L */
+
 #endif /* K5_OPENSSL_HMAC */
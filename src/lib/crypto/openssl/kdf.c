@@ -71,7 +71,7 @@ k5_sp800_108_counter_hmac(const struct krb5_hash_provider *hash,
                           const krb5_data *context, krb5_data *rnd_out)
 {
     krb5_error_code ret;
-    EVP_KDF *kdf = NULL;
+    const struct k5_openssl_algs *algs;
     EVP_KDF_CTX *kctx = NULL;
     OSSL_PARAM params[6], *p = params;
     char *digest;
@@ -82,13 +82,13 @@ k5_sp800_108_counter_hmac(const struct krb5_hash_provider *hash,
         goto done;
     }
 
-    kdf = EVP_KDF_fetch(NULL, "KBKDF", NULL);
-    if (!kdf) {
+    algs = k5_openssl_get_algs();
+    if (algs == NULL || algs->kbkdf == NULL) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
     }
 
-    kctx = EVP_KDF_CTX_new(kdf);
+    kctx = EVP_KDF_CTX_new(algs->kbkdf);
     if (!kctx) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
@@ -115,7 +115,6 @@ k5_sp800_108_counter_hmac(const struct krb5_hash_provider *hash,
 done:
     if (ret)
         zap(rnd_out->data, rnd_out->length);
-    EVP_KDF_free(kdf);
     EVP_KDF_CTX_free(kctx);
     return ret;
 }
@@ -125,7 +124,7 @@ k5_sp800_108_feedback_cmac(const struct krb5_enc_provider *enc, krb5_key key,
                            const krb5_data *label, krb5_data *rnd_out)
 {
     krb5_error_code ret;
-    EVP_KDF *kdf = NULL;
+    const struct k5_openssl_algs *algs;
     EVP_KDF_CTX *kctx = NULL;
     OSSL_PARAM params[7], *p = params;
     char *cipher;
@@ -139,13 +138,13 @@ k5_sp800_108_feedback_cmac(const struct krb5_enc_provider *enc, krb5_key key,
         goto done;
     }
 
-    kdf = EVP_KDF_fetch(NULL, "KBKDF", NULL);
-    if (!kdf) {
+    algs = k5_openssl_get_algs();
+    if (algs == NULL || algs->kbkdf == NULL) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
     }
 
-    kctx = EVP_KDF_CTX_new(kdf);
+    kctx = EVP_KDF_CTX_new(algs->kbkdf);
     if (!kctx) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
@@ -174,7 +173,6 @@ k5_sp800_108_feedback_cmac(const struct krb5_enc_provider *enc, krb5_key key,
 done:
     if (ret)
         zap(rnd_out->data, rnd_out->length);
-    EVP_KDF_free(kdf);
     EVP_KDF_CTX_free(kctx);
     return ret;
 }
@@ -184,7 +182,7 @@ k5_derive_random_rfc3961(const struct krb5_enc_provider *enc, krb5_key key,
                          const krb5_data *constant, krb5_data *rnd_out)
 {
     krb5_error_code ret;
-    EVP_KDF *kdf = NULL;
+    const struct k5_openssl_algs *algs;
     EVP_KDF_CTX *kctx = NULL;
     OSSL_PARAM params[4], *p = params;
     char *cipher;
@@ -200,13 +198,13 @@ k5_derive_random_rfc3961(const struct krb5_enc_provider *enc, krb5_key key,
         goto done;
     }
 
-    kdf = EVP_KDF_fetch(NULL, "KRB5KDF", NULL);
-    if (kdf == NULL) {
+    algs = k5_openssl_get_algs();
+    if (algs == NULL || algs->krb5kdf == NULL) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
     }
 
-    kctx = EVP_KDF_CTX_new(kdf);
+    kctx = EVP_KDF_CTX_new(algs->krb5kdf);
     if (kctx == NULL) {
         ret = KRB5_CRYPTO_INTERNAL;
         goto done;
@@ -229,7 +227,6 @@ k5_derive_random_rfc3961(const struct krb5_enc_provider *enc, krb5_key key,
 done:
     if (ret)
         zap(rnd_out->data, rnd_out->length);
-    EVP_KDF_free(kdf);
     EVP_KDF_CTX_free(kctx);
     return ret;
 }
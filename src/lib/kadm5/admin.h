@@ -287,6 +287,29 @@ typedef struct _kadm5_key_data {
     krb5_keysalt    salt;
 } kadm5_key_data;
 
+/* Operations for kadm5_batch(). */
+#define KADM5_BATCH_CREATE      1
+#define KADM5_BATCH_MODIFY      2
+#define KADM5_BATCH_RANDKEY     3
+#define KADM5_BATCH_DELETE      4
+
+/*
+ * One principal change for kadm5_batch().  rec.principal names the target of
+ * every operation.  rec and mask are as for kadm5_create_principal_3() or
+ * kadm5_modify_principal(); password (NULL for a random key), n_ks_tuple, and
+ * ks_tuple are used for creation; keepold, n_ks_tuple, and ks_tuple are used
+ * for key randomization.
+ */
+typedef struct _kadm5_batch_op {
+    int                     op;
+    kadm5_principal_ent_rec rec;
+    long                    mask;
+    char                    *password;
+    krb5_boolean            keepold;
+    int                     n_ks_tuple;
+    krb5_key_salt_tuple     *ks_tuple;
+} kadm5_batch_op;
+
 /*
  * functions
  */
@@ -453,6 +476,34 @@ kadm5_ret_t    kadm5_get_principals(void *server_handle,
                                     char *exp, char ***princs,
                                     int *count);
 
+/*
+ * Retrieve up to max names of principals matching exp, in ascending bytewise
+ * order, beginning after the name after (or at the first name if after is
+ * NULL).  Set *more to true if there are more matching names.  The server may
+ * return fewer than max names on a page which is not the last.  Free the
+ * result with kadm5_free_name_list().
+ */
+kadm5_ret_t    kadm5_get_principals_page(void *server_handle, char *exp,
+                                         char *after, int max,
+                                         char ***princs, int *count,
+                                         krb5_boolean *more);
+
+/* Invoke func with each name of a principal matching exp, without retrieving
+ * the whole list at once. */
+kadm5_ret_t    kadm5_iter_principals(void *server_handle, char *exp,
+                                     void (*func)(void *, const char *),
+                                     void *data);
+
+/*
+ * Perform the principal changes in ops in order, setting results[i] to the
+ * result of ops[i].  The server applies up to a bounded number of changes
+ * per request while holding the database lock, and syncs the update log once
+ * for each request.  Randomized keys are not returned.  If the return value
+ * is nonzero, some results may not be set.
+ */
+kadm5_ret_t    kadm5_batch(void *server_handle, kadm5_batch_op *ops,
+                           int n_ops, kadm5_ret_t *results);
+
 kadm5_ret_t    kadm5_get_policies(void *server_handle,
                                   char *exp, char ***pols,
                                   int *count);
@@ -21,6 +21,9 @@
 #define eret() do { return KADM5_RPC_ERROR; } while (0)
 #endif
 
+/* Number of names requested per page by kadm5_iter_principals(). */
+#define PRINCS_PAGE_SIZE 1000
+
 kadm5_ret_t
 kadm5_create_principal(void *server_handle,
                        kadm5_principal_ent_t princ, long mask,
@@ -206,6 +209,107 @@ kadm5_get_principals(void *server_handle,
     return r.code;
 }
 
+kadm5_ret_t
+kadm5_get_principals_page(void *server_handle, char *exp, char *after,
+                          int max, char ***princs, int *count,
+                          krb5_boolean *more)
+{
+    gprincs_page_arg arg;
+    gprincs_page_ret r;
+    kadm5_server_handle_t handle = server_handle;
+
+    CHECK_HANDLE(server_handle);
+
+    if (princs == NULL || count == NULL || more == NULL)
+        return EINVAL;
+    arg.api_version = handle->api_version;
+    arg.exp = exp;
+    arg.after = after;
+    arg.max = max;
+    memset(&r, 0, sizeof(gprincs_page_ret));
+    if (get_princs_page_2(&arg, &r, handle->clnt))
+        eret();
+    if (r.code == 0) {
+        *count = r.count;
+        *princs = r.princs;
+        *more = r.more;
+    } else {
+        *count = 0;
+        *princs = NULL;
+        *more = FALSE;
+    }
+
+    return r.code;
+}
+
+/* Invoke func for each name in a single list retrieved from a server which
+ * does not support paged listing. */
+static kadm5_ret_t
+iter_principals_unpaged(kadm5_server_handle_t handle, char *exp,
+                        void (*func)(void *, const char *), void *data)
+{
+    kadm5_ret_t ret;
+    char **names;
+    int i, count;
+
+    ret = kadm5_get_principals(handle, exp, &names, &count);
+    if (ret)
+        return ret;
+    for (i = 0; i < count; i++)
+        func(data, names[i]);
+    kadm5_free_name_list(handle, names, count);
+    return 0;
+}
+
+kadm5_ret_t
+kadm5_iter_principals(void *server_handle, char *exp,
+                      void (*func)(void *, const char *), void *data)
+{
+    gprincs_page_arg arg;
+    gprincs_page_ret r;
+    enum clnt_stat stat;
+    kadm5_ret_t ret = 0;
+    kadm5_server_handle_t handle = server_handle;
+    char *after = NULL;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+
+    arg.api_version = handle->api_version;
+    arg.exp = exp;
+    arg.max = PRINCS_PAGE_SIZE;
+    for (;;) {
+        arg.after = after;
+        memset(&r, 0, sizeof(gprincs_page_ret));
+        stat = get_princs_page_2(&arg, &r, handle->clnt);
+        if (stat == RPC_PROCUNAVAIL && after == NULL)
+            return iter_principals_unpaged(handle, exp, func, data);
+        if (stat) {
+            ret = KADM5_RPC_ERROR;
+            break;
+        }
+        ret = r.code;
+        if (ret)
+            break;
+
+        for (i = 0; i < r.count; i++)
+            func(data, r.princs[i]);
+        free(after);
+        after = NULL;
+        if (r.more && r.count > 0) {
+            after = strdup(r.princs[r.count - 1]);
+            if (after == NULL)
+                ret = ENOMEM;
+        }
+        kadm5_free_name_list(handle, r.princs, r.count);
+        if (after == NULL)
+            break;
+    }
+
+    free(after);
+    return ret;
+}
+
 kadm5_ret_t
 kadm5_rename_principal(void *server_handle,
                        krb5_principal source, krb5_principal dest)
@@ -421,6 +525,146 @@ kadm5_randkey_principal(void *server_handle,
     return r.code;
 }
 
+/* Copy the fields of rec selected by mask into an RPC argument record. */
+static void
+copy_rec_for_rpc(kadm5_principal_ent_rec *out,
+                 const kadm5_principal_ent_rec *rec, long mask)
+{
+    *out = *rec;
+    out->mod_name = NULL;
+    if (!(mask & KADM5_POLICY))
+        out->policy = NULL;
+    if (!(mask & KADM5_KEY_DATA)) {
+        out->n_key_data = 0;
+        out->key_data = NULL;
+    }
+    if (!(mask & KADM5_TL_DATA)) {
+        out->n_tl_data = 0;
+        out->tl_data = NULL;
+    }
+}
+
+/* Convert a kadm5_batch() operation into an RPC batch item. */
+static void
+make_batch_item(kadm5_server_handle_t handle, kadm5_batch_op *op,
+                batch_item *item)
+{
+    memset(item, 0, sizeof(*item));
+    item->op = op->op;
+    switch (op->op) {
+    case KADM5_BATCH_CREATE:
+        item->u.cprinc.api_version = handle->api_version;
+        copy_rec_for_rpc(&item->u.cprinc.rec, &op->rec, op->mask);
+        item->u.cprinc.mask = op->mask;
+        item->u.cprinc.n_ks_tuple = op->n_ks_tuple;
+        item->u.cprinc.ks_tuple = op->ks_tuple;
+        item->u.cprinc.passwd = op->password;
+        break;
+    case KADM5_BATCH_MODIFY:
+        item->u.mprinc.api_version = handle->api_version;
+        copy_rec_for_rpc(&item->u.mprinc.rec, &op->rec, op->mask);
+        item->u.mprinc.mask = op->mask;
+        break;
+    case KADM5_BATCH_RANDKEY:
+        item->u.chrand.api_version = handle->api_version;
+        item->u.chrand.princ = op->rec.principal;
+        item->u.chrand.keepold = op->keepold;
+        item->u.chrand.n_ks_tuple = op->n_ks_tuple;
+        item->u.chrand.ks_tuple = op->ks_tuple;
+        break;
+    case KADM5_BATCH_DELETE:
+        item->u.dprinc.api_version = handle->api_version;
+        item->u.dprinc.princ = op->rec.principal;
+        break;
+    }
+}
+
+/* Perform a kadm5_batch() operation with its own request, for servers which
+ * do not support batching. */
+static kadm5_ret_t
+batch_op_unbatched(kadm5_server_handle_t handle, kadm5_batch_op *op)
+{
+    switch (op->op) {
+    case KADM5_BATCH_CREATE:
+        return kadm5_create_principal_3(handle, &op->rec, op->mask,
+                                        op->n_ks_tuple, op->ks_tuple,
+                                        op->password);
+    case KADM5_BATCH_MODIFY:
+        return kadm5_modify_principal(handle, &op->rec, op->mask);
+    case KADM5_BATCH_RANDKEY:
+        return kadm5_randkey_principal_3(handle, op->rec.principal,
+                                         op->keepold, op->n_ks_tuple,
+                                         op->ks_tuple, NULL, NULL);
+    case KADM5_BATCH_DELETE:
+        return kadm5_delete_principal(handle, op->rec.principal);
+    default:
+        return EINVAL;
+    }
+}
+
+kadm5_ret_t
+kadm5_batch(void *server_handle, kadm5_batch_op *ops, int n_ops,
+            kadm5_ret_t *results)
+{
+    batch_arg arg;
+    batch_ret r;
+    batch_item *items = NULL;
+    enum clnt_stat stat;
+    kadm5_ret_t ret = 0;
+    kadm5_server_handle_t handle = server_handle;
+    int i, n, start;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_ops < 0 || (n_ops > 0 && (ops == NULL || results == NULL)))
+        return EINVAL;
+    for (i = 0; i < n_ops; i++) {
+        if (ops[i].op < KADM5_BATCH_CREATE || ops[i].op > KADM5_BATCH_DELETE ||
+            ops[i].rec.principal == NULL)
+            return EINVAL;
+    }
+    if (n_ops == 0)
+        return 0;
+
+    items = calloc(KADM5_MAX_BATCH, sizeof(*items));
+    if (items == NULL)
+        return ENOMEM;
+
+    arg.api_version = handle->api_version;
+    arg.items = items;
+    for (start = 0; start < n_ops; start += n) {
+        n = n_ops - start;
+        if (n > KADM5_MAX_BATCH)
+            n = KADM5_MAX_BATCH;
+        for (i = 0; i < n; i++)
+            make_batch_item(handle, &ops[start + i], &items[i]);
+        arg.n_items = n;
+
+        memset(&r, 0, sizeof(r));
+        stat = batch_principals_2(&arg, &r, handle->clnt);
+        if (stat == RPC_PROCUNAVAIL && start == 0) {
+            for (i = 0; i < n_ops; i++)
+                results[i] = batch_op_unbatched(handle, &ops[i]);
+            break;
+        }
+        if (stat) {
+            ret = KADM5_RPC_ERROR;
+            break;
+        }
+        ret = r.code;
+        if (ret == 0 && r.n_codes != n)
+            ret = KADM5_RPC_ERROR;
+        if (ret == 0)
+            memcpy(&results[start], r.codes, n * sizeof(*results));
+        free(r.codes);
+        if (ret)
+            break;
+    }
+
+    free(items);
+    return ret;
+}
+
 /* not supported on client side */
 kadm5_ret_t kadm5_decrypt_key(void *server_handle,
                               kadm5_principal_ent_t entry, krb5_int32
@@ -212,3 +212,19 @@ get_principal_keys_2(getpkeys_arg *argp, getpkeys_ret *res, CLIENT *clnt)
 			 (xdrproc_t)xdr_getpkeys_arg, (caddr_t)argp,
 			 (xdrproc_t)xdr_getpkeys_ret, (caddr_t)res, TIMEOUT);
 }
+
+enum clnt_stat
+get_princs_page_2(gprincs_page_arg *argp, gprincs_page_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, GET_PRINCS_PAGE,
+			 (xdrproc_t)xdr_gprincs_page_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_gprincs_page_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+batch_principals_2(batch_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, BATCH_PRINCIPALS,
+			 (xdrproc_t)xdr_batch_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
@@ -246,6 +246,56 @@ struct getpkeys_ret {
 };
 typedef struct getpkeys_ret getpkeys_ret;
 
+struct gprincs_page_arg {
+	krb5_ui_4 api_version;
+	char *exp;
+	char *after;
+	int max;
+};
+typedef struct gprincs_page_arg gprincs_page_arg;
+
+struct gprincs_page_ret {
+	krb5_ui_4 api_version;
+	kadm5_ret_t code;
+	char **princs;
+	int count;
+	krb5_boolean more;
+};
+typedef struct gprincs_page_ret gprincs_page_ret;
+
+struct batch_item {
+	int op;
+	union {
+		cprinc3_arg cprinc;
+		mprinc_arg mprinc;
+		chrand3_arg chrand;
+		dprinc_arg dprinc;
+	} u;
+};
+typedef struct batch_item batch_item;
+
+struct batch_arg {
+	krb5_ui_4 api_version;
+	batch_item *items;
+	int n_items;
+};
+typedef struct batch_arg batch_arg;
+
+/*
+ * The maximum number of principal changes made in one batch.  The database
+ * lock is held across a batch, so this bounds how long a batch can make the
+ * KDC wait.
+ */
+#define KADM5_MAX_BATCH 100
+
+struct batch_ret {
+	krb5_ui_4 api_version;
+	kadm5_ret_t code;
+	kadm5_ret_t *codes;
+	int n_codes;
+};
+typedef struct batch_ret batch_ret;
+
 #define KADM 2112
 #define KADMVERS 2
 #define CREATE_PRINCIPAL 1
@@ -360,4 +410,13 @@ extern enum clnt_stat get_principal_keys_2(getpkeys_arg *, getpkeys_ret *,
 					   CLIENT *);
 extern  bool_t get_principal_keys_2_svc(getpkeys_arg *, getpkeys_ret *,
 					struct svc_req *);
+#define GET_PRINCS_PAGE 27
+extern enum clnt_stat get_princs_page_2(gprincs_page_arg *,
+					gprincs_page_ret *, CLIENT *);
+extern  bool_t get_princs_page_2_svc(gprincs_page_arg *, gprincs_page_ret *,
+				     struct svc_req *);
+#define BATCH_PRINCIPALS 28
+extern enum clnt_stat batch_principals_2(batch_arg *, batch_ret *, CLIENT *);
+extern  bool_t batch_principals_2_svc(batch_arg *, batch_ret *,
+				      struct svc_req *);
 #endif /* __KADM_RPC_H__ */
@@ -1209,3 +1209,97 @@ xdr_getpkeys_ret(XDR *xdrs, getpkeys_ret *objp)
 	}
 	return TRUE;
 }
+
+bool_t
+xdr_gprincs_page_arg(XDR *xdrs, gprincs_page_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_nullstring(xdrs, &objp->exp)) {
+		return FALSE;
+	}
+	if (!xdr_nullstring(xdrs, &objp->after)) {
+		return FALSE;
+	}
+	if (!xdr_int(xdrs, &objp->max)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_gprincs_page_ret(XDR *xdrs, gprincs_page_ret *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_kadm5_ret_t(xdrs, &objp->code)) {
+		return FALSE;
+	}
+	if (objp->code == KADM5_OK) {
+		if (!xdr_array(xdrs, (caddr_t *) &objp->princs,
+			       (unsigned int *) &objp->count, ~0,
+			       sizeof(char *), (xdrproc_t)xdr_nullstring)) {
+			return FALSE;
+		}
+		if (!xdr_krb5_boolean(xdrs, &objp->more)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_batch_item(XDR *xdrs, batch_item *objp)
+{
+	if (!xdr_int(xdrs, &objp->op)) {
+		return FALSE;
+	}
+	switch (objp->op) {
+	case KADM5_BATCH_CREATE:
+		return xdr_cprinc3_arg(xdrs, &objp->u.cprinc);
+	case KADM5_BATCH_MODIFY:
+		return xdr_mprinc_arg(xdrs, &objp->u.mprinc);
+	case KADM5_BATCH_RANDKEY:
+		return xdr_chrand3_arg(xdrs, &objp->u.chrand);
+	case KADM5_BATCH_DELETE:
+		return xdr_dprinc_arg(xdrs, &objp->u.dprinc);
+	default:
+		return FALSE;
+	}
+}
+
+bool_t
+xdr_batch_arg(XDR *xdrs, batch_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->items,
+		       (unsigned int *) &objp->n_items, KADM5_MAX_BATCH,
+		       sizeof(batch_item), (xdrproc_t)xdr_batch_item)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_batch_ret(XDR *xdrs, batch_ret *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_kadm5_ret_t(xdrs, &objp->code)) {
+		return FALSE;
+	}
+	if (objp->code == KADM5_OK) {
+		if (!xdr_array(xdrs, (caddr_t *) &objp->codes,
+			       (unsigned int *) &objp->n_codes, ~0,
+			       sizeof(kadm5_ret_t),
+			       (xdrproc_t)xdr_kadm5_ret_t)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -37,6 +37,9 @@
 #include <ctype.h>
 #include <syslog.h>
 #include <stdarg.h>
+#ifdef ENABLE_THREADS
+#include <pthread.h>
+#endif
 
 #define KRB5_KLOG_MAX_ERRMSG_SIZE       2048
 #ifndef MAXHOSTNAMELEN
@@ -147,6 +150,9 @@ static struct log_control log_control = {
 };
 static struct log_entry def_log_entry;
 
+static void init_queue(int size);
+static void free_queue(void);
+
 /*
  * These macros define any special processing that needs to happen for
  * devices.  For unix, of course, this is hardly anything.
@@ -237,7 +243,7 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
     int         i, ngood, fd, append;
     char        *cp, *cp2;
     char        savec = '\0';
-    int         error, debug;
+    int         error, debug, queue_size;
     int         do_openlog, log_facility;
     FILE        *f = NULL;
 
@@ -253,6 +259,13 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
                              KRB5_CONF_DEBUG, NULL, 0, &debug))
         log_control.log_debug = debug;
 
+    /* Look up [logging]->queue_size to see if messages should be written
+     * asynchronously.  Default to synchronous output. */
+    if (!profile_get_integer(kcontext->profile, KRB5_CONF_LOGGING,
+                             KRB5_CONF_QUEUE_SIZE, NULL, 0, &queue_size) &&
+        queue_size > 0)
+        init_queue(queue_size);
+
     /*
      * Look up [logging]-><ename> in the profile.  If that doesn't
      * succeed, then look for [logging]->default.
@@ -536,6 +549,7 @@ krb5_klog_close(krb5_context kcontext)
 {
     int lindex;
     (void) reset_com_err_hook();
+    free_queue();
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         switch (log_control.log_entries[lindex].log_type) {
         case K_LOG_FILE:
@@ -618,37 +632,35 @@ severity2string(int severity)
 }
 
 /*
- * krb5_klog_syslog()   - Simulate the calling sequence of syslog(3), while
- *                        also performing the logging redirection as specified
- *                        by krb5_klog_init().
+ * Format a syslog-esque message into outbuf, of the format:
+ *
+ * (verbose form)
+ *          <date> <hostname> <id>[<pid>](<priority>): <message>
+ *
+ * (short form)
+ *          <date> <message>
+ *
+ * Set *syslog_off to the offset of the message text within outbuf, as the
+ * system log provides its own header.  Return -1 on failure.
  */
 static int
-klog_vsyslog(int priority, const char *format, va_list arglist)
+format_message(char *outbuf, size_t bufsize, size_t *syslog_off, int priority,
+               const char *format, va_list arglist)
 #if !defined(__cplusplus) && (__GNUC__ > 2)
-    __attribute__((__format__(__printf__, 2, 0)))
+    __attribute__((__format__(__printf__, 5, 0)))
 #endif
     ;
 
 static int
-klog_vsyslog(int priority, const char *format, va_list arglist)
+format_message(char *outbuf, size_t bufsize, size_t *syslog_off, int priority,
+               const char *format, va_list arglist)
 {
-    char        outbuf[KRB5_KLOG_MAX_ERRMSG_SIZE];
-    int         lindex;
     char        *syslogp;
     char        *cp;
     time_t      now;
     size_t      soff;
     struct tm  *tm;
 
-    /*
-     * Format a syslog-esque message of the format:
-     *
-     * (verbose form)
-     *          <date> <hostname> <id>[<pid>](<priority>): <message>
-     *
-     * (short form)
-     *          <date> <message>
-     */
     cp = outbuf;
     (void) time(&now);
 
@@ -658,39 +670,39 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
     tm = localtime(&now);
     if (tm == NULL)
         return(-1);
-    soff = strftime(outbuf, sizeof(outbuf), "%b %d %H:%M:%S", tm);
+    soff = strftime(outbuf, bufsize, "%b %d %H:%M:%S", tm);
     if (soff > 0)
         cp += soff;
     else
         return(-1);
 
 #ifdef VERBOSE_LOGS
-    snprintf(cp, sizeof(outbuf) - (cp-outbuf), " %s %s[%ld](%s): ",
+    snprintf(cp, bufsize - (cp-outbuf), " %s %s[%ld](%s): ",
              log_control.log_hostname ? log_control.log_hostname : "",
              log_control.log_whoami ? log_control.log_whoami : "",
              (long) getpid(),
              severity2string(priority));
 #else
-    snprintf(cp, sizeof(outbuf) - (cp-outbuf), " ");
+    snprintf(cp, bufsize - (cp-outbuf), " ");
 #endif
     syslogp = &outbuf[strlen(outbuf)];
 
     /* Now format the actual message */
-    vsnprintf(syslogp, sizeof(outbuf) - (syslogp - outbuf), format, arglist);
+    vsnprintf(syslogp, bufsize - (syslogp - outbuf), format, arglist);
+    *syslog_off = syslogp - outbuf;
+    return(0);
+}
 
-    /*
-     * If the user did not use krb5_klog_init() instead of dropping
-     * the request on the floor, syslog it - if it exists
-     */
-    if (log_control.log_nentries == 0) {
-        /* Log the message with our header trimmed off */
-        syslog(priority, "%s", syslogp);
-    }
+/*
+ * Write a formatted message to each logging specification.  Flush file
+ * outputs if flush is true; otherwise the caller must call flush_files().
+ */
+static void
+write_message(int priority, const char *outbuf, const char *syslogp,
+              krb5_boolean flush)
+{
+    int         lindex;
 
-    /*
-     * Now that we have the message formatted, perform the output to each
-     * logging specification.
-     */
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         /* Omit LOG_DEBUG messages for non-syslog outputs unless we are
          * configured to include them. */
@@ -710,7 +722,7 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
                 fprintf(stderr, log_file_err, log_control.log_whoami,
                         log_control.log_entries[lindex].lfu_fname);
             }
-            else {
+            else if (flush) {
                 fflush(log_control.log_entries[lindex].lfu_filep);
             }
             break;
@@ -738,6 +750,347 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
             break;
         }
     }
+}
+
+#ifdef ENABLE_THREADS
+
+/*
+ * Asynchronous logging.
+ *
+ * If [logging]->queue_size is set to a positive value, messages are formatted
+ * by the caller and placed in a bounded queue, and a writer thread performs
+ * the output.  The writer takes all queued messages at once, writes them, and
+ * then flushes the file outputs, so files are flushed once per batch rather
+ * than once per message.  If the queue is full, the message is discarded and
+ * counted rather than making the caller wait; the writer reports the count.
+ *
+ * Threads do not survive fork(), so the writer is started on first use in each
+ * process.  A fork handler waits for the queue to drain before the fork, so
+ * that a parent which exits right away (as with daemon()) does not lose
+ * messages and a child does not inherit them.
+ */
+
+struct log_record {
+    int         priority;
+    size_t      syslog_off;
+    char        *msg;
+};
+
+struct log_queue {
+    pthread_mutex_t     lock;
+    pthread_cond_t      nonempty;
+    pthread_cond_t      idle;
+    pthread_t           writer;
+    krb5_boolean        running;        /* Writer started in this process */
+    krb5_boolean        busy;           /* Writer is writing a batch */
+    krb5_boolean        stop;
+    krb5_boolean        atfork_set;
+
+    /* Circular queue of messages awaiting the writer, and the writer's batch
+     * buffer.  Both have room for size messages.  size is 0 if asynchronous
+     * logging is not configured. */
+    struct log_record   *queue;
+    struct log_record   *batch;
+    size_t              size;
+    size_t              head;
+    size_t              count;
+    unsigned long       ndropped;       /* Dropped since last reported */
+};
+
+static struct log_queue log_queue = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER
+};
+
+/* Format and write a message from the writer thread without flushing. */
+static void
+writer_log(int priority, const char *format, ...)
+#if !defined(__cplusplus) && (__GNUC__ > 2)
+    __attribute__((__format__(__printf__, 2, 3)))
+#endif
+    ;
+
+static void
+writer_log(int priority, const char *format, ...)
+{
+    char        outbuf[KRB5_KLOG_MAX_ERRMSG_SIZE];
+    size_t      soff;
+    va_list     pvar;
+    int         ret;
+
+    va_start(pvar, format);
+    ret = format_message(outbuf, sizeof(outbuf), &soff, priority, format,
+                         pvar);
+    va_end(pvar);
+    if (ret == 0)
+        write_message(priority, outbuf, outbuf + soff, FALSE);
+}
+
+/* Flush the stdio buffers of file outputs. */
+static void
+flush_files(void)
+{
+    int lindex;
+
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        if (log_control.log_entries[lindex].log_type == K_LOG_FILE ||
+            log_control.log_entries[lindex].log_type == K_LOG_STDERR)
+            fflush(log_control.log_entries[lindex].lfu_filep);
+    }
+}
+
+/* Write queued messages in batches until told to stop and the queue is
+ * drained. */
+static void *
+writer_thread(void *arg)
+{
+    struct log_record *rec;
+    unsigned long ndropped;
+    size_t i, n;
+
+    pthread_mutex_lock(&log_queue.lock);
+    for (;;) {
+        while (log_queue.count == 0 && log_queue.ndropped == 0 &&
+               !log_queue.stop)
+            pthread_cond_wait(&log_queue.nonempty, &log_queue.lock);
+        if (log_queue.count == 0 && log_queue.ndropped == 0)
+            break;
+
+        /* Take everything in the queue. */
+        n = log_queue.count;
+        for (i = 0; i < n; i++) {
+            log_queue.batch[i] = log_queue.queue[log_queue.head];
+            log_queue.head = (log_queue.head + 1) % log_queue.size;
+        }
+        log_queue.count = 0;
+        ndropped = log_queue.ndropped;
+        log_queue.ndropped = 0;
+        log_queue.busy = TRUE;
+        pthread_mutex_unlock(&log_queue.lock);
+
+        for (i = 0; i < n; i++) {
+            rec = &log_queue.batch[i];
+            write_message(rec->priority, rec->msg, rec->msg + rec->syslog_off,
+                          FALSE);
+            free(rec->msg);
+        }
+        if (ndropped > 0) {
+            writer_log(LOG_WARNING, _("%lu log messages dropped"),
+                       ndropped);
+        }
+        flush_files();
+
+        pthread_mutex_lock(&log_queue.lock);
+        log_queue.busy = FALSE;
+        pthread_cond_broadcast(&log_queue.idle);
+    }
+    pthread_mutex_unlock(&log_queue.lock);
+    return NULL;
+}
+
+/* Wait until the writer has written everything queued.  Call with the queue
+ * lock held. */
+static void
+wait_for_writer(void)
+{
+    while (log_queue.running && (log_queue.count > 0 ||
+                                 log_queue.ndropped > 0 || log_queue.busy))
+        pthread_cond_wait(&log_queue.idle, &log_queue.lock);
+}
+
+static void
+atfork_prepare(void)
+{
+    pthread_mutex_lock(&log_queue.lock);
+    wait_for_writer();
+}
+
+static void
+atfork_parent(void)
+{
+    pthread_mutex_unlock(&log_queue.lock);
+}
+
+static void
+atfork_child(void)
+{
+    /* The writer thread does not exist in the child.  The condition
+     * variables may record it as a waiter, so reinitialize them. */
+    log_queue.running = FALSE;
+    pthread_cond_init(&log_queue.nonempty, NULL);
+    pthread_cond_init(&log_queue.idle, NULL);
+    pthread_mutex_unlock(&log_queue.lock);
+}
+
+/* Allocate a queue for size messages. */
+static void
+init_queue(int size)
+{
+    log_queue.queue = calloc(size, sizeof(*log_queue.queue));
+    log_queue.batch = calloc(size, sizeof(*log_queue.batch));
+    if (log_queue.queue == NULL || log_queue.batch == NULL) {
+        free(log_queue.queue);
+        free(log_queue.batch);
+        log_queue.queue = log_queue.batch = NULL;
+        return;
+    }
+    if (!log_queue.atfork_set) {
+        if (pthread_atfork(atfork_prepare, atfork_parent, atfork_child) != 0)
+            return;
+        log_queue.atfork_set = TRUE;
+    }
+    log_queue.size = size;
+    log_queue.head = log_queue.count = 0;
+    log_queue.ndropped = 0;
+}
+
+/* Stop the writer after it drains the queue, and free the queue. */
+static void
+free_queue(void)
+{
+    krb5_boolean running;
+
+    pthread_mutex_lock(&log_queue.lock);
+    running = log_queue.running;
+    log_queue.stop = TRUE;
+    pthread_cond_signal(&log_queue.nonempty);
+    pthread_mutex_unlock(&log_queue.lock);
+    if (running)
+        pthread_join(log_queue.writer, NULL);
+
+    log_queue.running = log_queue.stop = FALSE;
+    free(log_queue.queue);
+    free(log_queue.batch);
+    log_queue.queue = log_queue.batch = NULL;
+    log_queue.size = 0;
+}
+
+/*
+ * Queue a formatted message for the writer thread, starting the writer if
+ * necessary.  Return 0 if the message was queued or dropped, or -1 if it
+ * should be written synchronously.
+ */
+static int
+queue_message(int priority, const char *outbuf, size_t syslog_off)
+{
+    struct log_record *rec;
+    char *msg;
+    int ret = -1;
+
+    if (log_queue.size == 0)
+        return -1;
+
+    pthread_mutex_lock(&log_queue.lock);
+    if (!log_queue.running) {
+        if (pthread_create(&log_queue.writer, NULL, writer_thread,
+                           NULL) != 0)
+            goto cleanup;
+        log_queue.running = TRUE;
+    }
+    if (log_queue.count == log_queue.size) {
+        log_queue.ndropped++;
+        ret = 0;
+        goto cleanup;
+    }
+    msg = strdup(outbuf);
+    if (msg == NULL)
+        goto cleanup;
+    rec = &log_queue.queue[(log_queue.head + log_queue.count) %
+                           log_queue.size];
+    rec->priority = priority;
+    rec->syslog_off = syslog_off;
+    rec->msg = msg;
+    log_queue.count++;
+    pthread_cond_signal(&log_queue.nonempty);
+    ret = 0;
+
+cleanup:
+    pthread_mutex_unlock(&log_queue.lock);
+    return ret;
+}
+
+/* Keep the writer from using the log outputs until unlock_outputs(). */
+static void
+lock_outputs(void)
+{
+    pthread_mutex_lock(&log_queue.lock);
+    while (log_queue.busy)
+        pthread_cond_wait(&log_queue.idle, &log_queue.lock);
+}
+
+static void
+unlock_outputs(void)
+{
+    pthread_mutex_unlock(&log_queue.lock);
+}
+
+#else /* !ENABLE_THREADS */
+
+static void
+init_queue(int size)
+{
+}
+
+static void
+free_queue(void)
+{
+}
+
+static int
+queue_message(int priority, const char *outbuf, size_t syslog_off)
+{
+    return -1;
+}
+
+static void
+lock_outputs(void)
+{
+}
+
+static void
+unlock_outputs(void)
+{
+}
+
+#endif /* ENABLE_THREADS */
+
+/*
+ * krb5_klog_syslog()   - Simulate the calling sequence of syslog(3), while
+ *                        also performing the logging redirection as specified
+ *                        by krb5_klog_init().
+ */
+static int
+klog_vsyslog(int priority, const char *format, va_list arglist)
+#if !defined(__cplusplus) && (__GNUC__ > 2)
+    __attribute__((__format__(__printf__, 2, 0)))
+#endif
+    ;
+
+static int
+klog_vsyslog(int priority, const char *format, va_list arglist)
+{
+    char        outbuf[KRB5_KLOG_MAX_ERRMSG_SIZE];
+    size_t      soff;
+
+    if (format_message(outbuf, sizeof(outbuf), &soff, priority, format,
+                       arglist) != 0)
+        return(-1);
+
+    /*
+     * If the user did not use krb5_klog_init() instead of dropping
+     * the request on the floor, syslog it - if it exists
+     */
+    if (log_control.log_nentries == 0) {
+        /* Log the message with our header trimmed off */
+        syslog(priority, "%s", outbuf + soff);
+    }
+
+    /*
+     * Now that we have the message formatted, hand it to the writer thread
+     * or perform the output to each logging specification.
+     */
+    if (queue_message(priority, outbuf, soff) != 0)
+        write_message(priority, outbuf, outbuf + soff, TRUE);
     return(0);
 }
 
@@ -770,6 +1123,7 @@ krb5_klog_reopen(krb5_context kcontext)
      * Only logs which are actually files need to be closed
      * and reopened in response to a SIGHUP
      */
+    lock_outputs();
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         if (log_control.log_entries[lindex].log_type == K_LOG_FILE) {
             fclose(log_control.log_entries[lindex].lfu_filep);
@@ -788,4 +1142,5 @@ krb5_klog_reopen(krb5_context kcontext)
             }
         }
     }
+    unlock_outputs();
 }
@@ -99,6 +99,9 @@ krb5_error_code     kdb_iter_entry(kadm5_server_handle_t handle,
                                    char *match_entry,
                                    void (*iter_fct)(void *, krb5_principal),
                                    void *data);
+krb5_boolean        kdb_begin_batch(kadm5_server_handle_t handle);
+void                kdb_end_batch(kadm5_server_handle_t handle,
+                                  krb5_boolean locked);
 
 kadm5_ret_t         init_pwqual(kadm5_server_handle_t handle);
 void                destroy_pwqual(kadm5_server_handle_t handle);
@@ -187,6 +190,13 @@ k5_pwqual_check(krb5_context context, pwqual_handle handle,
                 const char *password, const char *policy_name,
                 krb5_principal princ);
 
+/* Compile the text dictionary infile (one word per line) into the format
+ * mapped by the built-in "dict" module, writing it to outfile.  Place the
+ * number of distinct words in *count_out. */
+krb5_error_code
+k5_pwqual_compile_dict(krb5_context context, const char *infile,
+                       const char *outfile, size_t *count_out);
+
 /*** initvt functions for built-in password quality modules ***/
 
 /* The dict module checks passwords against the realm's dictionary. */
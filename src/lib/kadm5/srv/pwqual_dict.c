@@ -29,20 +29,55 @@
 
 /* Password quality module to look up passwords within the realm dictionary. */
 
-#include "k5-platform.h"
+#include "k5-int.h"
 #include <krb5/pwqual_plugin.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <kadm5/admin.h>
 #include "adm_proto.h"
 #include <syslog.h>
 #include "server_internal.h"
 
+/*
+ * A compiled dictionary file, as created by "kdb5_util compile_dict", begins
+ * with a header of:
+ *
+ *   magic "KRB5DICT" (8 bytes)
+ *   format version (4 bytes, currently 1)
+ *   number of bloom filter hash functions (4 bytes)
+ *   number of bloom filter bits (8 bytes, a nonzero multiple of 8)
+ *   number of words (8 bytes)
+ *
+ * followed by the bloom filter bits and then the sorted, de-duplicated hashes
+ * of the words (8 bytes each).  All integers are big-endian.  The hash of a
+ * word is the first eight bytes of the SHA-256 hash of the word folded to
+ * ASCII lowercase, so lookups are case-insensitive like those of a text
+ * dictionary.  The file is mapped read-only rather than read into memory, so
+ * very large dictionaries cost no startup time and only page cache memory.
+ */
+#define DICT_MAGIC "KRB5DICT"
+#define DICT_MAGIC_LEN 8
+#define DICT_VERSION 1
+#define DICT_HEADER_LEN 32
+#define DICT_BLOOM_HASHES 7
+#define DICT_BLOOM_BITS_PER_WORD 10
+
 typedef struct dict_moddata_st {
     char **word_list;        /* list of word pointers */
     char *word_block;        /* actual word data */
     unsigned int word_count; /* number of words */
+
+    /* Fields for a compiled dictionary; map is NULL for a text dictionary. */
+    void *map;               /* mapped dictionary file */
+    size_t map_len;          /* length of map */
+    const unsigned char *bloom; /* bloom filter bits */
+    uint64_t bloom_bits;     /* number of bloom filter bits */
+    uint32_t bloom_hashes;   /* number of bloom filter hash functions */
+    const unsigned char *hashes; /* sorted big-endian word hashes */
+    uint64_t hash_count;     /* number of word hashes */
 } *dict_moddata;
 
 
@@ -67,6 +102,114 @@ word_compare(const void *s1, const void *s2)
     return (strcasecmp(*(const char **)s1, *(const char **)s2));
 }
 
+/* Compute the compiled dictionary hash of the len bytes at word. */
+static krb5_error_code
+word_hash(const char *word, size_t len, uint64_t *hash_out)
+{
+    krb5_error_code ret;
+    krb5_data d;
+    uint8_t digest[K5_SHA256_HASHLEN];
+    char *folded;
+    size_t i;
+
+    *hash_out = 0;
+    folded = malloc(len + 1);
+    if (folded == NULL)
+        return ENOMEM;
+    for (i = 0; i < len; i++)
+        folded[i] = tolower((unsigned char)word[i]);
+    d = make_data(folded, len);
+    ret = k5_sha256(&d, 1, digest);
+    free(folded);
+    if (ret)
+        return ret;
+    *hash_out = load_64_be(digest);
+    return 0;
+}
+
+/* Return the bloom filter bit selected by the ith hash function for hash,
+ * using double hashing. */
+static inline uint64_t
+bloom_bit(uint64_t hash, uint32_t i, uint64_t nbits)
+{
+    uint64_t h2 = ((hash << 32) | (hash >> 32)) | 1;
+
+    return (hash + i * h2) % nbits;
+}
+
+/* Return true if hash is present in the compiled dictionary. */
+static krb5_boolean
+compiled_dict_contains(dict_moddata dict, uint64_t hash)
+{
+    uint64_t bit, lo, hi, mid, val;
+    uint32_t i;
+
+    /* Most passwords which aren't in the dictionary stop here. */
+    for (i = 0; i < dict->bloom_hashes; i++) {
+        bit = bloom_bit(hash, i, dict->bloom_bits);
+        if (!(dict->bloom[bit / 8] & (1 << (bit % 8))))
+            return FALSE;
+    }
+
+    lo = 0;
+    hi = dict->hash_count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        val = load_64_be(dict->hashes + mid * 8);
+        if (val == hash)
+            return TRUE;
+        else if (val < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return FALSE;
+}
+
+/* Map the compiled dictionary file open on fd into dict. */
+static krb5_error_code
+map_compiled_dict(krb5_context context, dict_moddata dict, int fd,
+                  size_t len, const char *dict_file)
+{
+    unsigned char *p;
+    uint64_t nbits, count, rest;
+    uint32_t version, nhashes;
+
+    if (len < DICT_HEADER_LEN)
+        goto invalid;
+    p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return errno;
+    dict->map = p;
+    dict->map_len = len;
+
+    version = load_32_be(p + 8);
+    nhashes = load_32_be(p + 12);
+    nbits = load_64_be(p + 16);
+    count = load_64_be(p + 24);
+    if (version != DICT_VERSION || nhashes == 0 || nbits == 0 ||
+        nbits % 8 != 0 || nbits / 8 > len - DICT_HEADER_LEN)
+        goto invalid;
+    rest = len - DICT_HEADER_LEN - nbits / 8;
+    if (rest % 8 != 0 || rest / 8 != count)
+        goto invalid;
+
+    dict->bloom = p + DICT_HEADER_LEN;
+    dict->bloom_bits = nbits;
+    dict->bloom_hashes = nhashes;
+    dict->hashes = dict->bloom + nbits / 8;
+    dict->hash_count = count;
+#ifdef MADV_RANDOM
+    (void)madvise(p, len, MADV_RANDOM);
+#endif
+    return 0;
+
+invalid:
+    k5_setmsg(context, EINVAL, _("Invalid compiled dictionary file %s"),
+              dict_file);
+    return EINVAL;
+}
+
 /*
  * Function: init-dict
  *
@@ -83,8 +226,8 @@ word_compare(const void *s1, const void *s2)
  *
  * Effects:
  *      If WORDFILE exists, it is read into memory sorted for future
- * use.  If it does not exist, it syslogs an error message and returns
- * success.
+ * use, or mapped into memory if it is a compiled dictionary.  If it
+ * does not exist, it syslogs an error message and returns success.
  *
  * Modifies:
  *      word_list to point to a chunk of allocated memory containing
@@ -94,11 +237,11 @@ word_compare(const void *s1, const void *s2)
  */
 
 static int
-init_dict(dict_moddata dict, const char *dict_file)
+init_dict(krb5_context context, dict_moddata dict, const char *dict_file)
 {
-    int fd;
+    int fd, ret;
     size_t len, i;
-    char *p, *t;
+    char *p, *t, magic[DICT_MAGIC_LEN];
     struct stat sb;
 
     if (dict_file == NULL) {
@@ -121,6 +264,19 @@ init_dict(dict_moddata dict, const char *dict_file)
         close(fd);
         return errno;
     }
+    if (read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+        memcmp(magic, DICT_MAGIC, DICT_MAGIC_LEN) == 0) {
+        if ((uint64_t)sb.st_size > SIZE_MAX)
+            ret = EFBIG;
+        else
+            ret = map_compiled_dict(context, dict, fd, sb.st_size, dict_file);
+        (void)close(fd);
+        return ret;
+    }
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+        (void)close(fd);
+        return errno;
+    }
     dict->word_block = malloc(sb.st_size + 1);
     if (dict->word_block == NULL) {
         (void)close(fd);
@@ -163,8 +319,8 @@ init_dict(dict_moddata dict, const char *dict_file)
  * Requires:
  *          nothing
  * Effects:
- *      frees up memory occupied by word_list and word_block
- *      sets count back to 0, and resets the pointers to NULL
+ *      frees up memory occupied by word_list and word_block, and
+ *      unmaps a compiled dictionary
  *
  * Modifies:
  *      word_list, word_block, and word_count.
@@ -178,6 +334,8 @@ destroy_dict(dict_moddata dict)
         return;
     free(dict->word_list);
     free(dict->word_block);
+    if (dict->map != NULL)
+        munmap(dict->map, dict->map_len);
     free(dict);
     return;
 }
@@ -193,15 +351,12 @@ dict_open(krb5_context context, const char *dict_file,
     *data = NULL;
 
     /* Allocate and initialize a dictionary structure. */
-    dict = malloc(sizeof(*dict));
+    dict = calloc(1, sizeof(*dict));
     if (dict == NULL)
         return ENOMEM;
-    dict->word_list = NULL;
-    dict->word_block = NULL;
-    dict->word_count = 0;
 
     /* Fill in the dictionary structure with data from dict_file. */
-    ret = init_dict(dict, dict_file);
+    ret = init_dict(context, dict, dict_file);
     if (ret != 0) {
         destroy_dict(dict);
         return ret;
@@ -219,11 +374,22 @@ dict_check(krb5_context context, krb5_pwqual_moddata data,
            krb5_principal princ, const char **languages)
 {
     dict_moddata dict = (dict_moddata)data;
+    krb5_error_code ret;
+    uint64_t hash;
 
     /* Don't check the dictionary for principals with no password policy. */
     if (policy_name == NULL)
         return 0;
 
+    if (dict->map != NULL) {
+        ret = word_hash(password, strlen(password), &hash);
+        if (ret)
+            return ret;
+        if (compiled_dict_contains(dict, hash))
+            return KADM5_PASS_Q_DICT;
+        return 0;
+    }
+
     /* Check against words in the dictionary if we successfully loaded one. */
     if (dict->word_list != NULL &&
         bsearch(&password, dict->word_list, dict->word_count, sizeof(char *),
@@ -240,6 +406,182 @@ dict_close(krb5_context context, krb5_pwqual_moddata data)
     destroy_dict((dict_moddata)data);
 }
 
+static int
+hash_compare(const void *a, const void *b)
+{
+    uint64_t h1 = *(const uint64_t *)a, h2 = *(const uint64_t *)b;
+
+    return (h1 < h2) ? -1 : (h1 > h2) ? 1 : 0;
+}
+
+/* Read the words of the text dictionary infile and place their sorted,
+ * de-duplicated hashes in *hashes_out and *count_out. */
+static krb5_error_code
+read_word_hashes(const char *infile, uint64_t **hashes_out, size_t *count_out)
+{
+    krb5_error_code ret;
+    FILE *fp;
+    struct k5buf buf;
+    char chunk[BUFSIZ];
+    uint64_t *hashes = NULL, *newptr;
+    size_t len, count = 0, alloc = 0, i, j;
+    krb5_boolean newline;
+
+    *hashes_out = NULL;
+    *count_out = 0;
+
+    fp = fopen(infile, "r");
+    if (fp == NULL)
+        return errno;
+    set_cloexec_file(fp);
+    k5_buf_init_dynamic(&buf);
+
+    while (fgets(chunk, sizeof(chunk), fp) != NULL) {
+        /* Accumulate lines longer than chunk. */
+        len = strlen(chunk);
+        newline = (len > 0 && chunk[len - 1] == '\n');
+        k5_buf_add_len(&buf, chunk, newline ? len - 1 : len);
+        if (!newline && !feof(fp))
+            continue;
+        ret = k5_buf_status(&buf);
+        if (ret)
+            goto cleanup;
+        if (buf.len == 0)
+            continue;
+
+        if (count == alloc) {
+            alloc = (alloc == 0) ? 1024 : alloc * 2;
+            newptr = realloc(hashes, alloc * sizeof(*hashes));
+            if (newptr == NULL) {
+                ret = ENOMEM;
+                goto cleanup;
+            }
+            hashes = newptr;
+        }
+        ret = word_hash(buf.data, buf.len, &hashes[count++]);
+        if (ret)
+            goto cleanup;
+        k5_buf_truncate(&buf, 0);
+    }
+    if (ferror(fp)) {
+        ret = EIO;
+        goto cleanup;
+    }
+
+    if (count > 0) {
+        qsort(hashes, count, sizeof(*hashes), hash_compare);
+        for (i = 1, j = 1; i < count; i++) {
+            if (hashes[i] != hashes[j - 1])
+                hashes[j++] = hashes[i];
+        }
+        count = j;
+    }
+
+    *hashes_out = hashes;
+    *count_out = count;
+    hashes = NULL;
+    ret = 0;
+
+cleanup:
+    fclose(fp);
+    k5_buf_free(&buf);
+    free(hashes);
+    return ret;
+}
+
+krb5_error_code
+k5_pwqual_compile_dict(krb5_context context, const char *infile,
+                       const char *outfile, size_t *count_out)
+{
+    krb5_error_code ret;
+    FILE *fp = NULL;
+    char *tmpname = NULL;
+    unsigned char header[DICT_HEADER_LEN], *bloom = NULL;
+    uint64_t *hashes = NULL, nbits, bit;
+    size_t count, i;
+    uint32_t j;
+
+    *count_out = 0;
+
+    ret = read_word_hashes(infile, &hashes, &count);
+    if (ret) {
+        k5_prependmsg(context, ret, _("Cannot read dictionary file %s"),
+                      infile);
+        goto cleanup;
+    }
+
+    /* Size the bloom filter for a false positive rate of about 1%. */
+    nbits = ((uint64_t)count * DICT_BLOOM_BITS_PER_WORD + 63) / 64 * 64;
+    if (nbits == 0)
+        nbits = 64;
+    if (nbits / 8 > SIZE_MAX) {
+        ret = EFBIG;
+        goto cleanup;
+    }
+    bloom = k5calloc(1, nbits / 8, &ret);
+    if (bloom == NULL)
+        goto cleanup;
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < DICT_BLOOM_HASHES; j++) {
+            bit = bloom_bit(hashes[i], j, nbits);
+            bloom[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    memcpy(header, DICT_MAGIC, DICT_MAGIC_LEN);
+    store_32_be(DICT_VERSION, header + 8);
+    store_32_be(DICT_BLOOM_HASHES, header + 12);
+    store_64_be(nbits, header + 16);
+    store_64_be(count, header + 24);
+    for (i = 0; i < count; i++)
+        store_64_be(hashes[i], &hashes[i]);
+
+    /* Write to a temporary file and rename it into place, so that servers
+     * with the old file mapped are not disturbed. */
+    if (asprintf(&tmpname, "%s.tmp", outfile) < 0) {
+        tmpname = NULL;
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    fp = fopen(tmpname, "wb");
+    if (fp == NULL) {
+        ret = errno;
+        k5_setmsg(context, ret, _("Cannot create %s: %s"), tmpname,
+                  strerror(ret));
+        goto cleanup;
+    }
+    set_cloexec_file(fp);
+    if (fwrite(header, sizeof(header), 1, fp) != 1 ||
+        fwrite(bloom, nbits / 8, 1, fp) != 1 ||
+        (count > 0 && fwrite(hashes, sizeof(*hashes), count, fp) != count)) {
+        ret = errno ? errno : EIO;
+        goto cleanup;
+    }
+    ret = fclose(fp);
+    fp = NULL;
+    if (ret) {
+        ret = errno;
+        goto cleanup;
+    }
+    if (rename(tmpname, outfile) != 0) {
+        ret = errno;
+        goto cleanup;
+    }
+    free(tmpname);
+    tmpname = NULL;
+    *count_out = count;
+
+cleanup:
+    if (fp != NULL)
+        fclose(fp);
+    if (tmpname != NULL)
+        (void)unlink(tmpname);
+    free(tmpname);
+    free(bloom);
+    free(hashes);
+    return ret;
+}
+
 krb5_error_code
 pwqual_dict_initvt(krb5_context context, int maj_ver, int min_ver,
                    krb5_plugin_vtable vtable)
@@ -13,6 +13,7 @@
 #include "k5-int.h"
 #include <kadm5/admin.h>
 #include "server_internal.h"
+#include <kdb_log.h>
 
 krb5_principal      master_princ;
 krb5_keyblock       master_keyblock; /* local mkey */
@@ -440,9 +441,37 @@ kdb_iter_entry(kadm5_server_handle_t handle, char *match_entry,
     id.func = iter_fct;
     id.data = data;
 
-    ret = krb5_db_iterate(handle->context, match_entry, kdb_iter_func, &id, 0);
+    /* Only the principal names are used, so the module can skip decoding the
+     * rest of each entry. */
+    ret = krb5_db_iterate(handle->context, match_entry, kdb_iter_func, &id,
+                          KRB5_DB_ITER_NAMES_ONLY);
     if (ret)
         return(ret);
 
     return(0);
 }
+
+/*
+ * Prepare to make a batch of principal changes: hold the database lock
+ * across the batch (if the module supports locking) so that it is not
+ * reacquired for each change, and defer update log syncs until the end of the
+ * batch.  Return true if the database lock was acquired.
+ */
+krb5_boolean
+kdb_begin_batch(kadm5_server_handle_t handle)
+{
+    krb5_error_code ret;
+
+    ulog_begin_batch(handle->context);
+    ret = krb5_db_lock(handle->context, KRB5_DB_LOCKMODE_EXCLUSIVE);
+    return ret == 0;
+}
+
+/* Finish a batch begun with kdb_begin_batch(). */
+void
+kdb_end_batch(kadm5_server_handle_t handle, krb5_boolean locked)
+{
+    if (locked)
+        (void)krb5_db_unlock(handle->context);
+    ulog_end_batch(handle->context);
+}
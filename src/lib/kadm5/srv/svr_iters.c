@@ -41,8 +41,21 @@ struct iter_data {
 #ifdef POSIX_REGEXPS
     regex_t preg;
 #endif
+    /* Fields for kadm5_get_principals_page() */
+    const char *after;
+    krb5_boolean ordered;
+    krb5_boolean more;
+    /* Fields for kadm5_iter_principals() */
+    void (*func)(void *, const char *);
+    void *func_data;
 };
 
+/* Largest number of names returned by kadm5_get_principals_page(). */
+#define MAX_PRINCS_PAGE 10000
+
+/* Returned by the page iterator to stop an ordered iteration. */
+#define PAGE_FULL (-1)
+
 /* XXX Duplicated in kdb5_util!  */
 /*
  * Function: glob_to_regexp
@@ -127,7 +140,48 @@ static kadm5_ret_t glob_to_regexp(char *glob, char *realm, char **regexp)
     return KADM5_OK;
 }
 
-static void get_either_iter(struct iter_data *data, char *name)
+/* Compile the glob exp into data, appending realm if it has none. */
+static kadm5_ret_t compile_glob(struct iter_data *data, char *exp,
+                                char *realm)
+{
+#ifdef BSD_REGEXPS
+    char *msg;
+#endif
+    char *regexp = NULL;
+    kadm5_ret_t ret;
+
+    ret = glob_to_regexp(exp, realm, &regexp);
+    if (ret != KADM5_OK)
+        return ret;
+
+    if (
+#ifdef SOLARIS_REGEXPS
+        ((data->expbuf = compile(regexp, NULL, NULL)) == NULL)
+#endif
+#ifdef POSIX_REGEXPS
+        ((regcomp(&data->preg, regexp, REG_NOSUB)) != 0)
+#endif
+#ifdef BSD_REGEXPS
+        ((msg = (char *) re_comp(regexp)) != NULL)
+#endif
+    )
+    {
+        /* XXX syslog msg or regerr(regerrno) */
+        free(regexp);
+        return EINVAL;
+    }
+    free(regexp);
+    return KADM5_OK;
+}
+
+static void free_glob(struct iter_data *data)
+{
+#ifdef POSIX_REGEXPS
+    regfree(&data->preg);
+#endif
+}
+
+static int match_glob(struct iter_data *data, const char *name)
 {
     int match;
 #ifdef SOLARIS_REGEXPS
@@ -139,7 +193,12 @@ static void get_either_iter(struct iter_data *data, char *name)
 #ifdef BSD_REGEXPS
     match = (re_exec(name) != 0);
 #endif
-    if (match) {
+    return match;
+}
+
+static void get_either_iter(struct iter_data *data, char *name)
+{
+    if (match_glob(data, name)) {
         if (data->n_names == data->sz_names) {
             int new_sz = data->sz_names * 2;
             char **new_names = realloc(data->names,
@@ -184,10 +243,6 @@ static kadm5_ret_t kadm5_get_either(int princ,
                                     int *count)
 {
     struct iter_data data;
-#ifdef BSD_REGEXPS
-    char *msg;
-#endif
-    char *regexp = NULL;
     int i, ret;
     kadm5_server_handle_t handle = server_handle;
 
@@ -198,33 +253,16 @@ static kadm5_ret_t kadm5_get_either(int princ,
 
     CHECK_HANDLE(server_handle);
 
-    if ((ret = glob_to_regexp(exp, princ ? handle->params.realm : NULL,
-                              &regexp)) != KADM5_OK)
+    ret = compile_glob(&data, exp, princ ? handle->params.realm : NULL);
+    if (ret)
         return ret;
 
-    if (
-#ifdef SOLARIS_REGEXPS
-        ((data.expbuf = compile(regexp, NULL, NULL)) == NULL)
-#endif
-#ifdef POSIX_REGEXPS
-        ((regcomp(&data.preg, regexp, REG_NOSUB)) != 0)
-#endif
-#ifdef BSD_REGEXPS
-        ((msg = (char *) re_comp(regexp)) != NULL)
-#endif
-    )
-    {
-        /* XXX syslog msg or regerr(regerrno) */
-        free(regexp);
-        return EINVAL;
-    }
-
     data.n_names = 0;
     data.sz_names = 10;
     data.malloc_failed = 0;
     data.names = malloc(sizeof(char *) * data.sz_names);
     if (data.names == NULL) {
-        free(regexp);
+        free_glob(&data);
         return ENOMEM;
     }
 
@@ -235,10 +273,7 @@ static kadm5_ret_t kadm5_get_either(int princ,
         ret = krb5_db_iter_policy(handle->context, exp, get_pols_iter, (void *)&data);
     }
 
-    free(regexp);
-#ifdef POSIX_REGEXPS
-    regfree(&data.preg);
-#endif
+    free_glob(&data);
     if ( !ret && data.malloc_failed)
         ret = ENOMEM;
     if ( ret ) {
@@ -268,3 +303,156 @@ kadm5_ret_t kadm5_get_policies(void *server_handle,
 {
     return kadm5_get_either(0, server_handle, exp, pols, count);
 }
+
+/*
+ * Add the name of entry to the page in data if it matches the glob and sorts
+ * after data->after, keeping the page sorted and at most data->sz_names long.
+ * When the module yields names in order, stop once the page is full.
+ */
+static krb5_error_code
+get_page_iter(krb5_pointer ptr, krb5_db_entry *entry)
+{
+    struct iter_data *data = ptr;
+    krb5_error_code ret;
+    char *name;
+    int i;
+
+    ret = krb5_unparse_name(data->context, entry->princ, &name);
+    if (ret)
+        return ret;
+    if (!match_glob(data, name) ||
+        (data->after != NULL && strcmp(name, data->after) <= 0)) {
+        free(name);
+        return 0;
+    }
+
+    if (data->n_names == data->sz_names) {
+        data->more = TRUE;
+        if (data->ordered ||
+            strcmp(name, data->names[data->n_names - 1]) >= 0) {
+            free(name);
+            return data->ordered ? PAGE_FULL : 0;
+        }
+        /* Displace the last name on the page. */
+        free(data->names[--data->n_names]);
+    }
+
+    for (i = data->n_names; i > 0 && strcmp(name, data->names[i - 1]) < 0;
+         i--)
+        data->names[i] = data->names[i - 1];
+    data->names[i] = name;
+    data->n_names++;
+    return 0;
+}
+
+static void
+free_page(struct iter_data *data)
+{
+    int i;
+
+    for (i = 0; i < data->n_names; i++)
+        free(data->names[i]);
+    data->n_names = 0;
+}
+
+kadm5_ret_t
+kadm5_get_principals_page(void *server_handle, char *exp, char *after,
+                          int max, char ***princs, int *count,
+                          krb5_boolean *more)
+{
+    kadm5_server_handle_t handle = server_handle;
+    struct iter_data data;
+    kadm5_ret_t ret;
+    krb5_flags iterflags = KRB5_DB_ITER_NAMES_ONLY;
+
+    *princs = NULL;
+    *count = 0;
+    *more = FALSE;
+    if (exp == NULL)
+        exp = "*";
+
+    CHECK_HANDLE(server_handle);
+
+    if (max <= 0)
+        return EINVAL;
+    if (max > MAX_PRINCS_PAGE)
+        max = MAX_PRINCS_PAGE;
+
+    memset(&data, 0, sizeof(data));
+    ret = compile_glob(&data, exp, handle->params.realm);
+    if (ret)
+        return ret;
+    data.context = handle->context;
+    data.after = after;
+    data.sz_names = max;
+    data.names = calloc(max, sizeof(*data.names));
+    if (data.names == NULL) {
+        free_glob(&data);
+        return ENOMEM;
+    }
+
+    /* Use an ordered iteration starting after the last name if the module
+     * supports it.  Otherwise, iterate over all candidates and keep the
+     * lowest names. */
+    data.ordered = TRUE;
+    ret = krb5_db_iterate_after(handle->context, exp, after, get_page_iter,
+                                &data, iterflags);
+    if (ret == KRB5_PLUGIN_OP_NOTSUPP) {
+        free_page(&data);
+        data.ordered = FALSE;
+        data.more = FALSE;
+        ret = krb5_db_iterate(handle->context, exp, get_page_iter, &data,
+                              iterflags);
+    }
+    if (ret == PAGE_FULL)
+        ret = 0;
+    free_glob(&data);
+    if (ret) {
+        free_page(&data);
+        free(data.names);
+        return ret;
+    }
+
+    *princs = data.names;
+    *count = data.n_names;
+    *more = data.more;
+    return KADM5_OK;
+}
+
+static void
+iter_princs_iter(void *ptr, krb5_principal princ)
+{
+    struct iter_data *data = ptr;
+    char *name;
+
+    if (krb5_unparse_name(data->context, princ, &name) != 0)
+        return;
+    if (match_glob(data, name))
+        data->func(data->func_data, name);
+    free(name);
+}
+
+kadm5_ret_t
+kadm5_iter_principals(void *server_handle, char *exp,
+                      void (*func)(void *, const char *), void *func_data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    struct iter_data data;
+    kadm5_ret_t ret;
+
+    if (exp == NULL)
+        exp = "*";
+
+    CHECK_HANDLE(server_handle);
+
+    memset(&data, 0, sizeof(data));
+    ret = compile_glob(&data, exp, handle->params.realm);
+    if (ret)
+        return ret;
+    data.context = handle->context;
+    data.func = func;
+    data.func_data = func_data;
+    ret = kdb_iter_entry(handle, exp, iter_princs_iter, &data);
+    free_glob(&data);
+    return ret;
+}
@@ -8,6 +8,7 @@
 #include        <sys/time.h>
 #include        <kadm5/admin.h>
 #include        <kdb.h>
+#include        <kadm5/kadm_rpc.h>
 #include        "server_internal.h"
 
 #include <krb5/kadm5_hook_plugin.h>
@@ -1513,6 +1514,57 @@ done:
     return ret;
 }
 
+/* Perform a single kadm5_batch() operation. */
+static kadm5_ret_t
+batch_op(kadm5_server_handle_t handle, kadm5_batch_op *op)
+{
+    if (op->rec.principal == NULL)
+        return EINVAL;
+
+    switch (op->op) {
+    case KADM5_BATCH_CREATE:
+        return kadm5_create_principal_3(handle, &op->rec, op->mask,
+                                        op->n_ks_tuple, op->ks_tuple,
+                                        op->password);
+    case KADM5_BATCH_MODIFY:
+        return kadm5_modify_principal(handle, &op->rec, op->mask);
+    case KADM5_BATCH_RANDKEY:
+        return kadm5_randkey_principal_3(handle, op->rec.principal,
+                                         op->keepold, op->n_ks_tuple,
+                                         op->ks_tuple, NULL, NULL);
+    case KADM5_BATCH_DELETE:
+        return kadm5_delete_principal(handle, op->rec.principal);
+    default:
+        return EINVAL;
+    }
+}
+
+kadm5_ret_t
+kadm5_batch(void *server_handle, kadm5_batch_op *ops, int n_ops,
+            kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    krb5_boolean locked = FALSE;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_ops < 0 || (n_ops > 0 && (ops == NULL || results == NULL)))
+        return EINVAL;
+
+    for (i = 0; i < n_ops; i++) {
+        if (i % KADM5_MAX_BATCH == 0) {
+            if (i > 0)
+                kdb_end_batch(handle, locked);
+            locked = kdb_begin_batch(handle);
+        }
+        results[i] = batch_op(handle, &ops[i]);
+    }
+    if (n_ops > 0)
+        kdb_end_batch(handle, locked);
+    return 0;
+}
+
 kadm5_ret_t
 kadm5_setkey_principal(void *server_handle,
                        krb5_principal principal,
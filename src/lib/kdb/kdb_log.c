@@ -67,19 +67,93 @@ time_current(kdbe_time_t *out)
     out->useconds = timestamp.tv_usec;
 }
 
-/* Sync update entry to disk. */
+/* Return true if the oldest deferred ulog change has waited at least the
+ * configured group-commit delay. */
+static krb5_boolean
+sync_due(kdb_log_context *log_ctx)
+{
+    kdbe_time_t now;
+    long long elapsed;
+
+    time_current(&now);
+    elapsed = (long long)(now.seconds - log_ctx->sync_since.seconds) * 1000 +
+        ((long long)now.useconds - log_ctx->sync_since.useconds) / 1000;
+    return elapsed < 0 || elapsed >= log_ctx->sync_delay;
+}
+
+/* Remember that the byte range [start, end) of the ulog mapping (and the
+ * header) must be synced before the group-commit deadline. */
+static void
+defer_sync(kdb_log_context *log_ctx, unsigned long start, unsigned long end)
+{
+    if (!log_ctx->sync_pending) {
+        log_ctx->sync_pending = TRUE;
+        time_current(&log_ctx->sync_since);
+        log_ctx->dirty_start = start;
+        log_ctx->dirty_end = end;
+        return;
+    }
+    if (start == end)
+        return;
+    if (log_ctx->dirty_start == log_ctx->dirty_end ||
+        start < log_ctx->dirty_start)
+        log_ctx->dirty_start = start;
+    if (end > log_ctx->dirty_end)
+        log_ctx->dirty_end = end;
+}
+
+/* Sync any deferred update entries to disk, followed by the header. */
 static void
-sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
+flush_pending(kdb_log_context *log_ctx)
+{
+    unsigned long start, end;
+    char *base = (char *)log_ctx->ulog;
+
+    if (!log_ctx->sync_pending)
+        return;
+
+    if (!pagesize)
+        pagesize = getpagesize();
+
+    if (log_ctx->dirty_end > log_ctx->dirty_start) {
+        start = log_ctx->dirty_start & ~(pagesize - 1);
+        end = (log_ctx->dirty_end + (pagesize - 1)) & ~(pagesize - 1);
+        if (msync(base + start, end - start, MS_SYNC)) {
+            /* Couldn't sync to disk, let's panic. */
+            syslog(LOG_ERR, _("could not sync ulog update to disk"));
+            abort();
+        }
+    }
+
+    if (msync(base, pagesize, MS_SYNC)) {
+        /* Couldn't sync to disk, let's panic. */
+        syslog(LOG_ERR, _("could not sync ulog header to disk"));
+        abort();
+    }
+
+    log_ctx->sync_pending = FALSE;
+    log_ctx->dirty_start = log_ctx->dirty_end = 0;
+}
+
+/* Sync a range of the mapped log to disk, or defer the sync if group commit
+ * is enabled or a batch is in progress. */
+static void
+sync_range(kdb_log_context *log_ctx, void *addr, size_t len)
 {
     unsigned long start, end, size;
 
+    if (log_ctx->sync_delay > 0 || log_ctx->batch_depth > 0) {
+        start = (char *)addr - (char *)log_ctx->ulog;
+        defer_sync(log_ctx, start, start + len);
+        return;
+    }
+
     if (!pagesize)
         pagesize = getpagesize();
 
-    start = (unsigned long)upd & ~(pagesize - 1);
+    start = (unsigned long)addr & ~(pagesize - 1);
 
-    end = ((unsigned long)upd + ulog->kdb_block + (pagesize - 1)) &
-        ~(pagesize - 1);
+    end = ((unsigned long)addr + len + (pagesize - 1)) & ~(pagesize - 1);
 
     size = end - start;
     if (msync((caddr_t)start, size, MS_SYNC)) {
@@ -89,14 +163,31 @@ sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
     }
 }
 
-/* Sync memory to disk for the update log header. */
+/* Sync the update entry for sno and its index slot to disk. */
+static void
+sync_update(kdb_log_context *log_ctx, kdb_sno_t sno)
+{
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    kdb_ent_index_t *slot = ULOG_SLOT(ulog, sno);
+
+    sync_range(log_ctx, ULOG_INDEX_ENTRY(ulog, sno), slot->kdb_size);
+    sync_range(log_ctx, slot, sizeof(*slot));
+}
+
+/* Sync memory to disk for the update log header, or defer the sync if group
+ * commit is enabled or a batch is in progress. */
 static void
-sync_header(kdb_hlog_t *ulog)
+sync_header(kdb_log_context *log_ctx)
 {
+    if (log_ctx->sync_delay > 0 || log_ctx->batch_depth > 0) {
+        defer_sync(log_ctx, 0, 0);
+        return;
+    }
+
     if (!pagesize)
         pagesize = getpagesize();
 
-    if (msync((caddr_t)ulog, pagesize, MS_SYNC)) {
+    if (msync((caddr_t)log_ctx->ulog, pagesize, MS_SYNC)) {
         /* Couldn't sync to disk, let's panic. */
         syslog(LOG_ERR, _("could not sync ulog header to disk"));
         abort();
@@ -108,10 +199,17 @@ static krb5_boolean
 check_sno(kdb_log_context *log_ctx, kdb_sno_t sno,
           const kdbe_time_t *timestamp)
 {
-    unsigned int indx = (sno - 1) % log_ctx->ulogentries;
-    kdb_ent_header_t *ent = INDEX(log_ctx->ulog, indx);
-
-    return ent->kdb_entry_sno == sno && time_equal(&ent->kdb_time, timestamp);
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    kdb_ent_index_t *slot = ULOG_SLOT(ulog, sno);
+    kdb_ent_header_t *ent;
+
+    if (slot->kdb_size < sizeof(*ent) ||
+        slot->kdb_offset > ulog->kdb_data_size ||
+        slot->kdb_size > ulog->kdb_data_size - slot->kdb_offset)
+        return FALSE;
+    ent = ULOG_INDEX_ENTRY(ulog, sno);
+    return ent->kdb_umagic == KDB_ULOG_MAGIC && ent->kdb_entry_sno == sno &&
+        time_equal(&ent->kdb_time, timestamp);
 }
 
 /*
@@ -175,39 +273,134 @@ extend_file_to(int fd, unsigned int new_size)
     return 0;
 }
 
+/* Return the largest entry ring size which fits within MAXLOGLEN. */
+static uint32_t
+max_data_size(kdb_hlog_t *ulog)
+{
+    return MAXLOGLEN - ULOG_DATA_OFFSET(ulog->kdb_index_len);
+}
+
+/* Return true if ulogentries is small enough that the index and the initial
+ * entry ring fit within MAXLOGLEN. */
+static krb5_boolean
+valid_ulogentries(uint32_t ulogentries)
+{
+    return ulogentries > 0 &&
+        ulogentries <= MAXLOGLEN / (sizeof(kdb_ent_index_t) + ULOG_BLOCK);
+}
+
 /*
- * Resize the array elements.  We reinitialize the update log rather than
- * unrolling the the log and copying it over to a temporary log for obvious
- * performance reasons.  Replicas will subsequently do a full resync, but the
- * need for resizing should be very small.
+ * Grow the entry ring to at least twice its size (and by at least recsize
+ * bytes), extending the file to match.  If the retained entries wrap around
+ * the end of the ring, move the wrapped part into the new space so that the
+ * retained entries remain contiguous.  Return KRB5_LOG_ERROR if the ring
+ * cannot grow any further.
  */
 static krb5_error_code
-resize(kdb_hlog_t *ulog, uint32_t ulogentries, int ulogfd,
-       unsigned int recsize)
+grow_ring(kdb_log_context *log_ctx, uint32_t recsize)
 {
-    unsigned int new_block, new_size;
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    char *data = ULOG_DATA(ulog);
+    kdb_ent_index_t *slot;
+    uint32_t i, old_size = ulog->kdb_data_size, new_size, max, head;
+    krb5_boolean wrapped;
+    krb5_error_code ret;
 
-    if (ulog == NULL)
+    max = max_data_size(ulog);
+    head = ulog->kdb_data_head;
+    wrapped = ulog->kdb_num > 0 &&
+        head <= ULOG_SLOT(ulog, ulog->kdb_first_sno)->kdb_offset;
+    new_size = (old_size > max / 2) ? max : old_size * 2;
+    if (new_size - old_size < recsize)
+        new_size = (max - old_size < recsize) ? max : old_size + recsize;
+    if (new_size - old_size < recsize || (wrapped && new_size - old_size < head))
         return KRB5_LOG_ERROR;
 
-    new_size = sizeof(kdb_hlog_t);
-    new_block = (recsize / ULOG_BLOCK) + 1;
-    new_block *= ULOG_BLOCK;
-    new_size += ulogentries * new_block;
+    ret = extend_file_to(log_ctx->ulogfd,
+                         ULOG_DATA_OFFSET(ulog->kdb_index_len) + new_size);
+    if (ret)
+        return ret;
 
-    if (new_size > MAXLOGLEN)
-        return KRB5_LOG_ERROR;
+    if (wrapped) {
+        memcpy(data + old_size, data, head);
+        for (i = 0; i < ulog->kdb_num; i++) {
+            slot = ULOG_SLOT(ulog, ulog->kdb_first_sno + i);
+            if (slot->kdb_offset < head)
+                slot->kdb_offset += old_size;
+        }
+        sync_range(log_ctx, data + old_size, head);
+        sync_range(log_ctx, ULOG_SLOT(ulog, 1),
+                   ulog->kdb_index_len * sizeof(kdb_ent_index_t));
+        ulog->kdb_data_head = old_size + head;
+    }
+    ulog->kdb_data_size = new_size;
+    return 0;
+}
 
-    /* Reinit log with new block size. */
-    memset(ulog, 0, sizeof(*ulog));
-    ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
-    ulog->db_version_num = KDB_VERSION;
-    ulog->kdb_state = KDB_STABLE;
-    ulog->kdb_block = new_block;
-    sync_header(ulog);
+/* Discard the oldest entry in the log. */
+static void
+drop_first(kdb_hlog_t *ulog)
+{
+    ulog->kdb_num--;
+    if (ulog->kdb_num == 0)
+        return;
+    ulog->kdb_first_sno++;
+    ulog->kdb_first_time =
+        ULOG_INDEX_ENTRY(ulog, ulog->kdb_first_sno)->kdb_time;
+}
+
+/*
+ * Return true if a recsize-byte entry can be stored at offset off without
+ * overlapping any retained entry.  Retained entries are stored contiguously
+ * from the oldest entry's offset up to the head, wrapping around to the start
+ * of the ring if the head is not above the oldest entry.
+ */
+static krb5_boolean
+room_at(kdb_hlog_t *ulog, uint32_t off, uint32_t recsize)
+{
+    uint32_t first_off, head = ulog->kdb_data_head;
+
+    if (recsize > ulog->kdb_data_size - off)
+        return FALSE;
+    if (ulog->kdb_num == 0)
+        return TRUE;
+    first_off = ULOG_SLOT(ulog, ulog->kdb_first_sno)->kdb_offset;
+    if (head > first_off) {
+        /* Retained entries occupy [first_off, head). */
+        return off >= head || off + recsize <= first_off;
+    }
+    /* Retained entries occupy [first_off, end) and [0, head). */
+    return off >= head && off + recsize <= first_off;
+}
+
+/*
+ * Find space in the entry ring for a recsize-byte entry at the current head,
+ * or at the start of the ring if it does not fit before the end.  Grow the
+ * ring rather than displace retained entries if possible; otherwise discard
+ * the oldest entries in the way.
+ */
+static krb5_error_code
+make_room(kdb_log_context *log_ctx, uint32_t recsize, uint32_t *offset_out)
+{
+    kdb_hlog_t *ulog = log_ctx->ulog;
+    uint32_t off;
+
+    for (;;) {
+        off = ulog->kdb_data_head;
+        if (room_at(ulog, off, recsize))
+            break;
+        off = 0;
+        if (room_at(ulog, off, recsize))
+            break;
+        if (grow_ring(log_ctx, recsize) == 0)
+            continue;
+        if (ulog->kdb_num == 0)
+            return KRB5_LOG_ERROR;
+        drop_first(ulog);
+    }
 
-    /* Expand log considering new block size. */
-    return extend_file_to(ulogfd, new_size);
+    *offset_out = off;
+    return 0;
 }
 
 /* Set the ulog to contain only a dummy entry with the given serial number and
@@ -216,36 +409,51 @@ static void
 set_dummy(kdb_log_context *log_ctx, kdb_sno_t sno, const kdbe_time_t *kdb_time)
 {
     kdb_hlog_t *ulog = log_ctx->ulog;
-    kdb_ent_header_t *ent = INDEX(ulog, (sno - 1) % log_ctx->ulogentries);
+    kdb_ent_index_t *slot = ULOG_SLOT(ulog, sno);
+    kdb_ent_header_t *ent;
 
-    memset(ent, 0, sizeof(*ent));
+    slot->kdb_offset = 0;
+    slot->kdb_size = ULOG_ALIGN(sizeof(*ent));
+    ent = ULOG_INDEX_ENTRY(ulog, sno);
+    memset(ent, 0, slot->kdb_size);
     ent->kdb_umagic = KDB_ULOG_MAGIC;
     ent->kdb_entry_sno = sno;
     ent->kdb_time = *kdb_time;
-    sync_update(ulog, ent);
+    sync_update(log_ctx, sno);
 
     ulog->kdb_num = 1;
     ulog->kdb_first_sno = ulog->kdb_last_sno = sno;
     ulog->kdb_first_time = ulog->kdb_last_time = *kdb_time;
+    ulog->kdb_data_head = slot->kdb_size;
 }
 
-/* Reinitialize the ulog header, starting from sno 1 with the current time. */
+/* Reinitialize the ulog header, starting from sno 1 with the current time.
+ * Keep the current entry ring size if it is valid for ulogentries. */
 static void
 reset_ulog(kdb_log_context *log_ctx)
 {
     kdbe_time_t kdb_time;
     kdb_hlog_t *ulog = log_ctx->ulog;
+    uint32_t data_size = log_ctx->ulogentries * ULOG_BLOCK;
+
+    if (ulog->kdb_hmagic == KDB_ULOG_HDR_MAGIC &&
+        ulog->db_version_num == KDB_VERSION &&
+        ulog->kdb_index_len == log_ctx->ulogentries &&
+        ulog->kdb_data_size > data_size &&
+        ulog->kdb_data_size <= max_data_size(ulog))
+        data_size = ulog->kdb_data_size;
 
     memset(ulog, 0, sizeof(*ulog));
     ulog->kdb_hmagic = KDB_ULOG_HDR_MAGIC;
     ulog->db_version_num = KDB_VERSION;
-    ulog->kdb_block = ULOG_BLOCK;
+    ulog->kdb_index_len = log_ctx->ulogentries;
+    ulog->kdb_data_size = data_size;
 
     /* Create a dummy entry to remember the timestamp for downstreams. */
     time_current(&kdb_time);
     set_dummy(log_ctx, 1, &kdb_time);
     ulog->kdb_state = KDB_STABLE;
-    sync_header(ulog);
+    sync_header(log_ctx);
 }
 
 /*
@@ -273,35 +481,45 @@ unlock_ulog(krb5_context context)
  * Add an update to the log.  The update's kdb_entry_sno and kdb_time fields
  * must already be set.  The layout of the update log looks like:
  *
- * header log -> [ update header -> xdr(kdb_incr_update_t) ], ...
+ * header log -> [ index slot ], ... -> ring of
+ *     [ update header -> xdr(kdb_incr_update_t) ], ...
+ *
+ * The index slot for a serial number locates its update within the ring, so
+ * lookups by serial number take constant time regardless of entry sizes.
  */
 static krb5_error_code
 store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
 {
     XDR xdrs;
     kdb_ent_header_t *indx_log;
-    unsigned int i, recsize;
+    kdb_ent_index_t *slot;
     unsigned long upd_size;
+    uint32_t recsize, offset;
     krb5_error_code retval;
     kdb_hlog_t *ulog = log_ctx->ulog;
-    uint32_t ulogentries = log_ctx->ulogentries;
 
     upd_size = xdr_sizeof((xdrproc_t)xdr_kdb_incr_update_t, upd);
+    if (upd_size > max_data_size(ulog))
+        return KRB5_LOG_ERROR;
+    recsize = ULOG_ALIGN(sizeof(kdb_ent_header_t) + upd_size);
 
-    recsize = sizeof(kdb_ent_header_t) + upd_size;
+    ulog->kdb_state = KDB_UNSTABLE;
 
-    if (recsize > ulog->kdb_block) {
-        retval = resize(ulog, ulogentries, log_ctx->ulogfd, recsize);
-        if (retval)
-            return retval;
-    }
+    /* If every index slot is in use, the new update takes over the slot of
+     * the oldest one. */
+    if (ulog->kdb_num == ulog->kdb_index_len)
+        drop_first(ulog);
 
-    ulog->kdb_state = KDB_UNSTABLE;
+    retval = make_room(log_ctx, recsize, &offset);
+    if (retval)
+        return retval;
 
-    i = (upd->kdb_entry_sno - 1) % ulogentries;
-    indx_log = INDEX(ulog, i);
+    slot = ULOG_SLOT(ulog, upd->kdb_entry_sno);
+    slot->kdb_offset = offset;
+    slot->kdb_size = recsize;
+    indx_log = ULOG_INDEX_ENTRY(ulog, upd->kdb_entry_sno);
 
-    memset(indx_log, 0, ulog->kdb_block);
+    memset(indx_log, 0, recsize);
     indx_log->kdb_umagic = KDB_ULOG_MAGIC;
     indx_log->kdb_entry_size = upd_size;
     indx_log->kdb_entry_sno = upd->kdb_entry_sno;
@@ -314,28 +532,23 @@ store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
         return KRB5_LOG_CONV;
 
     indx_log->kdb_commit = TRUE;
-    sync_update(ulog, indx_log);
+    ulog->kdb_data_head = offset + recsize;
+    sync_update(log_ctx, upd->kdb_entry_sno);
 
     /* Modify the ulog header to reflect the new update. */
     ulog->kdb_last_sno = upd->kdb_entry_sno;
     ulog->kdb_last_time = upd->kdb_time;
     if (ulog->kdb_num == 0) {
-        /* We should only see this in old ulogs. */
+        /* We should only see this if the update filled the whole ring. */
         ulog->kdb_num = 1;
         ulog->kdb_first_sno = upd->kdb_entry_sno;
         ulog->kdb_first_time = upd->kdb_time;
-    } else if (ulog->kdb_num < ulogentries) {
-        ulog->kdb_num++;
     } else {
-        /* We are circling; set kdb_first_sno and time to the next update. */
-        i = upd->kdb_entry_sno % ulogentries;
-        indx_log = INDEX(ulog, i);
-        ulog->kdb_first_sno = indx_log->kdb_entry_sno;
-        ulog->kdb_first_time = indx_log->kdb_time;
+        ulog->kdb_num++;
     }
 
     ulog->kdb_state = KDB_STABLE;
-    sync_header(ulog);
+    sync_header(log_ctx);
     return 0;
 }
 
@@ -360,6 +573,13 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     upd->kdb_entry_sno = ulog->kdb_last_sno + 1;
     time_current(&upd->kdb_time);
     ret = store_update(log_ctx, upd);
+
+    /* In group-commit mode, updates made within the delay window of the
+     * oldest unsynced one share a single msync.  Within a batch, wait for
+     * ulog_end_batch(). */
+    if (log_ctx->sync_pending && log_ctx->batch_depth == 0 &&
+        sync_due(log_ctx))
+        flush_pending(log_ctx);
     unlock_ulog(context);
     return ret;
 }
@@ -440,6 +660,8 @@ ulog_replay(krb5_context context, kdb_incr_result_t *incr_ret, char **db_args)
     }
 
 cleanup:
+    /* A replayed batch is a natural commit group; make it durable now. */
+    flush_pending(log_ctx);
     if (retval)
         (void)ulog_init_header(context);
     if (fupd)
@@ -464,38 +686,44 @@ ulog_init_header(krb5_context context)
     return 0;
 }
 
+/* Return the group-commit delay in milliseconds configured for the default
+ * realm, or 0 if every update should be synced immediately. */
+static unsigned int
+get_sync_delay(krb5_context context)
+{
+    char *realm;
+    int delay = 0;
+
+    if (context->profile == NULL ||
+        krb5_get_default_realm(context, &realm) != 0)
+        return 0;
+    if (profile_get_integer(context->profile, KDB_REALM_SECTION, realm,
+                            KRB5_CONF_IPROP_ULOG_SYNC_DELAY, 0, &delay) != 0)
+        delay = 0;
+    krb5_free_default_realm(context, realm);
+    return (delay > 0) ? delay : 0;
+}
+
 /* Map the log file to memory for performance and simplicity. */
 krb5_error_code
 ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
 {
-    struct stat st;
     krb5_error_code retval;
-    uint32_t filesize;
     kdb_log_context *log_ctx;
     kdb_hlog_t *ulog = NULL;
     krb5_boolean locked = FALSE;
 
+    if (!valid_ulogentries(ulogentries))
+        return KRB5_LOG_ERROR;
+
     log_ctx = create_log_context(context);
     if (log_ctx == NULL)
         return ENOMEM;
 
-    if (stat(logname, &st) == -1) {
-        log_ctx->ulogfd = open(logname, O_RDWR | O_CREAT, 0600);
-        if (log_ctx->ulogfd == -1) {
-            retval = errno;
-            goto cleanup;
-        }
-
-        filesize = sizeof(kdb_hlog_t) + ulogentries * ULOG_BLOCK;
-        retval = extend_file_to(log_ctx->ulogfd, filesize);
-        if (retval)
-            goto cleanup;
-    } else {
-        log_ctx->ulogfd = open(logname, O_RDWR, 0600);
-        if (log_ctx->ulogfd == -1) {
-            retval = errno;
-            goto cleanup;
-        }
+    log_ctx->ulogfd = open(logname, O_RDWR | O_CREAT, 0600);
+    if (log_ctx->ulogfd == -1) {
+        retval = errno;
+        goto cleanup;
     }
 
     ulog = mmap(0, MAXLOGLEN, PROT_READ | PROT_WRITE, MAP_SHARED,
@@ -506,12 +734,20 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
     }
     log_ctx->ulog = ulog;
     log_ctx->ulogentries = ulogentries;
+    log_ctx->sync_delay = get_sync_delay(context);
 
     retval = lock_ulog(context, KRB5_LOCKMODE_EXCLUSIVE);
     if (retval)
         goto cleanup;
     locked = TRUE;
 
+    /* Make sure there is room for the index and the initial entry ring
+     * before we might reinitialize the log. */
+    retval = extend_file_to(log_ctx->ulogfd, ULOG_DATA_OFFSET(ulogentries) +
+                            ulogentries * ULOG_BLOCK);
+    if (retval)
+        goto cleanup;
+
     if (ulog->kdb_hmagic != KDB_ULOG_HDR_MAGIC) {
         if (ulog->kdb_hmagic != 0) {
             retval = KRB5_LOG_CORRUPT;
@@ -520,21 +756,21 @@ ulog_map(krb5_context context, const char *logname, uint32_t ulogentries)
         reset_ulog(log_ctx);
     }
 
-    /* Reinit ulog if ulogentries changed such that we have too many entries or
-     * our first or last entry was written to the wrong location. */
-    if (ulog->kdb_num != 0 &&
-        (ulog->kdb_num > ulogentries ||
-         !check_sno(log_ctx, ulog->kdb_first_sno, &ulog->kdb_first_time) ||
-         !check_sno(log_ctx, ulog->kdb_last_sno, &ulog->kdb_last_time)))
+    /* Reinit ulog if it has an older layout, if ulogentries changed, or if
+     * our first or last entry is not where the index says. */
+    if (ulog->db_version_num != KDB_VERSION ||
+        ulog->kdb_index_len != ulogentries ||
+        ulog->kdb_data_size > max_data_size(ulog) ||
+        ulog->kdb_data_head > ulog->kdb_data_size ||
+        (ulog->kdb_num != 0 &&
+         (ulog->kdb_num > ulogentries ||
+          !check_sno(log_ctx, ulog->kdb_first_sno, &ulog->kdb_first_time) ||
+          !check_sno(log_ctx, ulog->kdb_last_sno, &ulog->kdb_last_time))))
         reset_ulog(log_ctx);
 
-    if (ulog->kdb_num != ulogentries) {
-        /* Expand the ulog file if it isn't big enough. */
-        filesize = sizeof(kdb_hlog_t) + ulogentries * ulog->kdb_block;
-        retval = extend_file_to(log_ctx->ulogfd, filesize);
-        if (retval)
-            goto cleanup;
-    }
+    /* Expand the ulog file if it isn't big enough for the entry ring. */
+    retval = extend_file_to(log_ctx->ulogfd, ULOG_DATA_OFFSET(ulogentries) +
+                            ulog->kdb_data_size);
 
 cleanup:
     if (locked)
@@ -552,15 +788,13 @@ ulog_get_entries(krb5_context context, const kdb_last_t *last,
     XDR xdrs;
     kdb_ent_header_t *indx_log;
     kdb_incr_update_t *upd;
-    unsigned int indx, count;
+    unsigned int count;
     uint32_t sno;
     krb5_error_code retval;
     kdb_log_context *log_ctx;
     kdb_hlog_t *ulog = NULL;
-    uint32_t ulogentries;
 
     INIT_ULOG(context);
-    ulogentries = log_ctx->ulogentries;
 
     retval = lock_ulog(context, KRB5_LOCKMODE_SHARED);
     if (retval)
@@ -586,8 +820,7 @@ ulog_get_entries(krb5_context context, const kdb_last_t *last,
     ulog_handle->updates.kdb_ulog_t_val = upd;
 
     for (; sno < ulog->kdb_last_sno; sno++) {
-        indx = sno % ulogentries;
-        indx_log = INDEX(ulog, indx);
+        indx_log = ULOG_INDEX_ENTRY(ulog, sno + 1);
 
         memset(upd, 0, sizeof(kdb_incr_update_t));
         xdrmem_create(&xdrs, (char *)indx_log->entry_data,
@@ -667,11 +900,51 @@ ulog_set_last(krb5_context context, const kdb_last_t *last)
         return ret;
 
     set_dummy(log_ctx, last->last_sno, &last->last_time);
-    sync_header(ulog);
+    sync_header(log_ctx);
     unlock_ulog(context);
     return 0;
 }
 
+/* Sync any update log changes deferred by group commit. */
+krb5_error_code
+ulog_sync(krb5_context context)
+{
+    kdb_log_context *log_ctx = context->kdblog_context;
+
+    if (log_ctx == NULL || log_ctx->ulog == NULL)
+        return 0;
+    flush_pending(log_ctx);
+    return 0;
+}
+
+/*
+ * Defer syncing update log changes until the matching ulog_end_batch() call,
+ * so that a batch of principal changes is made durable with one msync.  The
+ * caller should keep batches reasonably small, since the changes are not
+ * durable until the batch ends.
+ */
+void
+ulog_begin_batch(krb5_context context)
+{
+    kdb_log_context *log_ctx = context->kdblog_context;
+
+    if (log_ctx != NULL)
+        log_ctx->batch_depth++;
+}
+
+/* End a batch begun with ulog_begin_batch(), syncing any deferred changes if
+ * it is the outermost one. */
+void
+ulog_end_batch(krb5_context context)
+{
+    kdb_log_context *log_ctx = context->kdblog_context;
+
+    if (log_ctx == NULL || log_ctx->batch_depth == 0)
+        return;
+    if (--log_ctx->batch_depth == 0 && log_ctx->ulog != NULL)
+        flush_pending(log_ctx);
+}
+
 void
 ulog_fini(krb5_context context)
 {
@@ -679,8 +952,10 @@ ulog_fini(krb5_context context)
 
     if (log_ctx == NULL)
         return;
-    if (log_ctx->ulog != NULL)
+    if (log_ctx->ulog != NULL) {
+        flush_pending(log_ctx);
         munmap(log_ctx->ulog, MAXLOGLEN);
+    }
     if (log_ctx->ulogfd != -1)
         close(log_ctx->ulogfd);
     free(log_ctx);
@@ -32,9 +32,11 @@
 
 /*
  * This program performs unit tests for the update log functions in kdb_log.c.
- * Right now it contains only a test for issue #7839, checking that
- * ulog_add_update behaves appropriately when the last serial number is
- * reached.
+ * It contains a test for issue #7839, checking that ulog_add_update behaves
+ * appropriately when the last serial number is reached, a test that
+ * group-commit mode defers syncing until ulog_sync() is called, a test that
+ * the entry ring grows to retain large updates, and a test that updates of
+ * mixed sizes do not overwrite retained entries when the ring wraps.
  *
  * The test program accepts one argument, which it unlinks and then maps with
  * ulog_map().  This lets us test all of the update log functions except for
@@ -50,13 +52,64 @@
 static struct _krb5_context context_st;
 static krb5_context context = &context_st;
 
+/*
+ * Return the principal name length of the ith update in the wraparound test.
+ * Each update occupies 64 bytes of the entry ring plus the name length
+ * rounded up to 8.  In a new ring of 2048 bytes, the first seven updates
+ * leave the retained entries wrapped around the end of the ring, then add an
+ * entry which fits neither before the oldest entry nor before the end of the
+ * ring.  The rest have mixed sizes.
+ */
+static unsigned int
+mixed_len(int i)
+{
+    static const unsigned int lens[] = { 0, 896, 816, 32, 0, 896, 976 };
+
+    if (i < (int)(sizeof(lens) / sizeof(*lens)))
+        return lens[i];
+    return (i * 7919) % 1800 + 1;
+}
+
+/* Check that each retained entry's index slot lies within the entry ring,
+ * refers to the entry with its serial number, and does not overlap any other
+ * retained entry. */
+static void
+check_slots(kdb_hlog_t *ulog)
+{
+    kdb_ent_index_t *slot, *other;
+    kdb_ent_header_t *ent;
+    kdb_sno_t sno, osno;
+
+    for (sno = ulog->kdb_first_sno; sno <= ulog->kdb_last_sno; sno++) {
+        slot = ULOG_SLOT(ulog, sno);
+        assert(slot->kdb_size >= sizeof(*ent));
+        assert(slot->kdb_offset <= ulog->kdb_data_size);
+        assert(slot->kdb_size <= ulog->kdb_data_size - slot->kdb_offset);
+        ent = ULOG_INDEX_ENTRY(ulog, sno);
+        assert(ent->kdb_umagic == KDB_ULOG_MAGIC);
+        assert(ent->kdb_entry_sno == sno);
+        for (osno = ulog->kdb_first_sno; osno < sno; osno++) {
+            other = ULOG_SLOT(ulog, osno);
+            assert(other->kdb_offset >= slot->kdb_offset + slot->kdb_size ||
+                   slot->kdb_offset >= other->kdb_offset + other->kdb_size);
+        }
+    }
+}
+
 int
 main(int argc, char **argv)
 {
     kdb_log_context *lctx;
     kdb_hlog_t *ulog;
     kdb_incr_update_t upd;
+    kdb_incr_result_t res;
+    kdb_last_t last;
+    kdb_ent_header_t *ent;
+    kdb_sno_t sno, start_sno;
+    uint32_t data_size, head;
+    char name[1000], mixed[1800];
     const char *filename;
+    int i, wraps;
 
     if (argc != 2) {
         fprintf(stderr, "Usage: %s filename\n", argv[0]);
@@ -84,5 +137,101 @@ main(int argc, char **argv)
     assert(ulog->kdb_num == 2);
     assert(ulog->kdb_first_sno == 1);
     assert(ulog->kdb_last_sno == 2);
+    assert(!lctx->sync_pending);
+
+    /* With a long group-commit delay, successive updates should be left
+     * pending until an explicit sync. */
+    lctx->sync_delay = 60 * 1000;
+    memset(&upd, 0, sizeof(kdb_incr_update_t));
+    if (ulog_add_update(context, &upd) != 0)
+        abort();
+    assert(lctx->sync_pending);
+    memset(&upd, 0, sizeof(kdb_incr_update_t));
+    if (ulog_add_update(context, &upd) != 0)
+        abort();
+    assert(lctx->sync_pending);
+    assert(lctx->dirty_end > lctx->dirty_start);
+    assert(ulog->kdb_last_sno == 4);
+    if (ulog_sync(context) != 0)
+        abort();
+    assert(!lctx->sync_pending);
+    lctx->sync_delay = 0;
+
+    /* Add updates too large for the initial entry ring to hold ten of.  The
+     * ring should grow so that the log retains a full index of entries. */
+    data_size = ulog->kdb_data_size;
+    memset(name, 'a', sizeof(name));
+    for (i = 0; i < 25; i++) {
+        memset(&upd, 0, sizeof(kdb_incr_update_t));
+        upd.kdb_princ_name.utf8str_t_val = name;
+        upd.kdb_princ_name.utf8str_t_len = sizeof(name);
+        if (ulog_add_update(context, &upd) != 0)
+            abort();
+    }
+    assert(ulog->kdb_data_size > data_size);
+    assert(ulog->kdb_num == lctx->ulogentries);
+    assert(ulog->kdb_last_sno == 29);
+    assert(ulog->kdb_first_sno == 20);
+    for (sno = ulog->kdb_first_sno; sno <= ulog->kdb_last_sno; sno++) {
+        ent = ULOG_INDEX_ENTRY(ulog, sno);
+        assert(ent->kdb_entry_sno == sno);
+    }
+
+    /* Fetch the retained updates following the first one. */
+    ent = ULOG_INDEX_ENTRY(ulog, ulog->kdb_first_sno);
+    last.last_sno = ent->kdb_entry_sno;
+    last.last_time = ent->kdb_time;
+    memset(&res, 0, sizeof(res));
+    if (ulog_get_entries(context, &last, &res) != 0)
+        abort();
+    assert(res.ret == UPDATE_OK);
+    assert(res.updates.kdb_ulog_t_len == lctx->ulogentries - 1);
+    assert(res.updates.kdb_ulog_t_val[0].kdb_princ_name.utf8str_t_len ==
+           sizeof(name));
+    ulog_free_entries(res.updates.kdb_ulog_t_val, res.updates.kdb_ulog_t_len);
+    ulog_fini(context);
+
+    /* Add many updates of mixed sizes to a small log, so that the entry ring
+     * wraps around several times.  Retained entries must never be
+     * overwritten. */
+    unlink(filename);
+    if (ulog_map(context, filename, 4) != 0)
+        abort();
+    lctx = context->kdblog_context;
+    ulog = lctx->ulog;
+    assert(ulog->kdb_data_size == 2048);
+    start_sno = ulog->kdb_last_sno + 1;
+    memset(mixed, 'b', sizeof(mixed));
+    wraps = 0;
+    for (i = 0; i < 200; i++) {
+        head = ulog->kdb_data_head;
+        memset(&upd, 0, sizeof(kdb_incr_update_t));
+        upd.kdb_princ_name.utf8str_t_val = mixed;
+        upd.kdb_princ_name.utf8str_t_len = mixed_len(i);
+        if (ulog_add_update(context, &upd) != 0)
+            abort();
+        if (ulog->kdb_data_head < head)
+            wraps++;
+        check_slots(ulog);
+    }
+    assert(wraps >= 3);
+    assert(ulog->kdb_num == lctx->ulogentries);
+
+    /* The retained updates should have the contents they were added with. */
+    ent = ULOG_INDEX_ENTRY(ulog, ulog->kdb_first_sno);
+    last.last_sno = ent->kdb_entry_sno;
+    last.last_time = ent->kdb_time;
+    memset(&res, 0, sizeof(res));
+    if (ulog_get_entries(context, &last, &res) != 0)
+        abort();
+    assert(res.ret == UPDATE_OK);
+    assert(res.updates.kdb_ulog_t_len == lctx->ulogentries - 1);
+    for (i = 0; i < (int)res.updates.kdb_ulog_t_len; i++) {
+        assert(res.updates.kdb_ulog_t_val[i].kdb_princ_name.utf8str_t_len ==
+               mixed_len(last.last_sno + 1 + i - start_sno));
+    }
+    ulog_free_entries(res.updates.kdb_ulog_t_val, res.updates.kdb_ulog_t_len);
+
+    ulog_fini(context);
     return 0;
 }
@@ -29,6 +29,9 @@
 struct asn1buf_st {
     uint8_t *ptr;               /* Position, moving backwards; may be NULL */
     size_t count;               /* Count of bytes written so far */
+    const void *hole_data;      /* Octet string contents to reserve space for
+                                 * instead of copying; may be NULL */
+    uint8_t *hole;              /* Location of the reserved space */
 };
 
 /**** Functions for encoding primitive types ****/
@@ -56,6 +59,16 @@ insert_bytes(asn1buf *buf, const void *bytes, size_t len)
     buf->count += len;
 }
 
+/* Leave len bytes of buf uninitialized, to be filled in by the caller after
+ * encoding is complete. */
+static inline void
+reserve_bytes(asn1buf *buf, size_t len)
+{
+    if (buf->ptr != NULL)
+        buf->ptr -= len;
+    buf->count += len;
+}
+
 void
 k5_asn1_encode_bool(asn1buf *buf, intmax_t val)
 {
@@ -105,6 +118,11 @@ k5_asn1_encode_bytestring(asn1buf *buf, uint8_t *const *val, size_t len)
 {
     if (len > 0 && val == NULL)
         return ASN1_MISSING_FIELD;
+    if (len > 0 && buf->hole_data != NULL && *val == buf->hole_data) {
+        reserve_bytes(buf, len);
+        buf->hole = buf->ptr;
+        return 0;
+    }
     insert_bytes(buf, *val, len);
     return 0;
 }
@@ -864,11 +882,14 @@ encode_sequence_of(asn1buf *buf, size_t seqlen, const void *val,
 
 /**** Functions for freeing C objects based on type info ****/
 
-static void free_atype_ptr(const struct atype_info *a, void *val);
-static void free_sequence(const struct seq_info *seq, void *val);
+static void free_atype_ptr(const struct atype_info *a, void *val,
+                           const krb5_data *alias);
+static void free_sequence(const struct seq_info *seq, void *val,
+                          const krb5_data *alias);
 static void free_sequence_of(const struct atype_info *eltinfo, void *val,
-                             size_t count);
-static void free_cntype(const struct cntype_info *a, void *val, size_t count);
+                             size_t count, const krb5_data *alias);
+static void free_cntype(const struct cntype_info *a, void *val, size_t count,
+                        const krb5_data *alias);
 
 /*
  * Free a C object according to a type description.  Do not free pointers at
@@ -876,7 +897,7 @@ static void free_cntype(const struct cntype_info *a, void *val, size_t count);
  * will be freed by free_atype_ptr in a second pass.
  */
 static void
-free_atype(const struct atype_info *a, void *val)
+free_atype(const struct atype_info *a, void *val, const krb5_data *alias)
 {
     switch (a->type) {
     case atype_fn: {
@@ -886,26 +907,26 @@ free_atype(const struct atype_info *a, void *val)
         break;
     }
     case atype_sequence:
-        free_sequence(a->tinfo, val);
+        free_sequence(a->tinfo, val, alias);
         break;
     case atype_ptr: {
         const struct ptr_info *ptrinfo = a->tinfo;
         void *ptr = LOADPTR(val, ptrinfo);
         if (ptr != NULL) {
-            free_atype(ptrinfo->basetype, ptr);
-            free_atype_ptr(ptrinfo->basetype, ptr);
+            free_atype(ptrinfo->basetype, ptr, alias);
+            free_atype_ptr(ptrinfo->basetype, ptr, alias);
         }
         break;
     }
     case atype_offset: {
         const struct offset_info *off = a->tinfo;
         assert(off->basetype != NULL);
-        free_atype(off->basetype, (char *)val + off->dataoff);
+        free_atype(off->basetype, (char *)val + off->dataoff, alias);
         break;
     }
     case atype_optional: {
         const struct optional_info *opt = a->tinfo;
-        free_atype(opt->basetype, val);
+        free_atype(opt->basetype, val, alias);
         break;
     }
     case atype_counted: {
@@ -913,18 +934,18 @@ free_atype(const struct atype_info *a, void *val)
         void *dataptr = (char *)val + counted->dataoff;
         size_t count;
         if (load_count(val, counted, &count) == 0)
-            free_cntype(counted->basetype, dataptr, count);
+            free_cntype(counted->basetype, dataptr, count, alias);
         break;
     }
     case atype_nullterm_sequence_of:
     case atype_nonempty_nullterm_sequence_of: {
         size_t count = get_nullterm_sequence_len(val, a->tinfo);
-        free_sequence_of(a->tinfo, val, count);
+        free_sequence_of(a->tinfo, val, count, alias);
         break;
     }
     case atype_tagged_thing: {
         const struct tagged_info *tag = a->tinfo;
-        free_atype(tag->basetype, val);
+        free_atype(tag->basetype, val, alias);
         break;
     }
     case atype_bool:
@@ -938,7 +959,7 @@ free_atype(const struct atype_info *a, void *val)
 }
 
 static void
-free_atype_ptr(const struct atype_info *a, void *val)
+free_atype_ptr(const struct atype_info *a, void *val, const krb5_data *alias)
 {
     switch (a->type) {
     case atype_fn:
@@ -961,17 +982,17 @@ free_atype_ptr(const struct atype_info *a, void *val)
     case atype_offset: {
         const struct offset_info *off = a->tinfo;
         assert(off->basetype != NULL);
-        free_atype_ptr(off->basetype, (char *)val + off->dataoff);
+        free_atype_ptr(off->basetype, (char *)val + off->dataoff, alias);
         break;
     }
     case atype_optional: {
         const struct optional_info *opt = a->tinfo;
-        free_atype_ptr(opt->basetype, val);
+        free_atype_ptr(opt->basetype, val, alias);
         break;
     }
     case atype_tagged_thing: {
         const struct tagged_info *tag = a->tinfo;
-        free_atype_ptr(tag->basetype, val);
+        free_atype_ptr(tag->basetype, val, alias);
         break;
     }
     default:
@@ -979,20 +1000,32 @@ free_atype_ptr(const struct atype_info *a, void *val)
     }
 }
 
+/* Return true if ptr points into the buffer given by alias. */
+static inline int
+is_aliased(const void *ptr, const krb5_data *alias)
+{
+    const char *p = ptr;
+
+    return alias != NULL && p != NULL && p >= alias->data &&
+        p < alias->data + alias->length;
+}
+
 static void
-free_cntype(const struct cntype_info *c, void *val, size_t count)
+free_cntype(const struct cntype_info *c, void *val, size_t count,
+            const krb5_data *alias)
 {
     switch (c->type) {
     case cntype_string:
     case cntype_der:
-        free(*(char **)val);
+        if (!is_aliased(*(char **)val, alias))
+            free(*(char **)val);
         *(char **)val = NULL;
         break;
     case cntype_seqof: {
         const struct atype_info *a = c->tinfo;
         const struct ptr_info *ptrinfo = a->tinfo;
         void *seqptr = LOADPTR(val, ptrinfo);
-        free_sequence_of(ptrinfo->basetype, seqptr, count);
+        free_sequence_of(ptrinfo->basetype, seqptr, count, alias);
         free(seqptr);
         STOREPTR(NULL, ptrinfo, val);
         break;
@@ -1000,8 +1033,8 @@ free_cntype(const struct cntype_info *c, void *val, size_t count)
     case cntype_choice: {
         const struct choice_info *choice = c->tinfo;
         if (count < choice->n_options) {
-            free_atype(choice->options[count], val);
-            free_atype_ptr(choice->options[count], val);
+            free_atype(choice->options[count], val, alias);
+            free_atype_ptr(choice->options[count], val, alias);
         }
         break;
     }
@@ -1011,26 +1044,27 @@ free_cntype(const struct cntype_info *c, void *val, size_t count)
 }
 
 static void
-free_sequence(const struct seq_info *seq, void *val)
+free_sequence(const struct seq_info *seq, void *val, const krb5_data *alias)
 {
     size_t i;
 
     for (i = 0; i < seq->n_fields; i++)
-        free_atype(seq->fields[i], val);
+        free_atype(seq->fields[i], val, alias);
     for (i = 0; i < seq->n_fields; i++)
-        free_atype_ptr(seq->fields[i], val);
+        free_atype_ptr(seq->fields[i], val, alias);
 }
 
 static void
-free_sequence_of(const struct atype_info *eltinfo, void *val, size_t count)
+free_sequence_of(const struct atype_info *eltinfo, void *val, size_t count,
+                 const krb5_data *alias)
 {
     void *eltptr;
 
     assert(eltinfo->size != 0);
     while (count-- > 0) {
         eltptr = (char *)val + count * eltinfo->size;
-        free_atype(eltinfo, eltptr);
-        free_atype_ptr(eltinfo, eltptr);
+        free_atype(eltinfo, eltptr, alias);
+        free_atype_ptr(eltinfo, eltptr, alias);
     }
 }
 
@@ -1118,23 +1152,26 @@ check_atype_tag(const struct atype_info *a, const taginfo *t)
 
 static krb5_error_code
 decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out);
+              const struct cntype_info *c, void *val, size_t *count_out,
+              const krb5_data *alias);
 static krb5_error_code
 decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
-                    const struct atype_info *basetype, void **ptr_out);
+                    const struct atype_info *basetype, void **ptr_out,
+                    const krb5_data *alias);
 static krb5_error_code
 decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
-                void *val);
+                void *val, const krb5_data *alias);
 static krb5_error_code
 decode_sequence_of(const uint8_t *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out);
+                   const struct atype_info *elemtype, size_t nextra,
+                   void **seq_out, size_t *count_out,
+                   const krb5_data *alias);
 
 /* Given the enclosing tag t, decode from asn1/len the contents of the ASN.1
  * type specified by a, placing the result into val (caller-allocated). */
 static krb5_error_code
 decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
-             const struct atype_info *a, void *val)
+             const struct atype_info *a, void *val, const krb5_data *alias)
 {
     krb5_error_code ret;
 
@@ -1145,16 +1182,17 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
         return fn->dec(t, asn1, len, val);
     }
     case atype_sequence:
-        return decode_sequence(asn1, len, a->tinfo, val);
+        return decode_sequence(asn1, len, a->tinfo, val, alias);
     case atype_ptr: {
         const struct ptr_info *ptrinfo = a->tinfo;
         void *ptr = LOADPTR(val, ptrinfo);
         assert(ptrinfo->basetype != NULL);
         if (ptr != NULL) {
             /* Container was already allocated by a previous sequence field. */
-            return decode_atype(t, asn1, len, ptrinfo->basetype, ptr);
+            return decode_atype(t, asn1, len, ptrinfo->basetype, ptr, alias);
         } else {
-            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, &ptr);
+            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, &ptr,
+                                      alias);
             if (ret)
                 return ret;
             STOREPTR(ptr, ptrinfo, val);
@@ -1165,18 +1203,19 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
         const struct offset_info *off = a->tinfo;
         assert(off->basetype != NULL);
         return decode_atype(t, asn1, len, off->basetype,
-                            (char *)val + off->dataoff);
+                            (char *)val + off->dataoff, alias);
     }
     case atype_optional: {
         const struct optional_info *opt = a->tinfo;
-        return decode_atype(t, asn1, len, opt->basetype, val);
+        return decode_atype(t, asn1, len, opt->basetype, val, alias);
     }
     case atype_counted: {
         const struct counted_info *counted = a->tinfo;
         void *dataptr = (char *)val + counted->dataoff;
         size_t count;
         assert(counted->basetype != NULL);
-        ret = decode_cntype(t, asn1, len, counted->basetype, dataptr, &count);
+        ret = decode_cntype(t, asn1, len, counted->basetype, dataptr, &count,
+                            alias);
         if (ret)
             return ret;
         return store_count(count, counted, val);
@@ -1197,7 +1236,7 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
             if (!check_atype_tag(tag->basetype, tp))
                 return ASN1_BAD_ID;
         }
-        return decode_atype(tp, asn1, len, tag->basetype, val);
+        return decode_atype(tp, asn1, len, tag->basetype, val, alias);
     }
     case atype_bool: {
         intmax_t intval;
@@ -1250,7 +1289,8 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
  */
 static krb5_error_code
 decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out)
+              const struct cntype_info *c, void *val, size_t *count_out,
+              const krb5_data *alias)
 {
     krb5_error_code ret;
 
@@ -1258,17 +1298,29 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
     case cntype_string: {
         const struct string_info *string = c->tinfo;
         assert(string->dec != NULL);
+        if (alias != NULL && string->dec == k5_asn1_decode_bytestring &&
+            string->tagval == ASN1_OCTETSTRING) {
+            /* Point into the input buffer instead of copying. */
+            *(const uint8_t **)val = (len > 0) ? asn1 : NULL;
+            *count_out = len;
+            return 0;
+        }
         return string->dec(asn1, len, val, count_out);
     }
     case cntype_der:
+        if (alias != NULL) {
+            *(const uint8_t **)val = asn1 - t->tag_len;
+            *count_out = t->tag_len + len;
+            return 0;
+        }
         return store_der(t, asn1, len, val, count_out);
     case cntype_seqof: {
         const struct atype_info *a = c->tinfo;
         const struct ptr_info *ptrinfo = a->tinfo;
         void *seq;
         assert(a->type == atype_ptr);
-        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, &seq,
-                                 count_out);
+        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, 0, &seq,
+                                 count_out, alias);
         if (ret)
             return ret;
         STOREPTR(seq, ptrinfo, val);
@@ -1279,7 +1331,8 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
         size_t i;
         for (i = 0; i < choice->n_options; i++) {
             if (check_atype_tag(choice->options[i], t)) {
-                ret = decode_atype(t, asn1, len, choice->options[i], val);
+                ret = decode_atype(t, asn1, len, choice->options[i], val,
+                                   alias);
                 if (ret)
                     return ret;
                 *count_out = i;
@@ -1299,30 +1352,13 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
     return 0;
 }
 
-/* Add a null pointer to the end of a sequence.  ptr is consumed on success
- * (to be replaced by *ptr_out), left alone on failure. */
-static krb5_error_code
-null_terminate(const struct atype_info *eltinfo, void *ptr, size_t count,
-               void **ptr_out)
-{
-    const struct ptr_info *ptrinfo = eltinfo->tinfo;
-    void *endptr;
-
-    assert(eltinfo->type == atype_ptr);
-    ptr = realloc(ptr, (count + 1) * eltinfo->size);
-    if (ptr == NULL)
-        return ENOMEM;
-    endptr = (char *)ptr + count * eltinfo->size;
-    STOREPTR(NULL, ptrinfo, endptr);
-    *ptr_out = ptr;
-    return 0;
-}
-
 static krb5_error_code
 decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
-                    const struct atype_info *a, void **ptr_out)
+                    const struct atype_info *a, void **ptr_out,
+                    const krb5_data *alias)
 {
     krb5_error_code ret;
+    const struct atype_info *eltinfo;
     void *ptr;
     size_t count;
 
@@ -1330,14 +1366,14 @@ decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
     switch (a->type) {
     case atype_nullterm_sequence_of:
     case atype_nonempty_nullterm_sequence_of:
-        ret = decode_sequence_of(asn1, len, a->tinfo, &ptr, &count);
+        /* Reserve a slot for the null terminator. */
+        ret = decode_sequence_of(asn1, len, a->tinfo, 1, &ptr, &count, alias);
         if (ret)
             return ret;
-        ret = null_terminate(a->tinfo, ptr, count, &ptr);
-        if (ret) {
-            free_sequence_of(a->tinfo, ptr, count);
-            return ret;
-        }
+        eltinfo = a->tinfo;
+        assert(eltinfo->type == atype_ptr);
+        STOREPTR(NULL, (const struct ptr_info *)eltinfo->tinfo,
+                 (char *)ptr + count * eltinfo->size);
         /* Historically we do not enforce non-emptiness of sequences when
          * decoding, even when it is required by the ASN.1 type. */
         break;
@@ -1345,7 +1381,7 @@ decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
         ptr = calloc(a->size, 1);
         if (ptr == NULL)
             return ENOMEM;
-        ret = decode_atype(t, asn1, len, a, ptr);
+        ret = decode_atype(t, asn1, len, a, ptr, alias);
         if (ret) {
             free(ptr);
             return ret;
@@ -1399,7 +1435,7 @@ omit_atype(const struct atype_info *a, void *val)
 /* Decode an ASN.1 sequence into a C object. */
 static krb5_error_code
 decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
-                void *val)
+                void *val, const krb5_data *alias)
 {
     krb5_error_code ret;
     const uint8_t *contents;
@@ -1431,7 +1467,7 @@ decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
          * changing this before making the encoder visible to plugins. */
         if (i == seq->n_fields)
             break;
-        ret = decode_atype(&t, contents, clen, seq->fields[i], val);
+        ret = decode_atype(&t, contents, clen, seq->fields[i], val, alias);
         if (ret)
             goto error;
     }
@@ -1448,25 +1484,59 @@ error:
     /* Free what we've decoded so far.  Free pointers in a second pass in
      * case multiple fields refer to the same pointer. */
     for (j = 0; j < i; j++)
-        free_atype(seq->fields[j], val);
+        free_atype(seq->fields[j], val, alias);
     for (j = 0; j < i; j++)
-        free_atype_ptr(seq->fields[j], val);
+        free_atype_ptr(seq->fields[j], val, alias);
     return ret;
 }
 
+/* Return the number of DER elements in asn1/len, or an error if they cannot
+ * all be parsed. */
 static krb5_error_code
-decode_sequence_of(const uint8_t *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out)
+count_elements(const uint8_t *asn1, size_t len, size_t *count_out)
 {
     krb5_error_code ret;
-    void *seq = NULL, *elem, *newseq;
     const uint8_t *contents;
     size_t clen, count = 0;
     taginfo t;
 
+    while (len > 0) {
+        ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
+        if (ret)
+            return ret;
+        count++;
+    }
+    *count_out = count;
+    return 0;
+}
+
+/*
+ * Decode a sequence of elemtype into an array, allocating nextra zeroed
+ * elements past the end.  The elements are counted before decoding so that
+ * the array can be allocated once, rather than grown once per element.
+ */
+static krb5_error_code
+decode_sequence_of(const uint8_t *asn1, size_t len,
+                   const struct atype_info *elemtype, size_t nextra,
+                   void **seq_out, size_t *count_out,
+                   const krb5_data *alias)
+{
+    krb5_error_code ret;
+    void *seq = NULL, *elem;
+    const uint8_t *contents;
+    size_t clen, nelems, count = 0;
+    taginfo t;
+
     *seq_out = NULL;
     *count_out = 0;
+    ret = count_elements(asn1, len, &nelems);
+    if (ret)
+        return ret;
+    if (nelems + nextra > 0) {
+        seq = calloc(nelems + nextra, elemtype->size);
+        if (seq == NULL)
+            return ENOMEM;
+    }
     while (len > 0) {
         ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
         if (ret)
@@ -1475,15 +1545,8 @@ decode_sequence_of(const uint8_t *asn1, size_t len,
             ret = ASN1_BAD_ID;
             goto error;
         }
-        newseq = realloc(seq, (count + 1) * elemtype->size);
-        if (newseq == NULL) {
-            ret = ENOMEM;
-            goto error;
-        }
-        seq = newseq;
         elem = (char *)seq + count * elemtype->size;
-        memset(elem, 0, elemtype->size);
-        ret = decode_atype(&t, contents, clen, elemtype, elem);
+        ret = decode_atype(&t, contents, clen, elemtype, elem, alias);
         if (ret)
             goto error;
         count++;
@@ -1493,7 +1556,7 @@ decode_sequence_of(const uint8_t *asn1, size_t len,
     return 0;
 
 error:
-    free_sequence_of(elemtype, seq, count);
+    free_sequence_of(elemtype, seq, count, alias);
     free(seq);
     return ret;
 }
@@ -1512,12 +1575,12 @@ krb5_error_code
 k5_asn1_decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
                      const struct atype_info *a, void *val)
 {
-    return decode_atype(t, asn1, len, a, val);
+    return decode_atype(t, asn1, len, a, val, NULL);
 }
 
-krb5_error_code
-k5_asn1_full_encode(const void *rep, const struct atype_info *a,
-                    krb5_data **code_out)
+static krb5_error_code
+full_encode(const void *rep, const struct atype_info *a,
+            const void *hole_data, krb5_data **code_out, uint8_t **hole_out)
 {
     krb5_error_code ret;
     asn1buf buf;
@@ -1532,6 +1595,8 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
     /* Make a first pass over rep to count the encoding size. */
     buf.ptr = NULL;
     buf.count = 0;
+    buf.hole_data = hole_data;
+    buf.hole = NULL;
     ret = encode_atype_and_tag(&buf, rep, a);
     if (ret)
         return ret;
@@ -1553,6 +1618,12 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
     }
     assert(buf.ptr == bytes);
 
+    /* The caller expects to fill in a hole, so fail if there isn't one. */
+    if (hole_data != NULL && buf.hole == NULL) {
+        free(bytes);
+        return ASN1_MISSING_FIELD;
+    }
+
     /* Create the output data object. */
     *code_out = malloc(sizeof(*d));
     if (*code_out == NULL) {
@@ -1560,12 +1631,29 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
         return ENOMEM;
     }
     **code_out = make_data(bytes, buf.count);
+    if (hole_out != NULL)
+        *hole_out = buf.hole;
     return 0;
 }
 
 krb5_error_code
-k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
-                    void **retrep)
+k5_asn1_full_encode(const void *rep, const struct atype_info *a,
+                    krb5_data **code_out)
+{
+    return full_encode(rep, a, NULL, code_out, NULL);
+}
+
+krb5_error_code
+k5_asn1_full_encode_hole(const void *rep, const struct atype_info *a,
+                         const void *hole_data, krb5_data **code_out,
+                         uint8_t **hole_out)
+{
+    return full_encode(rep, a, hole_data, code_out, hole_out);
+}
+
+static krb5_error_code
+full_decode(const krb5_data *code, const struct atype_info *a, void **retrep,
+            const krb5_data *alias)
 {
     krb5_error_code ret;
     const uint8_t *contents, *remainder;
@@ -1581,5 +1669,30 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
      * non-length-preserving enctypes, it will sometimes be nonzero). */
     if (!check_atype_tag(a, &t))
         return ASN1_BAD_ID;
-    return decode_atype_to_ptr(&t, contents, clen, a, retrep);
+    return decode_atype_to_ptr(&t, contents, clen, a, retrep, alias);
+}
+
+krb5_error_code
+k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
+                    void **retrep)
+{
+    return full_decode(code, a, retrep, NULL);
+}
+
+krb5_error_code
+k5_asn1_full_decode_alias(const krb5_data *code, const struct atype_info *a,
+                          void **retrep)
+{
+    return full_decode(code, a, retrep, code);
+}
+
+void
+k5_asn1_free_alias(const krb5_data *code, const struct atype_info *a,
+                   void *rep)
+{
+    if (rep == NULL)
+        return;
+    free_atype(a, rep, code);
+    free_atype_ptr(a, rep, code);
+    free(rep);
 }
@@ -536,10 +536,34 @@ k5_asn1_decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
 extern krb5_error_code
 k5_asn1_full_encode(const void *rep, const struct atype_info *a,
                     krb5_data **code_out);
+
+/*
+ * Like k5_asn1_full_encode, but do not copy the contents of the octet string
+ * whose data pointer is hole_data (which must be unique within rep).  Leave
+ * that space uninitialized and set *hole_out to its location within the
+ * encoding, so that the caller can fill it in without a separate buffer.
+ */
+krb5_error_code
+k5_asn1_full_encode_hole(const void *rep, const struct atype_info *a,
+                         const void *hole_data, krb5_data **code_out,
+                         uint8_t **hole_out);
 krb5_error_code
 k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
                     void **rep_out);
 
+/*
+ * Like k5_asn1_full_decode, but octet strings and stored DER encodings in the
+ * result point into code->data instead of being copied.  code must remain
+ * valid and unchanged until the result is freed with k5_asn1_free_alias,
+ * which frees everything but the aliased fields.
+ */
+krb5_error_code
+k5_asn1_full_decode_alias(const krb5_data *code, const struct atype_info *a,
+                          void **rep_out);
+void
+k5_asn1_free_alias(const krb5_data *code, const struct atype_info *a,
+                   void *rep);
+
 #define MAKE_ENCODER(FNAME, DESC)                                       \
     krb5_error_code                                                     \
     FNAME(const aux_type_##DESC *rep, krb5_data **code_out)             \
@@ -563,6 +587,40 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
     }                                                                   \
     extern int dummy /* gobble semicolon */
 
+/* Define an encoder which leaves a hole for one octet string's contents (see
+ * k5_asn1_full_encode_hole). */
+#define MAKE_HOLE_ENCODER(FNAME, DESC)                                  \
+    krb5_error_code                                                     \
+    FNAME(const aux_type_##DESC *rep, const void *hole_data,            \
+          krb5_data **code_out, uint8_t **hole_out)                     \
+    {                                                                   \
+        return k5_asn1_full_encode_hole(rep, &k5_atype_##DESC,          \
+                                        hole_data, code_out, hole_out); \
+    }                                                                   \
+    extern int dummy /* gobble semicolon */
+
+/* Define an aliasing decoder (see k5_asn1_full_decode_alias) and the
+ * matching free function. */
+#define MAKE_ALIAS_DECODER(FNAME, FREENAME, DESC)                       \
+    krb5_error_code                                                     \
+    FNAME(const krb5_data *code, aux_type_##DESC **rep_out)             \
+    {                                                                   \
+        krb5_error_code ret;                                            \
+        void *rep;                                                      \
+        *rep_out = NULL;                                                \
+        ret = k5_asn1_full_decode_alias(code, &k5_atype_##DESC, &rep);  \
+        if (ret)                                                        \
+            return ret;                                                 \
+        *rep_out = rep;                                                 \
+        return 0;                                                       \
+    }                                                                   \
+    void                                                                \
+    FREENAME(const krb5_data *code, aux_type_##DESC *rep)               \
+    {                                                                   \
+        k5_asn1_free_alias(code, &k5_atype_##DESC, rep);                \
+    }                                                                   \
+    extern int dummy /* gobble semicolon */
+
 #include <stddef.h>
 /*
  * Ugly hack!
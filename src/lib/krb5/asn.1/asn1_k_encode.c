@@ -1155,11 +1155,14 @@ decode_krb5_enc_kdc_rep_part(const krb5_data *code,
 }
 
 MAKE_ENCODER(encode_krb5_as_rep, as_rep);
+MAKE_HOLE_ENCODER(k5_encode_as_rep_hole, as_rep);
 MAKE_DECODER(decode_krb5_as_rep, as_rep);
 MAKE_ENCODER(encode_krb5_tgs_rep, tgs_rep);
+MAKE_HOLE_ENCODER(k5_encode_tgs_rep_hole, tgs_rep);
 MAKE_DECODER(decode_krb5_tgs_rep, tgs_rep);
 MAKE_ENCODER(encode_krb5_ap_req, ap_req);
 MAKE_DECODER(decode_krb5_ap_req, ap_req);
+MAKE_ALIAS_DECODER(decode_krb5_ap_req_alias, k5_free_ap_req_alias, ap_req);
 MAKE_ENCODER(encode_krb5_ap_rep, ap_rep);
 MAKE_DECODER(decode_krb5_ap_rep, ap_rep);
 MAKE_ENCODER(encode_krb5_ap_rep_enc_part, ap_rep_enc_part);
@@ -1287,6 +1290,8 @@ MAKE_DECODER(decode_krb5_etype_list, etype_list);
 
 MAKE_ENCODER(encode_krb5_pa_fx_fast_request, pa_fx_fast_request);
 MAKE_DECODER(decode_krb5_pa_fx_fast_request, pa_fx_fast_request);
+MAKE_ALIAS_DECODER(decode_krb5_pa_fx_fast_request_alias,
+                   k5_free_pa_fx_fast_request_alias, pa_fx_fast_request);
 MAKE_ENCODER(encode_krb5_fast_req, fast_req);
 MAKE_DECODER(decode_krb5_fast_req, fast_req);
 MAKE_ENCODER(encode_krb5_pa_fx_fast_reply, pa_fx_fast_reply);
@@ -36,7 +36,9 @@
 
   returns system errors
 
-  dec_rep->enc_part.ciphertext is allocated and filled in.
+  The reply is encoded with space for the encrypted part, which is then
+  encrypted directly into the encoding.  dec_rep->enc_part.enctype and kvno
+  are set to the values used; dec_rep->enc_part.ciphertext is left empty.
 */
 /* due to argument promotion rules, we need to use the DECLARG/OLDDECLARG
    stuff... */
@@ -46,10 +48,16 @@ krb5_encode_kdc_rep(krb5_context context, krb5_msgtype type,
                     int using_subkey, const krb5_keyblock *client_key,
                     krb5_kdc_rep *dec_rep, krb5_data **enc_rep)
 {
-    krb5_data *scratch;
+    krb5_data *scratch = NULL, *out = NULL;
     krb5_error_code retval;
     krb5_enc_kdc_rep_part tmp_encpart;
     krb5_keyusage usage;
+    krb5_enc_data enc;
+    size_t enclen;
+    uint8_t *hole;
+    char hole_data;
+
+    *enc_rep = NULL;
 
     if (!krb5_c_valid_enctype(dec_rep->enc_part.enctype))
         return KRB5_PROG_ETYPE_NOSUPP;
@@ -89,37 +97,36 @@ krb5_encode_kdc_rep(krb5_context context, krb5_msgtype type,
     }
     memset(&tmp_encpart, 0, sizeof(tmp_encpart));
 
-#define cleanup_scratch() { (void) memset(scratch->data, 0, scratch->length); \
-        krb5_free_data(context, scratch); }
-
-    retval = krb5_encrypt_helper(context, client_key, usage, scratch,
-                                 &dec_rep->enc_part);
-
-#define cleanup_encpart() {                                     \
-        (void) memset(dec_rep->enc_part.ciphertext.data, 0,     \
-                      dec_rep->enc_part.ciphertext.length);     \
-        free(dec_rep->enc_part.ciphertext.data);                \
-        dec_rep->enc_part.ciphertext.length = 0;                \
-        dec_rep->enc_part.ciphertext.data = 0;}
-
-    cleanup_scratch();
-
+    retval = krb5_c_encrypt_length(context, client_key->enctype,
+                                   scratch->length, &enclen);
     if (retval)
-        return(retval);
-
-    /* now it's ready to be encoded for the wire! */
-
-    switch (type) {
-    case KRB5_AS_REP:
-        retval = encode_krb5_as_rep(dec_rep, enc_rep);
-        break;
-    case KRB5_TGS_REP:
-        retval = encode_krb5_tgs_rep(dec_rep, enc_rep);
-        break;
-    }
+        goto cleanup;
+
+    /* Encode the reply for the wire, leaving a hole for the ciphertext. */
+    dec_rep->enc_part.enctype = client_key->enctype;
+    dec_rep->enc_part.kvno = 0;
+    dec_rep->enc_part.ciphertext = make_data(&hole_data, enclen);
+    if (type == KRB5_AS_REP)
+        retval = k5_encode_as_rep_hole(dec_rep, &hole_data, &out, &hole);
+    else
+        retval = k5_encode_tgs_rep_hole(dec_rep, &hole_data, &out, &hole);
+    dec_rep->enc_part.ciphertext = empty_data();
+    if (retval)
+        goto cleanup;
 
+    /* Encrypt the reply part directly into the hole. */
+    enc = dec_rep->enc_part;
+    enc.ciphertext = make_data(hole, enclen);
+    retval = krb5_c_encrypt(context, client_key, usage, NULL, scratch, &enc);
     if (retval)
-        cleanup_encpart();
+        goto cleanup;
+
+    *enc_rep = out;
+    out = NULL;
 
+cleanup:
+    zapfree(scratch->data, scratch->length);
+    free(scratch);
+    krb5_free_data(context, out);
     return retval;
 }
@@ -1243,6 +1243,103 @@ krb5_tkt_creds_get(krb5_context context, krb5_tkt_creds_context ctx)
     return code;
 }
 
+/* The state of one context in krb5_tkt_creds_get_multi(). */
+struct multi_creds {
+    krb5_tkt_creds_context ctx;
+    struct sendto_multi *multi;
+    int no_udp;
+    krb5_tkt_creds_done_fn callback;
+    void *data;
+};
+
+static void multi_creds_reply(krb5_context context, krb5_error_code code,
+                              krb5_data *reply, void *data);
+
+/* Step mc->ctx with reply and queue the next request, or report completion to
+ * the caller's callback. */
+static void
+multi_creds_step(krb5_context context, struct multi_creds *mc,
+                 krb5_data *reply)
+{
+    krb5_error_code code;
+    krb5_data request = empty_data(), realm = empty_data();
+    unsigned int flags = 0;
+
+    code = krb5_tkt_creds_step(context, mc->ctx, reply, &request, &realm,
+                               &flags);
+    if (code == KRB5KRB_ERR_RESPONSE_TOO_BIG && !mc->no_udp) {
+        /* Resend the request over TCP. */
+        TRACE_TKT_CREDS_RETRY_TCP(context);
+        mc->no_udp = 1;
+        code = 0;
+        flags = KRB5_TKT_CREDS_STEP_FLAG_CONTINUE;
+    }
+    if (code == 0 && (flags & KRB5_TKT_CREDS_STEP_FLAG_CONTINUE)) {
+        code = k5_sendto_multi_add_kdc(context, mc->multi, &request, &realm,
+                                       mc->no_udp, multi_creds_reply, mc);
+        if (code == 0)
+            goto cleanup;
+    }
+
+    if (mc->callback != NULL)
+        mc->callback(context, mc->ctx, code, mc->data);
+
+cleanup:
+    krb5_free_data_contents(context, &request);
+    krb5_free_data_contents(context, &realm);
+}
+
+static void
+multi_creds_reply(krb5_context context, krb5_error_code code,
+                  krb5_data *reply, void *data)
+{
+    struct multi_creds *mc = data;
+
+    if (code != 0) {
+        if (mc->callback != NULL)
+            mc->callback(context, mc->ctx, code, mc->data);
+        return;
+    }
+    multi_creds_step(context, mc, reply);
+    krb5_free_data_contents(context, reply);
+}
+
+krb5_error_code KRB5_CALLCONV
+krb5_tkt_creds_get_multi(krb5_context context, krb5_tkt_creds_context *ctxs,
+                         size_t count, krb5_tkt_creds_done_fn callback,
+                         void *data)
+{
+    krb5_error_code code;
+    struct sendto_multi *multi = NULL;
+    struct multi_creds *mcs = NULL;
+    size_t i;
+
+    if (count == 0)
+        return 0;
+
+    mcs = k5calloc(count, sizeof(*mcs), &code);
+    if (mcs == NULL)
+        goto cleanup;
+    code = k5_sendto_multi_create(&multi);
+    if (code)
+        goto cleanup;
+
+    /* Queue the first request of each context, then service them all. */
+    for (i = 0; i < count; i++) {
+        mcs[i].ctx = ctxs[i];
+        mcs[i].multi = multi;
+        mcs[i].callback = callback;
+        mcs[i].data = data;
+        multi_creds_step(context, &mcs[i], NULL);
+    }
+    k5_sendto_multi_run(context, multi);
+
+cleanup:
+    k5_sendto_multi_free(context, multi);
+    free(mcs);
+    return code;
+}
+
 krb5_error_code KRB5_CALLCONV
 krb5_tkt_creds_step(krb5_context context, krb5_tkt_creds_context ctx,
                     krb5_data *in, krb5_data *out, krb5_data *realm,
@@ -52,11 +52,14 @@ krb5_rd_req(krb5_context context, krb5_auth_context *auth_context,
     krb5_ap_req         * request;
     krb5_auth_context     new_auth_context;
     krb5_keytab           new_keytab = NULL;
+    krb5_ticket         * tkt;
+    krb5_data             ciphertext;
 
     if (!krb5_is_ap_req(inbuf))
         return KRB5KRB_AP_ERR_MSG_TYPE;
 #ifndef LEAN_CLIENT
-    if ((retval = decode_krb5_ap_req(inbuf, &request))) {
+    /* The ciphertexts are only decrypted, so let them alias inbuf. */
+    if ((retval = decode_krb5_ap_req_alias(inbuf, &request))) {
         switch (retval) {
         case KRB5_BADMSGTYPE:
             return KRB5KRB_AP_ERR_BADVERSION;
@@ -87,9 +90,16 @@ krb5_rd_req(krb5_context context, krb5_auth_context *auth_context,
     retval = krb5_rd_req_decoded(context, auth_context, request, server,
                                  keytab, ap_req_options, NULL);
     if (!retval && ticket != NULL) {
-        /* Steal the ticket pointer for the caller. */
-        *ticket = request->ticket;
-        request->ticket = NULL;
+        /* Give the caller its own copy of the ticket ciphertext, and steal
+         * the ticket pointer. */
+        tkt = request->ticket;
+        retval = krb5int_copy_data_contents(context, &tkt->enc_part.ciphertext,
+                                            &ciphertext);
+        if (!retval) {
+            tkt->enc_part.ciphertext = ciphertext;
+            *ticket = request->ticket;
+            request->ticket = NULL;
+        }
     }
 
 #ifndef LEAN_CLIENT
@@ -104,6 +114,8 @@ cleanup_auth_context:
     }
 
 cleanup_request:
-    krb5_free_ap_req(context, request);
+    if (request->ticket != NULL)
+        krb5_free_enc_tkt_part(context, request->ticket->enc_part2);
+    k5_free_ap_req_alias(inbuf, request);
     return retval;
 }
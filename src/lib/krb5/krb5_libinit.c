@@ -50,6 +50,11 @@ int krb5int_lib_init(void)
     err = k5_mutex_finish_init(&krb5int_us_time_mutex);
     if (err)
         return err;
+#ifdef KRB5_DNS_LOOKUP
+    err = k5_dns_cache_init();
+    if (err)
+        return err;
+#endif
 
     return 0;
 }
@@ -78,6 +83,9 @@ void krb5int_lib_fini(void)
 #endif
 
     k5_mutex_destroy(&krb5int_us_time_mutex);
+#ifdef KRB5_DNS_LOOKUP
+    k5_dns_cache_fini();
+#endif
 
     krb5int_cc_finalize();
 #ifndef LEAN_CLIENT
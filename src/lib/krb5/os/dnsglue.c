@@ -67,6 +67,35 @@ struct krb5int_dns_state {
 static int initparse(struct krb5int_dns_state *);
 #endif
 
+#if HAVE_NS_INITPARSE
+/*
+ * Process-wide cache of DNS answers, shared by all contexts.  An answer is
+ * kept for the smallest TTL of its answer records, so that repeated URI, SRV,
+ * and TXT lookups of the same name (typically one set per KDC exchange) do not
+ * each go to the resolver.  Names found not to exist are remembered for
+ * DNS_NEGATIVE_TTL seconds, since the resolver does not report the negative
+ * TTL to us.
+ */
+#define USE_DNS_CACHE 1
+#define DNS_CACHE_MAX 64
+#define DNS_NEGATIVE_TTL 60
+
+struct dns_cache_entry {
+    struct dns_cache_entry *next;
+    char *name;
+    int nclass;
+    int ntype;
+    void *ansp;                 /* NULL for a name found not to exist */
+    int anslen;
+    time_t expires;
+};
+
+static k5_mutex_t dns_cache_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct dns_cache_entry *dns_cache;
+static int dns_cache_count;
+
+#endif
+
 /*
  * Define macros to use the best available DNS search functions.  INIT_HANDLE()
  * returns true if handle initialization is successful, false if it is not.
@@ -83,6 +112,7 @@ static int initparse(struct krb5int_dns_state *);
 #define INIT_HANDLE(h) ((h = dns_open(NULL)) != NULL)
 #define SEARCH(h, n, c, t, a, l) dns_search(h, n, c, t, a, l, NULL, NULL)
 #define PRIMARY_DOMAIN(h) dns_search_list_domain(h, 0)
+#define NO_SUCH_NAME(h) 0
 #define DESTROY_HANDLE(h) dns_free(h)
 
 #elif HAVE_RES_NINIT && HAVE_RES_NSEARCH
@@ -92,6 +122,8 @@ static int initparse(struct krb5int_dns_state *);
 #define INIT_HANDLE(h) (memset(&h, 0, sizeof(h)), res_ninit(&h) == 0)
 #define SEARCH(h, n, c, t, a, l) res_nsearch(&h, n, c, t, a, l)
 #define PRIMARY_DOMAIN(h) ((h.dnsrch[0] == NULL) ? NULL : strdup(h.dnsrch[0]))
+#define NO_SUCH_NAME(h) \
+    (h.res_h_errno == HOST_NOT_FOUND || h.res_h_errno == NO_DATA)
 #if HAVE_RES_NDESTROY
 #define DESTROY_HANDLE(h) res_ndestroy(&h)
 #else
@@ -106,10 +138,138 @@ static int initparse(struct krb5int_dns_state *);
 #define SEARCH(h, n, c, t, a, l) res_search(n, c, t, a, l)
 #define PRIMARY_DOMAIN(h) \
     ((_res.defdname == NULL) ? NULL : strdup(_res.defdname))
+#define NO_SUCH_NAME(h) (h_errno == HOST_NOT_FOUND || h_errno == NO_DATA)
 #define DESTROY_HANDLE(h)
 
 #endif
 
+#ifdef USE_DNS_CACHE
+
+static void
+free_cache_entry(struct dns_cache_entry *ent)
+{
+    free(ent->name);
+    free(ent->ansp);
+    free(ent);
+}
+
+/* Remove expired entries from the cache, and the oldest entry if the cache is
+ * full.  dns_cache_lock must be held. */
+static void
+prune_cache(time_t now)
+{
+    struct dns_cache_entry **entp, *ent;
+
+    entp = &dns_cache;
+    while (*entp != NULL) {
+        ent = *entp;
+        if (ent->expires <= now ||
+            (ent->next == NULL && dns_cache_count >= DNS_CACHE_MAX)) {
+            *entp = ent->next;
+            free_cache_entry(ent);
+            dns_cache_count--;
+        } else {
+            entp = &ent->next;
+        }
+    }
+}
+
+/*
+ * Look for a cached answer for host in ds's class and type.  Return 1 and set
+ * ds->ansp and ds->anslen to a copy of the answer if a current one is found,
+ * -1 if the name is cached as not existing, or 0 if there is no cached
+ * result.
+ */
+static int
+cache_lookup(struct krb5int_dns_state *ds, const char *host)
+{
+    struct dns_cache_entry *ent;
+    time_t now = time(NULL);
+    int result = 0;
+
+    k5_mutex_lock(&dns_cache_lock);
+    prune_cache(now);
+    for (ent = dns_cache; ent != NULL; ent = ent->next) {
+        if (ent->nclass == ds->nclass && ent->ntype == ds->ntype &&
+            strcmp(ent->name, host) == 0)
+            break;
+    }
+    if (ent != NULL && ent->ansp == NULL) {
+        result = -1;
+    } else if (ent != NULL) {
+        ds->ansp = malloc(ent->anslen);
+        if (ds->ansp != NULL) {
+            memcpy(ds->ansp, ent->ansp, ent->anslen);
+            ds->anslen = ds->ansmax = ent->anslen;
+            result = 1;
+        }
+    }
+    k5_mutex_unlock(&dns_cache_lock);
+    return result;
+}
+
+/* Cache ds's answer (or the nonexistence of host, if ds has no answer) for ttl
+ * seconds. */
+static void
+cache_store(struct krb5int_dns_state *ds, const char *host, long ttl)
+{
+    struct dns_cache_entry *ent;
+    time_t now = time(NULL);
+
+    if (ttl <= 0)
+        return;
+    ent = calloc(1, sizeof(*ent));
+    if (ent == NULL)
+        return;
+    ent->name = strdup(host);
+    if (ent->name == NULL)
+        goto fail;
+    if (ds->ansp != NULL) {
+        ent->ansp = malloc(ds->anslen);
+        if (ent->ansp == NULL)
+            goto fail;
+        memcpy(ent->ansp, ds->ansp, ds->anslen);
+        ent->anslen = ds->anslen;
+    }
+    ent->nclass = ds->nclass;
+    ent->ntype = ds->ntype;
+    ent->expires = now + ttl;
+
+    k5_mutex_lock(&dns_cache_lock);
+    prune_cache(now);
+    ent->next = dns_cache;
+    dns_cache = ent;
+    dns_cache_count++;
+    k5_mutex_unlock(&dns_cache_lock);
+    return;
+
+fail:
+    free_cache_entry(ent);
+}
+
+/* Return the smallest TTL of the answer records matching ds's class and type,
+ * or 0 if there are none. */
+static long
+answer_ttl(struct krb5int_dns_state *ds)
+{
+    ns_rr rr;
+    int i;
+    long ttl = 0;
+
+    for (i = 0; i < ns_msg_count(ds->msg, ns_s_an); i++) {
+        if (ns_parserr(&ds->msg, ns_s_an, i, &rr) < 0)
+            return 0;
+        if (ds->nclass != (int)ns_rr_class(rr) ||
+            ds->ntype != (int)ns_rr_type(rr))
+            continue;
+        if (ttl == 0 || (long)ns_rr_ttl(rr) < ttl)
+            ttl = ns_rr_ttl(rr);
+    }
+    return ttl;
+}
+
+#endif /* USE_DNS_CACHE */
+
 /*
  * krb5int_dns_init()
  *
@@ -144,6 +304,21 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
     ds->cur_ans = 0;
 #endif
 
+#ifdef USE_DNS_CACHE
+    ret = cache_lookup(ds, host);
+    if (ret < 0)
+        return -1;
+    if (ret > 0) {
+        ret = ns_initparse(ds->ansp, ds->anslen, &ds->msg);
+        if (ret < 0) {
+            free(ds->ansp);
+            ds->ansp = NULL;
+        }
+        return ret;
+    }
+    ret = -1;
+#endif
+
     if (!INIT_HANDLE(h))
         return -1;
 
@@ -159,6 +334,13 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
         ds->ansmax = nextincr;
 
         len = SEARCH(h, host, ds->nclass, ds->ntype, ds->ansp, ds->ansmax);
+#ifdef USE_DNS_CACHE
+        if (len < 0 && NO_SUCH_NAME(h)) {
+            free(ds->ansp);
+            ds->ansp = NULL;
+            cache_store(ds, host, DNS_NEGATIVE_TTL);
+        }
+#endif
         if ((size_t) len > maxincr) {
             ret = -1;
             goto errout;
@@ -180,6 +362,9 @@ krb5int_dns_init(struct krb5int_dns_state **dsp,
     if (ret < 0)
         goto errout;
 
+#ifdef USE_DNS_CACHE
+    cache_store(ds, host, answer_ttl(ds));
+#endif
     ret = 0;
 
 errout:
@@ -364,6 +549,32 @@ out:
 #endif /* !HAVE_NS_INITPARSE */
 #endif /* not _WIN32 */
 
+int
+k5_dns_cache_init(void)
+{
+#ifdef USE_DNS_CACHE
+    return k5_mutex_finish_init(&dns_cache_lock);
+#else
+    return 0;
+#endif
+}
+
+void
+k5_dns_cache_fini(void)
+{
+#ifdef USE_DNS_CACHE
+    struct dns_cache_entry *ent, *next;
+
+    for (ent = dns_cache; ent != NULL; ent = next) {
+        next = ent->next;
+        free_cache_entry(ent);
+    }
+    dns_cache = NULL;
+    dns_cache_count = 0;
+    k5_mutex_destroy(&dns_cache_lock);
+#endif
+}
+
 /* Construct a DNS label of the form "prefix[.name.]".  name may be NULL. */
 static char *
 txt_lookup_name(const char *prefix, const char *name)
@@ -191,6 +191,9 @@ krb5_error_code k5_try_realm_txt_rr(krb5_context context, const char *prefix,
 
 char *k5_primary_domain(void);
 
+int k5_dns_cache_init(void);
+void k5_dns_cache_fini(void);
+
 int _krb5_use_dns_realm (krb5_context);
 int _krb5_use_dns_kdc (krb5_context);
 int _krb5_conf_boolean (const char *);
@@ -211,6 +214,38 @@ krb5_error_code k5_sendto_kdc(krb5_context context, const krb5_data *message,
                               krb5_boolean no_udp, krb5_data *reply_out,
                               struct kdclist *hist);
 
+/*
+ * A set of KDC requests serviced concurrently over a single event loop.
+ * Requests are queued with k5_sendto_multi_add_kdc() and carried out by
+ * k5_sendto_multi_run(), which returns when every request has completed.
+ * Completion callbacks may queue further requests to the same set.
+ */
+struct sendto_multi;
+
+/* Completion callback for a KDC request.  If code is 0, reply holds the KDC
+ * reply and must be freed by the callback. */
+typedef void (*k5_sendto_multi_fn)(krb5_context context, krb5_error_code code,
+                                   krb5_data *reply, void *data);
+
+krb5_error_code k5_sendto_multi_create(struct sendto_multi **multi_out);
+
+/* Queue message for a KDC of realm, as k5_sendto_kdc() would send it.  message
+ * and realm are copied.  If an error is returned, callback will not be
+ * called. */
+krb5_error_code k5_sendto_multi_add_kdc(krb5_context context,
+                                        struct sendto_multi *multi,
+                                        const krb5_data *message,
+                                        const krb5_data *realm,
+                                        krb5_boolean no_udp,
+                                        k5_sendto_multi_fn callback,
+                                        void *callback_data);
+
+void k5_sendto_multi_run(krb5_context context, struct sendto_multi *multi);
+
+/* Free multi.  Requests which were never run complete with
+ * KRB5_KDC_UNREACH. */
+void k5_sendto_multi_free(krb5_context context, struct sendto_multi *multi);
+
 krb5_error_code krb5int_get_fq_local_hostname(char **);
 
 /* The io vector is *not* const here, unlike writev()!  */
@@ -62,7 +62,6 @@
 #if defined(HAVE_POLL_H)
 #include <poll.h>
 #define USE_POLL
-#define MAX_POLLFDS 1024
 #elif defined(HAVE_SYS_SELECT_H)
 #include <sys/select.h>
 #endif
@@ -87,10 +86,12 @@
 
 typedef int64_t time_ms;
 
-/* This can be pretty large, so should not be stack-allocated. */
+/* With select(), this can be pretty large, so should not be stack-allocated.
+ * With poll(), the pollfd array grows as needed. */
 struct select_state {
 #ifdef USE_POLL
-    struct pollfd fds[MAX_POLLFDS];
+    struct pollfd *fds;
+    int nalloc;
 #else
     int max;
     fd_set rfds, wfds, xfds;
@@ -144,6 +145,60 @@ struct conn_state {
     } http;
 };
 
+/*
+ * The progress of an exchange through the schedule described above k5_sendto()
+ * below.  In the first pass we resolve each server entry in turn and contact
+ * its addresses of the preferred transport, then contact the deferred
+ * addresses.  Subsequent passes retransmit over UDP with exponential backoff.
+ */
+enum sendto_phase { PHASE_FIRST, PHASE_DEFERRED, PHASE_RETRY, PHASE_DONE };
+
+/* One request to a set of servers, which may be serviced alongside others in
+ * a single event loop. */
+struct sendto_exchange {
+    /* Parameters; must remain valid until the exchange is complete. */
+    const krb5_data *message;
+    const krb5_data *realm;
+    const struct serverlist *servers;
+    k5_transport_strategy strategy;
+    struct sendto_callback_info *callback_info;
+    int (*msg_handler)(krb5_context, const krb5_data *, void *);
+    void *msg_handler_data;
+
+    /* Schedule state. */
+    struct conn_state *conns;
+    char *udpbuf;
+    enum sendto_phase phase;
+    size_t next_server;         /* Next server entry to resolve */
+    struct conn_state *cursor;  /* Next connection to contact this pass */
+    int pass;
+    time_ms delay;              /* Backoff delay at the end of this pass */
+    krb5_boolean waiting;
+    time_ms wait_end;
+    time_ms timeout;            /* Overall request deadline, or 0 */
+
+    /* Result, valid once phase is PHASE_DONE. */
+    krb5_error_code retval;
+    struct conn_state *winner;
+    krb5_data reply;
+    size_t server_used;
+    struct sockaddr_storage remote;
+    socklen_t remote_len;
+
+    /* Called after the exchange's connections are closed.  The exchange may
+     * be freed by this function. */
+    void (*done)(krb5_context, struct sendto_exchange *, void *);
+    void *done_data;
+    struct sendto_exchange *next;
+};
+
+/* A set of exchanges serviced together, sharing one select_state. */
+struct sendto_multi {
+    struct select_state selstate;
+    struct select_state seltemp;
+    struct sendto_exchange *exchanges;
+};
+
 /* Set up context->tls.  On allocation failure, return ENOMEM.  On plugin load
  * failure, set context->tls to point to a nulled vtable and return 0. */
 static krb5_error_code
@@ -212,13 +267,54 @@ find_pollfd(struct select_state *selstate, int fd)
 static void
 cm_init_selstate(struct select_state *selstate)
 {
+    selstate->fds = NULL;
+    selstate->nalloc = 0;
     selstate->nfds = 0;
 }
 
+static void
+cm_free_selstate(struct select_state *selstate)
+{
+    free(selstate->fds);
+    cm_init_selstate(selstate);
+}
+
+/* Make room for at least n pollfd entries in selstate. */
+static krb5_boolean
+cm_reserve(struct select_state *selstate, int n)
+{
+    struct pollfd *fds;
+    int newalloc;
+
+    if (n <= selstate->nalloc)
+        return TRUE;
+    newalloc = (selstate->nalloc > 0) ? selstate->nalloc : 16;
+    while (newalloc < n)
+        newalloc *= 2;
+    fds = realloc(selstate->fds, newalloc * sizeof(*fds));
+    if (fds == NULL)
+        return FALSE;
+    selstate->fds = fds;
+    selstate->nalloc = newalloc;
+    return TRUE;
+}
+
+/* Copy the fds of interest from in to out, reusing out's array. */
+static krb5_error_code
+cm_copy_selstate(const struct select_state *in, struct select_state *out)
+{
+    if (!cm_reserve(out, in->nfds))
+        return ENOMEM;
+    if (in->nfds > 0)
+        memcpy(out->fds, in->fds, in->nfds * sizeof(*in->fds));
+    out->nfds = in->nfds;
+    return 0;
+}
+
 static krb5_boolean
 cm_add_fd(struct select_state *selstate, int fd)
 {
-    if (selstate->nfds >= MAX_POLLFDS)
+    if (!cm_reserve(selstate, selstate->nfds + 1))
         return FALSE;
     selstate->fds[selstate->nfds].fd = fd;
     selstate->fds[selstate->nfds].events = 0;
@@ -281,6 +377,18 @@ cm_init_selstate(struct select_state *selstate)
     FD_ZERO(&selstate->xfds);
 }
 
+static void
+cm_free_selstate(struct select_state *selstate)
+{
+}
+
+static krb5_error_code
+cm_copy_selstate(const struct select_state *in, struct select_state *out)
+{
+    *out = *in;
+    return 0;
+}
+
 static krb5_boolean
 cm_add_fd(struct select_state *selstate, int fd)
 {
@@ -359,7 +467,9 @@ cm_select_or_poll(const struct select_state *in, time_ms endtime,
 
     /* We don't need a separate copy of the selstate for poll, but use one for
      * consistency with how we use select. */
-    *out = *in;
+    retval = cm_copy_selstate(in, out);
+    if (retval != 0)
+        return retval;
 
 #ifdef USE_POLL
     *sret = poll(out->fds, out->nfds, interval);
@@ -432,28 +542,21 @@ krb5_set_kdc_recv_hook(krb5_context context, krb5_post_recv_fn recv_hook,
 }
 
 /*
- * send the formatted request 'message' to a KDC for realm 'realm' and
- * return the response (if any) in 'reply'.
- *
- * If the message is sent and a response is received, 0 is returned,
- * otherwise an error code is returned.
- *
- * The storage for 'reply' is allocated and should be freed by the caller
- * when finished.
+ * Determine the transport strategy for message, locate the KDCs for realm
+ * into servers, and run the pre-send hook.  If the hook supplies a reply, set
+ * *hook_reply_out; if it supplies a replacement message, set
+ * *hook_message_out.
  */
-
-krb5_error_code
-k5_sendto_kdc(krb5_context context, const krb5_data *message,
-              const krb5_data *realm, krb5_boolean use_primary,
-              krb5_boolean no_udp, krb5_data *reply_out, struct kdclist *kdcs)
+static krb5_error_code
+prepare_kdc_request(krb5_context context, const krb5_data *message,
+                    const krb5_data *realm, krb5_boolean use_primary,
+                    krb5_boolean no_udp, struct serverlist *servers,
+                    k5_transport_strategy *strategy_out,
+                    krb5_data **hook_message_out, krb5_data **hook_reply_out)
 {
-    krb5_error_code retval, oldret, err;
-    struct serverlist servers;
-    int server_used = -1;
-    k5_transport_strategy strategy;
-    krb5_data reply = empty_data(), *hook_message = NULL, *hook_reply = NULL;
+    krb5_error_code retval;
 
-    *reply_out = empty_data();
+    *hook_message_out = *hook_reply_out = NULL;
 
     /*
      * find KDC location(s) for realm
@@ -488,37 +591,41 @@ k5_sendto_kdc(krb5_context context, const krb5_data *message,
     }
 
     if (no_udp)
-        strategy = NO_UDP;
+        *strategy_out = NO_UDP;
     else if (message->length <= (unsigned int) context->udp_pref_limit)
-        strategy = UDP_FIRST;
+        *strategy_out = UDP_FIRST;
     else
-        strategy = UDP_LAST;
+        *strategy_out = UDP_LAST;
 
-    retval = k5_locate_kdc(context, realm, &servers, use_primary, no_udp);
+    retval = k5_locate_kdc(context, realm, servers, use_primary, no_udp);
     if (retval)
         return retval;
 
     if (context->kdc_send_hook != NULL) {
         retval = context->kdc_send_hook(context, context->kdc_send_hook_data,
-                                        realm, message, &hook_message,
-                                        &hook_reply);
-        if (retval)
-            goto cleanup;
-
-        if (hook_reply != NULL) {
-            *reply_out = *hook_reply;
-            free(hook_reply);
-            goto cleanup;
-        }
-
-        if (hook_message != NULL)
-            message = hook_message;
+                                        realm, message, hook_message_out,
+                                        hook_reply_out);
     }
+    return retval;
+}
+
+/*
+ * Process the result retval of sending message to the KDCs for realm, where
+ * err is the KDC error seen by check_for_svc_unavailable().  Run the
+ * post-receive hook and, on success, set *reply_out to the reply (taking
+ * ownership of *reply unless the hook replaces it).  If kdcs is not null,
+ * record the KDC at index server_used of servers in it.
+ */
+static krb5_error_code
+finish_kdc_request(krb5_context context, krb5_error_code retval,
+                   krb5_error_code err, const krb5_data *realm,
+                   const krb5_data *message, struct serverlist *servers,
+                   int server_used, struct kdclist *kdcs, krb5_data *reply,
+                   krb5_data *reply_out)
+{
+    krb5_error_code oldret;
+    krb5_data *hook_reply = NULL;
 
-    err = 0;
-    retval = k5_sendto(context, message, realm, &servers, strategy, NULL,
-                       &reply, NULL, NULL, &server_used,
-                       check_for_svc_unavailable, &err);
     if (retval == KRB5_KDC_UNREACH) {
         if (err == KDC_ERR_SVC_UNAVAILABLE) {
             retval = KRB5KDC_ERR_SVC_UNAVAILABLE;
@@ -532,7 +639,7 @@ k5_sendto_kdc(krb5_context context, const krb5_data *message,
     if (context->kdc_recv_hook != NULL) {
         oldret = retval;
         retval = context->kdc_recv_hook(context, context->kdc_recv_hook_data,
-                                        retval, realm, message, &reply,
+                                        retval, realm, message, reply,
                                         &hook_reply);
         if (oldret && !retval) {
             /* The hook must set a reply if it overrides an error from
@@ -541,20 +648,68 @@ k5_sendto_kdc(krb5_context context, const krb5_data *message,
         }
     }
     if (retval)
-        goto cleanup;
+        return retval;
 
     if (hook_reply != NULL) {
         *reply_out = *hook_reply;
         free(hook_reply);
-        goto cleanup;
+        return 0;
     }
 
-    *reply_out = reply;
-    reply = empty_data();
+    *reply_out = *reply;
+    *reply = empty_data();
 
     /* Record which KDC we used if the caller asks. */
     if (kdcs != NULL && server_used != -1)
-        retval = k5_kdclist_add(kdcs, realm, &servers.servers[server_used]);
+        return k5_kdclist_add(kdcs, realm, &servers->servers[server_used]);
+    return 0;
+}
+
+/*
+ * send the formatted request 'message' to a KDC for realm 'realm' and
+ * return the response (if any) in 'reply'.
+ *
+ * If the message is sent and a response is received, 0 is returned,
+ * otherwise an error code is returned.
+ *
+ * The storage for 'reply' is allocated and should be freed by the caller
+ * when finished.
+ */
+
+krb5_error_code
+k5_sendto_kdc(krb5_context context, const krb5_data *message,
+              const krb5_data *realm, krb5_boolean use_primary,
+              krb5_boolean no_udp, krb5_data *reply_out, struct kdclist *kdcs)
+{
+    krb5_error_code retval, err;
+    struct serverlist servers = SERVERLIST_INIT;
+    int server_used = -1;
+    k5_transport_strategy strategy;
+    krb5_data reply = empty_data(), *hook_message = NULL, *hook_reply = NULL;
+
+    *reply_out = empty_data();
+
+    retval = prepare_kdc_request(context, message, realm, use_primary, no_udp,
+                                 &servers, &strategy, &hook_message,
+                                 &hook_reply);
+    if (retval)
+        goto cleanup;
+
+    if (hook_reply != NULL) {
+        *reply_out = *hook_reply;
+        free(hook_reply);
+        goto cleanup;
+    }
+    if (hook_message != NULL)
+        message = hook_message;
+
+    err = 0;
+    retval = k5_sendto(context, message, realm, &servers, strategy, NULL,
+                       &reply, NULL, NULL, &server_used,
+                       check_for_svc_unavailable, &err);
+    retval = finish_kdc_request(context, retval, err, realm, message,
+                                &servers, server_used, kdcs, &reply,
+                                reply_out);
 
 cleanup:
     krb5_free_data(context, hook_message);
@@ -1397,78 +1552,396 @@ any_tcp_connections(struct conn_state *conns)
     return FALSE;
 }
 
+/* Return true if conns contains any states with open sockets. */
 static krb5_boolean
-service_fds(krb5_context context, struct select_state *selstate,
-            time_ms interval, time_ms timeout, struct conn_state *conns,
-            struct select_state *seltemp, const krb5_data *realm,
-            int (*msg_handler)(krb5_context, const krb5_data *, void *),
-            void *msg_handler_data, struct conn_state **winner_out)
-{
-    int e, selret = 0;
-    time_ms curtime, interval_end, endtime;
+any_open_connections(struct conn_state *conns)
+{
     struct conn_state *state;
 
-    *winner_out = NULL;
+    for (state = conns; state != NULL; state = state->next) {
+        if (state->fd != INVALID_SOCKET)
+            return TRUE;
+    }
+    return FALSE;
+}
 
-    e = get_curtime_ms(&curtime);
-    if (e)
-        return TRUE;
-    interval_end = curtime + interval;
-
-    e = 0;
-    while (selstate->nfds > 0) {
-        endtime = any_tcp_connections(conns) ? 0 : interval_end;
-        /* Don't wait longer than the whole request should last. */
-        if (timeout && (!endtime || endtime > timeout))
-            endtime = timeout;
-        e = cm_select_or_poll(selstate, endtime, seltemp, &selret);
-        if (e == EINTR)
-            continue;
-        if (e != 0)
-            break;
+static void
+finish_exchange(struct sendto_exchange *x, krb5_error_code retval)
+{
+    x->phase = PHASE_DONE;
+    x->waiting = FALSE;
+    x->retval = retval;
+}
 
-        if (selret == 0) {
-            /* We timed out.  Stop if we hit the overall request timeout. */
-            if (timeout && (get_curtime_ms(&curtime) || curtime >= timeout))
-                return TRUE;
-            /* Otherwise return to the caller to send the next request. */
-            return FALSE;
-        }
+/* Wait up to interval milliseconds for a reply before advancing x. */
+static void
+start_wait(struct sendto_exchange *x, time_ms interval)
+{
+    time_ms curtime;
 
-        /* Got something on a socket, process it.  */
-        for (state = conns; state != NULL; state = state->next) {
-            int ssflags;
+    if (get_curtime_ms(&curtime) != 0) {
+        finish_exchange(x, KRB5_KDC_UNREACH);
+        return;
+    }
+    x->waiting = TRUE;
+    x->wait_end = curtime + interval;
+}
 
-            if (state->fd == INVALID_SOCKET)
-                continue;
-            ssflags = cm_get_ssflags(seltemp, state->fd);
-            if (!ssflags)
-                continue;
+/*
+ * Return true if x is done waiting: either no connections remain open, or the
+ * wait interval has passed and no TCP connection is in progress.  (Whenever a
+ * TCP connection is established, we wait for it to finish or fail before
+ * moving on.)
+ */
+static krb5_boolean
+wait_over(struct sendto_exchange *x, time_ms curtime)
+{
+    if (!any_open_connections(x->conns))
+        return TRUE;
+    return curtime >= x->wait_end && !any_tcp_connections(x->conns);
+}
+
+/* Return the time at which x next needs attention if no socket events occur,
+ * or 0 if only a socket event can advance it. */
+static time_ms
+exchange_deadline(struct sendto_exchange *x)
+{
+    time_ms endtime = any_tcp_connections(x->conns) ? 0 : x->wait_end;
 
-            if (service_dispatch(context, realm, state, selstate, ssflags)) {
-                int stop = 1;
+    /* Don't wait longer than the whole request should last. */
+    if (x->timeout && (!endtime || endtime > x->timeout))
+        endtime = x->timeout;
+    return endtime;
+}
 
-                if (msg_handler != NULL) {
-                    krb5_data reply = make_data(state->in.buf, state->in.pos);
+/* Contact connections of x according to the schedule until we need to wait
+ * for a reply, or finish x if the schedule is exhausted. */
+static void
+advance_exchange(krb5_context context, struct sendto_exchange *x,
+                 struct select_state *selstate)
+{
+    krb5_error_code retval;
+    struct conn_state *state, **tailptr;
 
-                    if (!msg_handler(context, &reply, msg_handler_data)) {
-                        kill_conn(context, state, selstate);
-                        stop = 0;
-                    }
-                }
+    /* Give up once we run out of passes or connections to retry. */
+    if (x->phase == PHASE_RETRY &&
+        (x->pass >= MAX_PASS || !any_open_connections(x->conns))) {
+        finish_exchange(x, KRB5_KDC_UNREACH);
+        return;
+    }
 
-                if (stop) {
-                    *winner_out = state;
-                    return TRUE;
-                }
+    for (;;) {
+        /* Contact the next connection of this pass and wait 1s for an answer.
+         * In the first pass, defer connections which use the non-preferred
+         * RFC 4120 transport. */
+        while (x->cursor != NULL) {
+            state = x->cursor;
+            x->cursor = state->next;
+            if (x->phase == PHASE_FIRST && state->defer)
+                continue;
+            if (x->phase == PHASE_DEFERRED && !state->defer)
+                continue;
+            if (maybe_send(context, state, x->message, selstate, x->realm,
+                           x->callback_info))
+                continue;
+            start_wait(x, 1000);
+            return;
+        }
+
+        if (x->phase == PHASE_FIRST &&
+            x->next_server < x->servers->nservers) {
+            /* Resolve the next server entry and contact its addresses. */
+            for (tailptr = &x->conns; *tailptr != NULL;
+                 tailptr = &(*tailptr)->next);
+            retval = resolve_server(context, x->realm, x->servers,
+                                    x->next_server++, x->strategy, x->message,
+                                    &x->udpbuf, &x->conns);
+            if (retval) {
+                finish_exchange(x, retval);
+                return;
             }
+            x->cursor = *tailptr;
+        } else if (x->phase == PHASE_FIRST) {
+            /* Complete the first pass by contacting servers of the
+             * non-preferred RFC 4120 transport (if given). */
+            x->phase = PHASE_DEFERRED;
+            x->cursor = x->conns;
+        } else if (x->phase == PHASE_DEFERRED) {
+            /* Wait for two seconds at the end of the first pass. */
+            x->phase = PHASE_RETRY;
+            x->pass = 1;
+            x->delay = 4000;
+            x->cursor = x->conns;
+            start_wait(x, 2000);
+            return;
+        } else {
+            /* Wait for the delay backoff at the end of this pass. */
+            start_wait(x, x->delay);
+            x->delay *= 2;
+            x->pass++;
+            x->cursor = x->conns;
+            return;
         }
     }
-    if (e != 0)
+}
+
+/* Return true if the complete reply on conn should finish x.  Kill conn if
+ * the message handler rejects the reply. */
+static krb5_boolean
+accept_reply(krb5_context context, struct sendto_exchange *x,
+             struct conn_state *conn, struct select_state *selstate)
+{
+    krb5_data reply;
+
+    if (x->msg_handler == NULL)
+        return TRUE;
+    reply = make_data(conn->in.buf, conn->in.pos);
+    if (x->msg_handler(context, &reply, x->msg_handler_data))
         return TRUE;
+    kill_conn(context, conn, selstate);
     return FALSE;
 }
 
+/* Process the events reported in seltemp for the connections of x. */
+static void
+service_exchange(krb5_context context, struct sendto_exchange *x,
+                 struct select_state *selstate, struct select_state *seltemp)
+{
+    struct conn_state *state;
+    int ssflags;
+
+    for (state = x->conns; state != NULL; state = state->next) {
+        if (state->fd == INVALID_SOCKET)
+            continue;
+        ssflags = cm_get_ssflags(seltemp, state->fd);
+        if (!ssflags)
+            continue;
+
+        if (service_dispatch(context, x->realm, state, selstate, ssflags) &&
+            accept_reply(context, x, state, selstate)) {
+            x->winner = state;
+            finish_exchange(x, 0);
+            return;
+        }
+    }
+}
+
+/* Take the reply from the winning connection of x, if there is one, and close
+ * and free all of the connections of x. */
+static void
+complete_exchange(krb5_context context, struct sendto_exchange *x,
+                  struct select_state *selstate)
+{
+    struct conn_state *state, *next, *winner = x->winner;
+
+    if (winner != NULL) {
+        x->reply = make_data(winner->in.buf, winner->in.pos);
+        winner->in.buf = NULL;
+        if (x->reply.data == x->udpbuf)
+            x->udpbuf = NULL;
+        x->server_used = winner->server_index;
+        x->remote_len = sizeof(x->remote);
+        if (getpeername(winner->fd, ss2sa(&x->remote), &x->remote_len) != 0)
+            x->remote_len = 0;
+        TRACE_SENDTO_KDC_RESPONSE(context, x->reply.length, &winner->addr);
+    }
+
+    for (state = x->conns; state != NULL; state = next) {
+        next = state->next;
+        if (state->fd != INVALID_SOCKET) {
+            if (socktype_for_transport(state->addr.transport) == SOCK_STREAM)
+                TRACE_SENDTO_KDC_TCP_DISCONNECT(context, &state->addr);
+            cm_remove_fd(selstate, state->fd);
+            closesocket(state->fd);
+            free_http_tls_data(context, state);
+        }
+        /* UDP connections share x->udpbuf. */
+        if (state->addr.transport != UDP)
+            free(state->in.buf);
+        if (x->callback_info) {
+            x->callback_info->pfn_cleanup(x->callback_info->data,
+                                          &state->callback_buffer);
+        }
+        free(state);
+    }
+    x->conns = x->cursor = x->winner = NULL;
+    free(x->udpbuf);
+    x->udpbuf = NULL;
+}
+
+static krb5_error_code
+init_exchange(krb5_context context, struct sendto_exchange *x,
+              const krb5_data *message, const krb5_data *realm,
+              const struct serverlist *servers,
+              k5_transport_strategy strategy,
+              struct sendto_callback_info *callback_info,
+              int (*msg_handler)(krb5_context, const krb5_data *, void *),
+              void *msg_handler_data)
+{
+    krb5_error_code retval;
+
+    memset(x, 0, sizeof(*x));
+    x->message = message;
+    x->realm = realm;
+    x->servers = servers;
+    x->strategy = strategy;
+    x->callback_info = callback_info;
+    x->msg_handler = msg_handler;
+    x->msg_handler_data = msg_handler_data;
+    x->phase = PHASE_FIRST;
+    x->reply = empty_data();
+
+    if (context->req_timeout) {
+        retval = get_curtime_ms(&x->timeout);
+        if (retval)
+            return retval;
+        x->timeout += 1000 * context->req_timeout;
+    }
+    return 0;
+}
+
+/* Chain x onto the tail of the exchange list of multi. */
+static void
+add_exchange(struct sendto_multi *multi, struct sendto_exchange *x)
+{
+    struct sendto_exchange **tailptr;
+
+    for (tailptr = &multi->exchanges; *tailptr != NULL;
+         tailptr = &(*tailptr)->next);
+    *tailptr = x;
+}
+
+static void
+fail_exchanges(struct sendto_multi *multi)
+{
+    struct sendto_exchange *x;
+
+    for (x = multi->exchanges; x != NULL; x = x->next) {
+        if (x->phase != PHASE_DONE)
+            finish_exchange(x, KRB5_KDC_UNREACH);
+    }
+}
+
+/*
+ * Advance each exchange of multi which is not waiting for a reply, and
+ * complete the exchanges which have finished.  Completion callbacks may add
+ * new exchanges.  Return true if any exchanges were completed.
+ */
+static krb5_boolean
+step_exchanges(krb5_context context, struct sendto_multi *multi)
+{
+    struct sendto_exchange *x, **xp;
+    time_ms curtime;
+    krb5_boolean completed = FALSE;
+
+    if (get_curtime_ms(&curtime) != 0)
+        fail_exchanges(multi);
+
+    for (x = multi->exchanges; x != NULL; x = x->next) {
+        if (x->phase == PHASE_DONE)
+            continue;
+        /* Stop if we hit the overall request timeout. */
+        if (x->timeout && curtime >= x->timeout) {
+            finish_exchange(x, KRB5_KDC_UNREACH);
+            continue;
+        }
+        if (x->waiting && !wait_over(x, curtime))
+            continue;
+        x->waiting = FALSE;
+        advance_exchange(context, x, &multi->selstate);
+    }
+
+    xp = &multi->exchanges;
+    while (*xp != NULL) {
+        x = *xp;
+        if (x->phase != PHASE_DONE) {
+            xp = &x->next;
+            continue;
+        }
+        *xp = x->next;
+        complete_exchange(context, x, &multi->selstate);
+        if (x->done != NULL)
+            x->done(context, x, x->done_data);
+        completed = TRUE;
+    }
+    return completed;
+}
+
+krb5_error_code
+k5_sendto_multi_create(struct sendto_multi **multi_out)
+{
+    struct sendto_multi *multi;
+
+    *multi_out = NULL;
+    multi = malloc(sizeof(*multi));
+    if (multi == NULL)
+        return ENOMEM;
+    cm_init_selstate(&multi->selstate);
+    cm_init_selstate(&multi->seltemp);
+    multi->exchanges = NULL;
+    *multi_out = multi;
+    return 0;
+}
+
+void
+k5_sendto_multi_run(krb5_context context, struct sendto_multi *multi)
+{
+    struct sendto_exchange *x;
+    time_ms endtime, t;
+    krb5_error_code e;
+    int selret;
+
+    for (;;) {
+        /* Loop until every remaining exchange is waiting for a reply. */
+        while (step_exchanges(context, multi));
+        if (multi->exchanges == NULL)
+            break;
+
+        endtime = 0;
+        for (x = multi->exchanges; x != NULL; x = x->next) {
+            t = exchange_deadline(x);
+            if (t && (!endtime || t < endtime))
+                endtime = t;
+        }
+
+        e = cm_select_or_poll(&multi->selstate, endtime, &multi->seltemp,
+                              &selret);
+        if (e == EINTR)
+            continue;
+        if (e != 0) {
+            fail_exchanges(multi);
+            continue;
+        }
+
+        /* Got something on a socket, process it. */
+        for (x = multi->exchanges; x != NULL && selret > 0; x = x->next) {
+            if (x->phase != PHASE_DONE)
+                service_exchange(context, x, &multi->selstate,
+                                 &multi->seltemp);
+        }
+    }
+}
+
+void
+k5_sendto_multi_free(krb5_context context, struct sendto_multi *multi)
+{
+    struct sendto_exchange *x, *next;
+
+    if (multi == NULL)
+        return;
+    /* Complete any exchanges which were never run. */
+    for (x = multi->exchanges; x != NULL; x = next) {
+        next = x->next;
+        finish_exchange(x, KRB5_KDC_UNREACH);
+        complete_exchange(context, x, &multi->selstate);
+        if (x->done != NULL)
+            x->done(context, x, x->done_data);
+    }
+    cm_free_selstate(&multi->selstate);
+    cm_free_selstate(&multi->seltemp);
+    free(multi);
+}
+
 /*
  * Current worst-case timeout behavior:
  *
@@ -1505,133 +1978,139 @@ k5_sendto(krb5_context context, const krb5_data *message,
           int (*msg_handler)(krb5_context, const krb5_data *, void *),
           void *msg_handler_data)
 {
-    int pass;
-    time_ms delay, timeout = 0;
     krb5_error_code retval;
-    struct conn_state *conns = NULL, *state, **tailptr, *next, *winner;
-    size_t s;
-    struct select_state *sel_state = NULL, *seltemp;
-    char *udpbuf = NULL;
-    krb5_boolean done = FALSE;
+    struct sendto_multi *multi;
+    struct sendto_exchange x;
+    socklen_t len;
 
     *reply = empty_data();
 
-    if (context->req_timeout) {
-        retval = get_curtime_ms(&timeout);
-        if (retval)
-            return retval;
-        timeout += 1000 * context->req_timeout;
-    }
+    retval = init_exchange(context, &x, message, realm, servers, strategy,
+                           callback_info, msg_handler, msg_handler_data);
+    if (retval)
+        return retval;
+    retval = k5_sendto_multi_create(&multi);
+    if (retval)
+        return retval;
+    add_exchange(multi, &x);
+    k5_sendto_multi_run(context, multi);
+    k5_sendto_multi_free(context, multi);
+    if (x.retval)
+        return x.retval;
 
-    /* One for use here, listing all our fds in use, and one for
-     * temporary use in service_fds, for the fds of interest.  */
-    sel_state = malloc(2 * sizeof(*sel_state));
-    if (sel_state == NULL) {
-        retval = ENOMEM;
-        goto cleanup;
-    }
-    seltemp = &sel_state[1];
-    cm_init_selstate(sel_state);
-
-    /* First pass: resolve server hosts, communicate with resulting addresses
-     * of the preferred transport, and wait 1s for an answer from each. */
-    for (s = 0; s < servers->nservers && !done; s++) {
-        /* Find the current tail pointer. */
-        for (tailptr = &conns; *tailptr != NULL; tailptr = &(*tailptr)->next);
-        retval = resolve_server(context, realm, servers, s, strategy, message,
-                                &udpbuf, &conns);
-        if (retval)
-            goto cleanup;
-        for (state = *tailptr; state != NULL && !done; state = state->next) {
-            /* Contact each new connection, deferring those which use the
-             * non-preferred RFC 4120 transport. */
-            if (state->defer)
-                continue;
-            if (maybe_send(context, state, message, sel_state, realm,
-                           callback_info))
-                continue;
-            done = service_fds(context, sel_state, 1000, timeout, conns,
-                               seltemp, realm, msg_handler, msg_handler_data,
-                               &winner);
-        }
+    /* Success!  */
+    *reply = x.reply;
+    if (server_used != NULL)
+        *server_used = x.server_used;
+    if (remoteaddr != NULL && remoteaddrlen != 0 && *remoteaddrlen > 0 &&
+        x.remote_len > 0) {
+        len = (*remoteaddrlen < x.remote_len) ? *remoteaddrlen : x.remote_len;
+        memcpy(remoteaddr, &x.remote, len);
+        *remoteaddrlen = x.remote_len;
     }
+    return 0;
+}
 
-    /* Complete the first pass by contacting servers of the non-preferred RFC
-     * 4120 transport (if given), waiting 1s for an answer from each. */
-    for (state = conns; state != NULL && !done; state = state->next) {
-        if (!state->defer)
-            continue;
-        if (maybe_send(context, state, message, sel_state, realm,
-                       callback_info))
-            continue;
-        done = service_fds(context, sel_state, 1000, timeout, conns, seltemp,
-                           realm, msg_handler, msg_handler_data, &winner);
-    }
+/* A KDC request queued by k5_sendto_multi_add_kdc(). */
+struct kdc_request {
+    struct sendto_exchange x;
+    krb5_data *message;
+    krb5_data *realm;
+    krb5_data *hook_message;
+    krb5_boolean hook_replied;
+    struct serverlist servers;
+    krb5_error_code err;
+    k5_sendto_multi_fn callback;
+    void *callback_data;
+};
 
-    /* Wait for two seconds at the end of the first pass. */
-    if (!done) {
-        done = service_fds(context, sel_state, 2000, timeout, conns, seltemp,
-                           realm, msg_handler, msg_handler_data, &winner);
-    }
+static void
+free_kdc_request(krb5_context context, struct kdc_request *req)
+{
+    krb5_free_data(context, req->message);
+    krb5_free_data(context, req->realm);
+    krb5_free_data(context, req->hook_message);
+    k5_free_serverlist(&req->servers);
+    free(req);
+}
 
-    /* Make remaining passes over all of the connections. */
-    delay = 4000;
-    for (pass = 1; pass < MAX_PASS && !done; pass++) {
-        for (state = conns; state != NULL && !done; state = state->next) {
-            if (maybe_send(context, state, message, sel_state, realm,
-                           callback_info))
-                continue;
-            done = service_fds(context, sel_state, 1000, timeout, conns,
-                               seltemp, realm, msg_handler, msg_handler_data,
-                               &winner);
-            if (sel_state->nfds == 0)
-                break;
-        }
-        /* Wait for the delay backoff at the end of this pass. */
-        if (!done) {
-            done = service_fds(context, sel_state, delay, timeout, conns,
-                               seltemp, realm, msg_handler, msg_handler_data,
-                               &winner);
-        }
-        if (sel_state->nfds == 0)
-            break;
-        delay *= 2;
-    }
+static void
+kdc_request_done(krb5_context context, struct sendto_exchange *x, void *data)
+{
+    struct kdc_request *req = data;
+    krb5_error_code retval;
+    krb5_data reply = empty_data();
+    const krb5_data *message;
 
-    if (sel_state->nfds == 0 || !done || winner == NULL) {
-        retval = KRB5_KDC_UNREACH;
-        goto cleanup;
+    if (req->hook_replied) {
+        retval = 0;
+        reply = x->reply;
+    } else {
+        message = (req->hook_message != NULL) ? req->hook_message :
+            req->message;
+        retval = finish_kdc_request(context, x->retval, req->err, req->realm,
+                                    message, &req->servers, -1, NULL,
+                                    &x->reply, &reply);
+        krb5_free_data_contents(context, &x->reply);
     }
-    /* Success!  */
-    *reply = make_data(winner->in.buf, winner->in.pos);
-    retval = 0;
-    winner->in.buf = NULL;
-    if (server_used != NULL)
-        *server_used = winner->server_index;
-    if (remoteaddr != NULL && remoteaddrlen != 0 && *remoteaddrlen > 0)
-        (void)getpeername(winner->fd, remoteaddr, remoteaddrlen);
-    TRACE_SENDTO_KDC_RESPONSE(context, reply->length, &winner->addr);
+    req->callback(context, retval, &reply, req->callback_data);
+    free_kdc_request(context, req);
+}
 
-cleanup:
-    for (state = conns; state != NULL; state = next) {
-        next = state->next;
-        if (state->fd != INVALID_SOCKET) {
-            if (socktype_for_transport(state->addr.transport) == SOCK_STREAM)
-                TRACE_SENDTO_KDC_TCP_DISCONNECT(context, &state->addr);
-            closesocket(state->fd);
-            free_http_tls_data(context, state);
-        }
-        if (state->in.buf != udpbuf)
-            free(state->in.buf);
-        if (callback_info) {
-            callback_info->pfn_cleanup(callback_info->data,
-                                       &state->callback_buffer);
-        }
-        free(state);
+krb5_error_code
+k5_sendto_multi_add_kdc(krb5_context context, struct sendto_multi *multi,
+                        const krb5_data *message, const krb5_data *realm,
+                        krb5_boolean no_udp, k5_sendto_multi_fn callback,
+                        void *callback_data)
+{
+    krb5_error_code retval;
+    struct kdc_request *req;
+    k5_transport_strategy strategy;
+    krb5_data *hook_reply = NULL;
+
+    req = k5alloc(sizeof(*req), &retval);
+    if (req == NULL)
+        return retval;
+    req->callback = callback;
+    req->callback_data = callback_data;
+
+    retval = krb5_copy_data(context, message, &req->message);
+    if (retval)
+        goto error;
+    retval = krb5_copy_data(context, realm, &req->realm);
+    if (retval)
+        goto error;
+
+    retval = prepare_kdc_request(context, req->message, req->realm, FALSE,
+                                 no_udp, &req->servers, &strategy,
+                                 &req->hook_message, &hook_reply);
+    if (retval)
+        goto error;
+
+    message = (req->hook_message != NULL) ? req->hook_message : req->message;
+    retval = init_exchange(context, &req->x, message, req->realm,
+                           &req->servers, strategy, NULL,
+                           check_for_svc_unavailable, &req->err);
+    if (retval)
+        goto error;
+    req->x.done = kdc_request_done;
+    req->x.done_data = req;
+
+    /* If the pre-send hook synthesized a reply, deliver it without sending
+     * anything. */
+    if (hook_reply != NULL) {
+        req->hook_replied = TRUE;
+        req->x.reply = *hook_reply;
+        free(hook_reply);
+        hook_reply = NULL;
+        finish_exchange(&req->x, 0);
     }
 
-    if (reply->data != udpbuf)
-        free(udpbuf);
-    free(sel_state);
+    add_exchange(multi, &req->x);
+    return 0;
+
+error:
+    krb5_free_data(context, hook_reply);
+    free_kdc_request(context, req);
     return retval;
 }
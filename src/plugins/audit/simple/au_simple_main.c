@@ -34,22 +34,173 @@
  * This is a demo implementation of Audit JSON-based module.
  * It utilizes MIT Kerberos <kdc_j_encode.h> routines for JSON processing and
  * the Fedora/Debian libaudit library for audit logs.
+ *
+ * Records are encoded in the request path, since the audit state refers to
+ * request data, but are written to the audit system by a background thread so
+ * that audit I/O does not add to KDC response latency.  The writer thread
+ * takes all queued records at once and writes them as a batch.
  */
 
 #include <k5-int.h>
 #include <krb5/audit_plugin.h>
 #include <libaudit.h>
 #include <kdc_j_encode.h>
+#include <pthread.h>
+
+#define DEFAULT_QUEUE_SIZE 1024
 
 krb5_error_code
 audit_simple_initvt(krb5_context context, int maj_ver, int min_ver,
                     krb5_plugin_vtable vtable);
 
+struct record {
+    int type;
+    krb5_boolean success;
+    char *jout;
+};
+
 struct krb5_audit_moddata_st {
     int fd;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+    pthread_cond_t nonfull;
+
+    /* Circular queue of records awaiting the writer, and the writer's batch
+     * buffer.  Both have room for size records. */
+    struct record *queue;
+    struct record *batch;
+    size_t size;
+    size_t head;
+    size_t count;
+
+    krb5_boolean drop;          /* Drop records if the queue is full */
+    unsigned long ndropped;     /* Records dropped since last reported */
+    krb5_boolean stop;
 };
 
-/* Open connection to the audit system. Returns 0 on success. */
+/* Read the queue size and overflow policy from the KDC profile. */
+static void
+get_queue_config(size_t *size_out, krb5_boolean *drop_out)
+{
+    krb5_context context;
+    char *str;
+    int size;
+
+    *size_out = DEFAULT_QUEUE_SIZE;
+    *drop_out = FALSE;
+    if (krb5int_init_context_kdc(&context) != 0)
+        return;
+    if (profile_get_integer(context->profile, KRB5_CONF_KDCDEFAULTS,
+                            KRB5_CONF_AUDIT_QUEUE_SIZE, NULL,
+                            DEFAULT_QUEUE_SIZE, &size) == 0 && size > 0)
+        *size_out = size;
+    if (profile_get_string(context->profile, KRB5_CONF_KDCDEFAULTS,
+                           KRB5_CONF_AUDIT_QUEUE_OVERFLOW, NULL, "block",
+                           &str) == 0 && str != NULL) {
+        *drop_out = (strcasecmp(str, "drop") == 0);
+        profile_release_string(str);
+    }
+    krb5_free_context(context);
+}
+
+/* Write a record noting that ndropped records were discarded. */
+static void
+write_dropped(int fd, unsigned long ndropped)
+{
+    char buf[128];
+
+    snprintf(buf, sizeof(buf),
+             "{\"event_name\": \"AUDIT_RECORDS_DROPPED\", \"count\": %lu}",
+             ndropped);
+    (void)audit_log_user_message(fd, AUDIT_USER_AUTH, buf, NULL, NULL, NULL,
+                                 0);
+}
+
+/* Write queued records in batches until told to stop and the queue is
+ * drained. */
+static void *
+writer_thread(void *arg)
+{
+    krb5_audit_moddata auctx = arg;
+    struct record *rec;
+    unsigned long ndropped;
+    size_t i, n;
+
+    pthread_mutex_lock(&auctx->lock);
+    for (;;) {
+        while (auctx->count == 0 && auctx->ndropped == 0 && !auctx->stop)
+            pthread_cond_wait(&auctx->nonempty, &auctx->lock);
+        if (auctx->count == 0 && auctx->ndropped == 0)
+            break;
+
+        /* Take everything in the queue. */
+        n = auctx->count;
+        for (i = 0; i < n; i++) {
+            auctx->batch[i] = auctx->queue[auctx->head];
+            auctx->head = (auctx->head + 1) % auctx->size;
+        }
+        auctx->count = 0;
+        ndropped = auctx->ndropped;
+        auctx->ndropped = 0;
+        pthread_cond_broadcast(&auctx->nonfull);
+        pthread_mutex_unlock(&auctx->lock);
+
+        if (ndropped > 0)
+            write_dropped(auctx->fd, ndropped);
+        for (i = 0; i < n; i++) {
+            rec = &auctx->batch[i];
+            (void)audit_log_user_message(auctx->fd, rec->type, rec->jout,
+                                         NULL, NULL, NULL, rec->success);
+            free(rec->jout);
+        }
+
+        pthread_mutex_lock(&auctx->lock);
+    }
+    pthread_mutex_unlock(&auctx->lock);
+    return NULL;
+}
+
+/* Queue an encoded record for the writer thread, taking ownership of jout.  If
+ * the queue is full, wait for space or drop the record according to the
+ * configured policy. */
+static krb5_error_code
+queue_record(krb5_audit_moddata auctx, int type, krb5_boolean success,
+             char *jout)
+{
+    struct record *rec;
+
+    pthread_mutex_lock(&auctx->lock);
+    while (auctx->count == auctx->size && !auctx->drop)
+        pthread_cond_wait(&auctx->nonfull, &auctx->lock);
+    if (auctx->count == auctx->size) {
+        auctx->ndropped++;
+        pthread_mutex_unlock(&auctx->lock);
+        free(jout);
+        return 0;
+    }
+    rec = &auctx->queue[(auctx->head + auctx->count) % auctx->size];
+    rec->type = type;
+    rec->success = success;
+    rec->jout = jout;
+    auctx->count++;
+    pthread_cond_signal(&auctx->nonempty);
+    pthread_mutex_unlock(&auctx->lock);
+    return 0;
+}
+
+static void
+free_moddata(krb5_audit_moddata auctx)
+{
+    if (auctx == NULL)
+        return;
+    free(auctx->queue);
+    free(auctx->batch);
+    free(auctx);
+}
+
+/* Open connection to the audit system and start the writer thread.  Returns 0
+ * on success. */
 static krb5_error_code
 open_au(krb5_audit_moddata *auctx_out)
 {
@@ -58,25 +209,57 @@ open_au(krb5_audit_moddata *auctx_out)
     krb5_audit_moddata auctx;
 
     auctx = k5calloc(1, sizeof(*auctx), &ret);
-    if (ret)
+    if (auctx == NULL)
+        return ENOMEM;
+    get_queue_config(&auctx->size, &auctx->drop);
+    auctx->queue = k5calloc(auctx->size, sizeof(*auctx->queue), &ret);
+    auctx->batch = k5calloc(auctx->size, sizeof(*auctx->batch), &ret);
+    if (auctx->queue == NULL || auctx->batch == NULL) {
+        free_moddata(auctx);
         return ENOMEM;
+    }
     fd = audit_open();
-    if (fd < 0)
+    if (fd < 0) {
+        free_moddata(auctx);
         return KRB5_PLUGIN_NO_HANDLE; /* audit module is unavailable */
-
+    }
     auctx->fd = fd;
-    *auctx_out = auctx;
 
+    pthread_mutex_init(&auctx->lock, NULL);
+    pthread_cond_init(&auctx->nonempty, NULL);
+    pthread_cond_init(&auctx->nonfull, NULL);
+    ret = pthread_create(&auctx->writer, NULL, writer_thread, auctx);
+    if (ret) {
+        pthread_cond_destroy(&auctx->nonfull);
+        pthread_cond_destroy(&auctx->nonempty);
+        pthread_mutex_destroy(&auctx->lock);
+        audit_close(fd);
+        free_moddata(auctx);
+        return ret;
+    }
+
+    *auctx_out = auctx;
     return 0;
 }
 
-/* Close connection to the audit system. Returns 0 on success. */
+/* Write any queued records and close connection to the audit system.  Returns
+ * 0 on success. */
 static krb5_error_code
 close_au(krb5_audit_moddata auctx)
 {
     int fd = auctx->fd;
 
+    pthread_mutex_lock(&auctx->lock);
+    auctx->stop = TRUE;
+    pthread_cond_signal(&auctx->nonempty);
+    pthread_mutex_unlock(&auctx->lock);
+    pthread_join(auctx->writer, NULL);
+
+    pthread_cond_destroy(&auctx->nonfull);
+    pthread_cond_destroy(&auctx->nonempty);
+    pthread_mutex_destroy(&auctx->lock);
     audit_close(fd);
+    free_moddata(auctx);
     return 0;
 }
 
@@ -95,11 +278,7 @@ j_kdc_start(krb5_audit_moddata auctx, krb5_boolean ev_success)
     ret = kau_j_kdc_start(ev_success, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log KDC-stop event. Returns 0 on success. */
@@ -117,11 +296,7 @@ j_kdc_stop(krb5_audit_moddata auctx, krb5_boolean ev_success)
     ret = kau_j_kdc_stop(ev_success, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log AS_REQ event. Returns 0 on success */
@@ -140,11 +315,7 @@ j_as_req(krb5_audit_moddata auctx, krb5_boolean ev_success,
     ret = kau_j_as_req(ev_success, state, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log TGS_REQ event. Returns 0 on success */
@@ -163,11 +334,7 @@ j_tgs_req(krb5_audit_moddata auctx, krb5_boolean ev_success,
     ret = kau_j_tgs_req(ev_success, state, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log S4U2SELF event. Returns 0 on success */
@@ -186,11 +353,7 @@ j_tgs_s4u2self(krb5_audit_moddata auctx, krb5_boolean ev_success,
     ret = kau_j_tgs_s4u2self(ev_success, state, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log S4U2PROXY event. Returns 0 on success */
@@ -209,11 +372,7 @@ j_tgs_s4u2proxy(krb5_audit_moddata auctx, krb5_boolean ev_success,
     ret = kau_j_tgs_s4u2proxy(ev_success, state, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 /* Log user-to-user event. Returns 0 on success */
@@ -232,11 +391,7 @@ j_tgs_u2u(krb5_audit_moddata auctx, krb5_boolean ev_success,
     ret = kau_j_tgs_u2u(ev_success, state, &jout);
     if (ret)
         return ret;
-    if (audit_log_user_message(fd, local_type, jout,
-                               NULL, NULL, NULL, ev_success) <= 0)
-        ret = EIO;
-    free(jout);
-    return ret;
+    return queue_record(auctx, local_type, ev_success, jout);
 }
 
 krb5_error_code
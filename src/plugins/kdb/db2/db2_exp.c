@@ -133,6 +133,12 @@ WRAP_K (krb5_db2_iterate,
                                krb5_db_entry *),
          krb5_pointer p, krb5_flags flags),
         (ctx, s, f, p, flags));
+WRAP_K (krb5_db2_iterate_after,
+        (krb5_context ctx, char *s, const char *start,
+         krb5_error_code (*f) (krb5_pointer,
+                               krb5_db_entry *),
+         krb5_pointer p, krb5_flags flags),
+        (ctx, s, start, f, p, flags));
 
 WRAP_K (krb5_db2_create_policy,
         (krb5_context context, osa_policy_ent_t entry),
@@ -200,7 +206,7 @@ hack_cleanup (void)
 
 kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_db2, kdb_function_table) = {
     KRB5_KDB_DAL_MAJOR_VERSION,             /* major version number */
-    0,                                      /* minor version number 0 */
+    1,                                      /* minor version number 1 */
     /* init_library */                  hack_init,
     /* fini_library */                  hack_cleanup,
     /* init_module */                   wrap_krb5_db2_open,
@@ -232,4 +238,11 @@ kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_db2, kdb_function_table) = {
     /* check_policy_as */               wrap_krb5_db2_check_policy_as,
     /* check_policy_tgs */              NULL,
     /* audit_as_req */                  wrap_krb5_db2_audit_as_req,
+    /* refresh_config */                NULL,
+    /* check_allowed_to_delegate */     NULL,
+    /* free_principal_e_data */         NULL,
+    /* get_s4u_x509_principal */        NULL,
+    /* allowed_to_delegate_from */      NULL,
+    /* issue_pac */                     NULL,
+    /* iterate_after */                 wrap_krb5_db2_iterate_after,
 };
@@ -393,6 +393,18 @@ open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
     return (db == NULL) ? errno : 0;
 }
 
+/* Return the modification time of dbc's lock file, or -1 if it cannot be
+ * determined.  ctx_update_age() advances it whenever the database changes. */
+static time_t
+ctx_age(krb5_db2_context *dbc)
+{
+    struct stat st;
+
+    if (fstat(dbc->db_lf_file, &st) < 0)
+        return -1;
+    return st.st_mtime;
+}
+
 static krb5_error_code
 ctx_unlock(krb5_context context, krb5_db2_context *dbc)
 {
@@ -406,8 +418,12 @@ ctx_unlock(krb5_context context, krb5_db2_context *dbc)
 
     db = dbc->db;
     if (--(dbc->db_locks_held) == 0) {
-        db->close(db);
-        dbc->db = NULL;
+        /* Leave a read-only handle open for the next shared lock, which will
+         * reuse it if the database has not changed in the meantime. */
+        if (dbc->db_lock_mode != KRB5_LOCKMODE_SHARED) {
+            db->close(db);
+            dbc->db = NULL;
+        }
         dbc->db_lock_mode = 0;
 
         retval2 = krb5_lock_file(context, dbc->db_lf_file,
@@ -447,19 +463,30 @@ ctx_lock(krb5_context context, krb5_db2_context *dbc, int lockmode)
         else if (retval)
             return retval;
 
-        /* Open the DB (or re-open it for read/write). */
-        if (dbc->db != NULL)
-            dbc->db->close(dbc->db);
-        retval = open_db(context, dbc,
-                         kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
-                         0600, &dbc->db);
-        if (retval) {
-            dbc->db_locks_held = 0;
-            dbc->db_lock_mode = 0;
-            (void) osa_adb_release_lock(dbc->policy_db);
-            (void) krb5_lock_file(context, dbc->db_lf_file,
-                                  KRB5_LOCKMODE_UNLOCK);
-            return retval;
+        /*
+         * Open the DB (or re-open it for read/write).  A read-only handle left
+         * open by ctx_unlock() can be used again if no change or promotion
+         * has advanced the lock file age since it was opened, and if we are
+         * not a child process sharing its file offset with our parent.
+         */
+        if (kmode != KRB5_LOCKMODE_SHARED || dbc->db == NULL ||
+            dbc->db_pid != getpid() || dbc->db_age == -1 ||
+            ctx_age(dbc) != dbc->db_age) {
+            if (dbc->db != NULL)
+                dbc->db->close(dbc->db);
+            retval = open_db(context, dbc,
+                             kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
+                             0600, &dbc->db);
+            if (retval) {
+                dbc->db_locks_held = 0;
+                dbc->db_lock_mode = 0;
+                (void) osa_adb_release_lock(dbc->policy_db);
+                (void) krb5_lock_file(context, dbc->db_lf_file,
+                                      KRB5_LOCKMODE_UNLOCK);
+                return retval;
+            }
+            dbc->db_age = ctx_age(dbc);
+            dbc->db_pid = getpid();
         }
 
         dbc->db_lock_mode = kmode;
@@ -522,6 +549,8 @@ cleanup:
 static void
 ctx_fini(krb5_db2_context *dbc)
 {
+    if (dbc->db != NULL)
+        dbc->db->close(dbc->db);
     if (dbc->db_lf_file != -1)
         (void) close(dbc->db_lf_file);
     if (dbc->policy_db)
@@ -565,17 +594,9 @@ check_openable(krb5_context context)
 krb5_error_code
 krb5_db2_get_age(krb5_context context, char *db_name, time_t *age)
 {
-    krb5_db2_context *dbc;
-    struct stat st;
-
     if (!inited(context))
         return (KRB5_KDB_DBNOTINITED);
-    dbc = context->dal_handle->db_context;
-
-    if (fstat(dbc->db_lf_file, &st) < 0)
-        *age = -1;
-    else
-        *age = st.st_mtime;
+    *age = ctx_age(context->dal_handle->db_context);
     return 0;
 }
 
@@ -940,6 +961,11 @@ typedef struct iter_curs {
     krb5_db2_context *dbc;
     int lockmode;
     krb5_boolean islocked;
+    const char *prefix;
+    size_t prefixlen;
+    const char *start;
+    krb5_boolean seek;
+    krb5_boolean namesonly;
 } iter_curs;
 
 /* Lock DB handle of curs, updating curs->islocked. */
@@ -966,7 +992,7 @@ curs_unlock(iter_curs *curs)
 /* Set up curs and lock DB. */
 static krb5_error_code
 curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
-          krb5_flags iterflags)
+          const char *match_expr, const char *start, krb5_flags iterflags)
 {
     int isrecurse = iterflags & KRB5_DB_ITER_RECURSE;
     unsigned int prevflag = R_PREV;
@@ -977,6 +1003,15 @@ curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
     curs->islocked = FALSE;
     curs->ctx = ctx;
     curs->dbc = dbc;
+    curs->prefix = match_expr;
+    curs->prefixlen = krb5_db_glob_prefix_len(match_expr);
+    curs->start = start;
+    curs->namesonly = (iterflags & KRB5_DB_ITER_NAMES_ONLY) != 0;
+
+    /* A btree can seek to the first key at or after the literal prefix of
+     * match_expr (or start) when iterating forwards in key order. */
+    curs->seek = (curs->prefixlen > 0 || start != NULL) && !dbc->hashfirst &&
+        !isrecurse && !(iterflags & KRB5_DB_ITER_REV);
 
     if (iterflags & KRB5_DB_ITER_WRITE)
         curs->lockmode = KRB5_LOCKMODE_EXCLUSIVE;
@@ -1014,9 +1049,41 @@ curs_start(iter_curs *curs)
 {
     DB *db = curs->dbc->db;
 
+    if (curs->seek) {
+        /* Seek to start if it sorts at or after the prefix. */
+        if (curs->start != NULL &&
+            (curs->prefixlen == 0 ||
+             strncmp(curs->start, curs->prefix, curs->prefixlen) >= 0)) {
+            curs->key.data = (char *)curs->start;
+            curs->key.size = strlen(curs->start);
+        } else {
+            curs->key.data = (char *)curs->prefix;
+            curs->key.size = curs->prefixlen;
+        }
+        return db->seq(db, &curs->key, &curs->data, R_CURSOR);
+    }
     return db->seq(db, &curs->key, &curs->data, curs->startflag);
 }
 
+/* Return true if the current key begins with the iteration prefix. */
+static krb5_boolean
+curs_in_range(iter_curs *curs)
+{
+    if (curs->prefixlen == 0)
+        return TRUE;
+    return curs->key.size >= curs->prefixlen &&
+        memcmp(curs->key.data, curs->prefix, curs->prefixlen) == 0;
+}
+
+/* Return true if the current key is the start key.  Keys include a trailing
+ * null. */
+static krb5_boolean
+curs_at_start(iter_curs *curs)
+{
+    return curs->start != NULL && curs->key.size == strlen(curs->start) + 1 &&
+        memcmp(curs->key.data, curs->start, curs->key.size) == 0;
+}
+
 /* Save iteration state so DB can be unlocked/closed. */
 static krb5_error_code
 curs_save(iter_curs *curs)
@@ -1050,7 +1117,7 @@ curs_step(iter_curs *curs)
     int dbret;
     krb5_db2_context *dbc = curs->dbc;
 
-    if (dbc->unlockiter) {
+    if (dbc->unlockiter && curs->keycopy.data != NULL) {
         /* Reacquire libdb cursor using saved copy of key. */
         curs->key = curs->keycopy;
         dbret = dbc->db->seq(dbc->db, &curs->key, &curs->data, R_CURSOR);
@@ -1071,11 +1138,28 @@ curs_run_cb(iter_curs *curs, ctx_iterate_cb func, krb5_pointer func_arg)
     krb5_db_entry *entry;
     krb5_context ctx = curs->ctx;
     krb5_data contdata;
+    char *name;
 
-    contdata = make_data(curs->data.data, curs->data.size);
-    retval = krb5_decode_princ_entry(ctx, &contdata, &entry);
-    if (retval)
+    if (curs->namesonly) {
+        /* The key is the unparsed principal name. */
+        entry = k5alloc(sizeof(*entry), &retval);
+        if (entry == NULL)
+            return retval;
+        name = k5memdup0(curs->key.data, curs->key.size, &retval);
+        if (name != NULL) {
+            retval = krb5_parse_name(ctx, name, &entry->princ);
+            free(name);
+        }
+    } else {
+        contdata = make_data(curs->data.data, curs->data.size);
+        retval = krb5_decode_princ_entry(ctx, &contdata, &entry);
+        if (retval)
+            return retval;
+    }
+    if (retval) {
+        krb5_db_free_principal(ctx, entry);
         return retval;
+    }
     /* Save libdb key across possible DB closure. */
     retval = curs_save(curs);
     if (retval)
@@ -1106,21 +1190,27 @@ curs_fini(iter_curs *curs)
 }
 
 static krb5_error_code
-ctx_iterate(krb5_context context, krb5_db2_context *dbc,
-            ctx_iterate_cb func, krb5_pointer func_arg, krb5_flags iterflags)
+ctx_iterate(krb5_context context, krb5_db2_context *dbc, const char *match_expr,
+            const char *start, ctx_iterate_cb func, krb5_pointer func_arg,
+            krb5_flags iterflags)
 {
     krb5_error_code retval;
     int dbret;
     iter_curs curs;
 
-    retval = curs_init(&curs, context, dbc, iterflags);
+    retval = curs_init(&curs, context, dbc, match_expr, start, iterflags);
     if (retval)
         return retval;
     dbret = curs_start(&curs);
     while (dbret == 0) {
-        retval = curs_run_cb(&curs, func, func_arg);
-        if (retval)
-            goto cleanup;
+        if (!curs_in_range(&curs)) {
+            if (curs.seek)
+                break;
+        } else if (!curs_at_start(&curs)) {
+            retval = curs_run_cb(&curs, func, func_arg);
+            if (retval)
+                goto cleanup;
+        }
         dbret = curs_step(&curs);
     }
     switch (dbret) {
@@ -1142,8 +1232,25 @@ krb5_db2_iterate(krb5_context context, char *match_expr, ctx_iterate_cb func,
 {
     if (!inited(context))
         return KRB5_KDB_DBNOTINITED;
-    return ctx_iterate(context, context->dal_handle->db_context, func,
-                       func_arg, iterflags);
+    return ctx_iterate(context, context->dal_handle->db_context, match_expr,
+                       NULL, func, func_arg, iterflags);
+}
+
+krb5_error_code
+krb5_db2_iterate_after(krb5_context context, char *match_expr,
+                       const char *start, ctx_iterate_cb func,
+                       krb5_pointer func_arg, krb5_flags iterflags)
+{
+    krb5_db2_context *dbc = context->dal_handle->db_context;
+
+    if (!inited(context))
+        return KRB5_KDB_DBNOTINITED;
+    /* Only a btree iterates in key order. */
+    if (dbc->hashfirst)
+        return KRB5_PLUGIN_OP_NOTSUPP;
+    iterflags &= ~(KRB5_DB_ITER_REV | KRB5_DB_ITER_RECURSE);
+    return ctx_iterate(context, dbc, match_expr, start, func, func_arg,
+                       iterflags);
 }
 
 krb5_boolean
@@ -1408,7 +1515,8 @@ ctx_merge_nra(krb5_context context, krb5_db2_context *dbc_temp,
 
     nra.kcontext = context;
     nra.db_context = dbc_real;
-    return ctx_iterate(context, dbc_temp, krb5_db2_merge_nra_iterator, &nra, 0);
+    return ctx_iterate(context, dbc_temp, NULL, NULL,
+                       krb5_db2_merge_nra_iterator, &nra, 0);
 }
 
 /*
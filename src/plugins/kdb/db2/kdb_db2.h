@@ -42,6 +42,8 @@ typedef struct _krb5_db2_context {
     int                 db_lf_file;     /* File descriptor of lock file */
     int                 db_locks_held;  /* Number of times locked       */
     int                 db_lock_mode;   /* Last lock mode, e.g. greatest*/
+    time_t              db_age;         /* Lock file age when db opened */
+    pid_t               db_pid;         /* Process which opened db      */
     krb5_boolean        db_nb_locks;    /* [Non]Blocking lock modes     */
     osa_adb_policy_t    policy_db;
     krb5_boolean        tempdb;
@@ -61,6 +63,10 @@ krb5_error_code krb5_db2_iterate(krb5_context, char *,
                                  krb5_error_code (*)(krb5_pointer,
                                                      krb5_db_entry *),
                                  krb5_pointer, krb5_flags);
+krb5_error_code krb5_db2_iterate_after(krb5_context, char *, const char *,
+                                       krb5_error_code (*)(krb5_pointer,
+                                                           krb5_db_entry *),
+                                       krb5_pointer, krb5_flags);
 krb5_error_code krb5_db2_set_nonblocking(krb5_context, krb5_boolean,
                                          krb5_boolean *);
 krb5_boolean krb5_db2_set_lockmode(krb5_context, krb5_boolean);
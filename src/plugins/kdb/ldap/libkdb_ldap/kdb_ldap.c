@@ -36,6 +36,7 @@
 #include <ctype.h>
 #include "kdb_ldap.h"
 #include "ldap_misc.h"
+#include "ldap_sync.h"
 #include <kdb5.h>
 #include <kadm5/admin.h>
 
@@ -224,6 +225,12 @@ krb5_ldap_open(krb5_context context, char *conf_section, char **db_args,
         goto clean_n_exit;
     }
 
+    if (ldap_context->replica_cache) {
+        status = krb5_ldap_sync_init(ldap_context);
+        if (status)
+            goto clean_n_exit;
+    }
+
     if ((status=krb5_ldap_read_startup_information(context)) != 0) {
         goto clean_n_exit;
     }
@@ -60,6 +60,7 @@
 extern struct timeval timelimit;
 
 #define  DEFAULT_CONNS_PER_SERVER    5
+#define  MAX_PENDING_WRITES          32
 #define  REALM_READ_REFRESH_INTERVAL (5 * 60)
 
 #if !defined(LDAP_OPT_RESULT_CODE) && defined(LDAP_OPT_ERROR_NUMBER)
@@ -150,6 +151,7 @@ extern int set_ldap_error (krb5_context ctx, int st, int op);
 #define KDB_TL_MASK               0x05
 /* 0x06 was KDB_TL_CONTAINERDN but is no longer used */
 #define KDB_TL_LINKDN             0x07
+#define KDB_TL_AUXCLASS           0x08 /* entry has krbPrincipalAux class */
 
 
 #define CHECK_LDAP_HANDLE(lcontext)     if (!(ldap_context              \
@@ -171,6 +173,7 @@ typedef struct _krb5_ldap_server_info krb5_ldap_server_info;
 typedef struct  _krb5_ldap_server_handle {
     int                              msgid;
     LDAP                             *ldap_handle;
+    int                              pending_writes;
     krb5_ldap_server_info            *server_info;
     struct _krb5_ldap_server_handle  *next;
 } krb5_ldap_server_handle;
@@ -191,6 +194,8 @@ struct _krb5_ldap_server_info {
 
 typedef enum {SERVICE_DN_TYPE_SERVER, SERVICE_DN_TYPE_CLIENT} krb5_ldap_servicetype;
 
+struct ldap_sync_cache;
+
 typedef struct _krb5_ldap_context {
     krb5_ldap_servicetype         service_type;
     krb5_ldap_server_info         **server_info_list;
@@ -210,6 +215,9 @@ typedef struct _krb5_ldap_context {
     krb5_ldap_realm_params        *lrparams;
     krb5_boolean                  disable_last_success;
     krb5_boolean                  disable_lockout;
+    krb5_boolean                  kdc;        /* opened by the KDC */
+    krb5_boolean                  replica_cache;
+    struct ldap_sync_cache        *sync_cache;
     int                           ldap_debug;
     krb5_context                  kcontext;   /* to set the error code and message */
 } krb5_ldap_context;
@@ -236,6 +244,12 @@ krb5_ldap_db_single_init(krb5_ldap_context *);
 krb5_error_code
 krb5_ldap_rebind(krb5_ldap_context *, krb5_ldap_server_handle **);
 
+krb5_error_code
+krb5_ldap_open_private_handle(krb5_ldap_context *, krb5_ldap_server_handle **);
+
+void
+krb5_ldap_close_private_handle(krb5_ldap_server_handle *);
+
 krb5_error_code
 krb5_ldap_get_age(krb5_context, char *, time_t *);
 
@@ -164,13 +164,18 @@ authenticate(krb5_ldap_context *ctx, krb5_ldap_server_handle *server)
     return 0;
 }
 
+/* Create an authenticated connection to the server described by info. */
 static krb5_error_code
-initialize_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
+open_server_handle(krb5_ldap_context *ldap_context,
+                   krb5_ldap_server_info *info,
+                   krb5_ldap_server_handle **server_out)
 {
     krb5_ldap_server_handle *server;
     krb5_error_code ret;
     int st;
 
+    *server_out = NULL;
+
     server = calloc(1, sizeof(krb5_ldap_server_handle));
     if (server == NULL)
         return ENOMEM;
@@ -193,6 +198,20 @@ initialize_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
         return ret;
     }
 
+    *server_out = server;
+    return 0;
+}
+
+static krb5_error_code
+initialize_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
+{
+    krb5_ldap_server_handle *server;
+    krb5_error_code ret;
+
+    ret = open_server_handle(ldap_context, info, &server);
+    if (ret)
+        return ret;
+
     server->next = info->ldap_server_handles;
     info->ldap_server_handles = server;
     info->num_conns++;
@@ -300,6 +319,8 @@ krb5_ldap_rebind(krb5_ldap_context *ldap_context,
 {
     krb5_ldap_server_handle *handle = *ldap_server_handle;
 
+    /* Any writes still outstanding on the old connection are lost. */
+    handle->pending_writes = 0;
     ldap_unbind_ext_s(handle->ldap_handle, NULL, NULL);
     if (ldap_initialize(&handle->ldap_handle,
                         handle->server_info->server_name) != LDAP_SUCCESS ||
@@ -313,6 +334,41 @@ krb5_ldap_rebind(krb5_ldap_context *ldap_context,
 /*
  *     DAL API functions
  */
+/*
+ * Open a connection which is not part of the handle pool, for use by a
+ * long-running operation such as a persistent search.  Try the servers in
+ * order, skipping any which are known to be down.
+ */
+krb5_error_code
+krb5_ldap_open_private_handle(krb5_ldap_context *ldap_context,
+                              krb5_ldap_server_handle **handle_out)
+{
+    krb5_error_code ret = KRB5_KDB_ACCESS_ERROR;
+    krb5_ldap_server_info *info;
+    int i;
+
+    *handle_out = NULL;
+    for (i = 0; ldap_context->server_info_list[i] != NULL; i++) {
+        info = ldap_context->server_info_list[i];
+        if (info->server_status == OFF)
+            continue;
+        ret = open_server_handle(ldap_context, info, handle_out);
+        if (!ret)
+            break;
+    }
+    return ret;
+}
+
+/* Close a connection opened with krb5_ldap_open_private_handle(). */
+void
+krb5_ldap_close_private_handle(krb5_ldap_server_handle *handle)
+{
+    if (handle == NULL)
+        return;
+    ldap_unbind_ext_s(handle->ldap_handle, NULL, NULL);
+    free(handle);
+}
+
 krb5_error_code
 krb5_ldap_lib_init(void)
 {
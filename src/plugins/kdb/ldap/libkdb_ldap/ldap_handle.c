@@ -167,9 +167,63 @@ krb5_ldap_put_handle_to_pool(krb5_ldap_context *ldap_context,
                              krb5_ldap_server_handle *ldap_server_handle)
 {
     if (ldap_server_handle != NULL) {
+        krb5_ldap_reap_writes(ldap_server_handle, FALSE);
         HNDL_LOCK(ldap_context);
         krb5_put_ldap_handle(ldap_server_handle);
         HNDL_UNLOCK(ldap_context);
     }
     return;
 }
+
+/*
+ * Collect and discard the results of asynchronous writes sent on
+ * ldap_server_handle.  If wait is true, block until every write has completed
+ * (or the time limit expires); otherwise only collect results which have
+ * already arrived.  The caller must not have other operations outstanding on
+ * the handle.
+ */
+void
+krb5_ldap_reap_writes(krb5_ldap_server_handle *ldap_server_handle,
+                      krb5_boolean wait)
+{
+    struct timeval zero = { 0, 0 };
+    LDAPMessage *result;
+    int st;
+
+    while (ldap_server_handle->pending_writes > 0) {
+        result = NULL;
+        st = ldap_result(ldap_server_handle->ldap_handle, LDAP_RES_ANY,
+                         LDAP_MSG_ALL, wait ? &timelimit : &zero, &result);
+        ldap_msgfree(result);
+        if (st == 0 && !wait)
+            break;
+        if (st <= 0) {
+            /* The connection failed or timed out; forget the writes. */
+            ldap_server_handle->pending_writes = 0;
+            break;
+        }
+        ldap_server_handle->pending_writes--;
+    }
+}
+
+/*
+ * Send a modify operation for dn on ldap_server_handle without waiting for
+ * the result, which is collected when the handle is returned to the pool.  If
+ * MAX_PENDING_WRITES writes are already outstanding on the handle, wait for
+ * them first.  Return an LDAP result code.
+ */
+int
+krb5_ldap_modify_async(krb5_ldap_server_handle *ldap_server_handle, char *dn,
+                       LDAPMod **mods)
+{
+    int st, msgid;
+
+    if (ldap_server_handle->pending_writes >= MAX_PENDING_WRITES)
+        krb5_ldap_reap_writes(ldap_server_handle, TRUE);
+
+    st = ldap_modify_ext(ldap_server_handle->ldap_handle, dn, mods, NULL,
+                         NULL, &msgid);
+    if (st == LDAP_SUCCESS)
+        ldap_server_handle->pending_writes++;
+    return st;
+}
@@ -40,4 +40,10 @@ krb5_ldap_request_next_handle_from_pool(krb5_ldap_context *, krb5_ldap_server_ha
 void
 krb5_ldap_put_handle_to_pool(krb5_ldap_context *, krb5_ldap_server_handle *);
 
+int
+krb5_ldap_modify_async(krb5_ldap_server_handle *, char *, LDAPMod **);
+
+void
+krb5_ldap_reap_writes(krb5_ldap_server_handle *, krb5_boolean);
+
 #endif
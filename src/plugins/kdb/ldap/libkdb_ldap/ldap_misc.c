@@ -38,6 +38,7 @@
 #include "ldap_principal.h"
 #include "princ_xdr.h"
 #include "ldap_pwd_policy.h"
+#include "ldap_sync.h"
 #include <time.h>
 #include <ctype.h>
 #include <kadm5/admin.h>
@@ -431,6 +432,17 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     if (ret)
         return ret;
 
+    /* Only the KDC serves lookups from the replica cache, as kadmind must
+     * see its own writes immediately. */
+    ldap_context->kdc = (srv_type == KRB5_KDB_SRV_TYPE_KDC);
+    if (ldap_context->kdc) {
+        ret = prof_get_boolean_def(context, conf_section,
+                                   KRB5_CONF_LDAP_REPLICA_CACHE, FALSE,
+                                   &ldap_context->replica_cache);
+        if (ret)
+            return ret;
+    }
+
     return prof_get_boolean_def(context, conf_section,
                                 KRB5_CONF_DISABLE_LOCKOUT, FALSE,
                                 &ldap_context->disable_lockout);
@@ -446,11 +458,14 @@ krb5_ldap_free_server_context_params(krb5_ldap_context *ctx)
     if (ctx == NULL)
         return;
 
+    krb5_ldap_sync_free(ctx);
+
     list = ctx->server_info_list;
     for (i = 0; list != NULL && list[i] != NULL; i++) {
         free(list[i]->server_name);
         for (h = list[i]->ldap_server_handles; h != NULL; h = next) {
             next = h->next;
+            krb5_ldap_reap_writes(h, TRUE);
             ldap_unbind_ext_s(h->ldap_handle, NULL, NULL);
             free(h);
         }
@@ -603,6 +618,7 @@ store_tl_data(krb5_tl_data *tl, int type, void *value)
     case KDB_TL_PRINCCOUNT:
     case KDB_TL_PRINCTYPE:
     case KDB_TL_MASK:
+    case KDB_TL_AUXCLASS:
         ival = *(int *)value;
         if (ival > UINT16_MAX)
             return EINVAL;
@@ -668,6 +684,7 @@ decode_tl_data(krb5_tl_data *tl, int type, void **data_out)
         case KDB_TL_PRINCCOUNT:
         case KDB_TL_PRINCTYPE:
         case KDB_TL_MASK:
+        case KDB_TL_AUXCLASS:
             if (len != 2)
                 return EINVAL;
             intptr = malloc(sizeof(int));
@@ -760,6 +777,14 @@ krb5_get_princ_count(krb5_context context, krb5_db_entry *entry, int *pcount)
     return get_int_from_tl_data(context, entry, KDB_TL_PRINCCOUNT, pcount);
 }
 
+/* Set *aux to true if entry's directory object has the krbPrincipalAux object
+ * class. */
+krb5_error_code
+krb5_get_princ_auxclass(krb5_context context, krb5_db_entry *entry, int *aux)
+{
+    return get_int_from_tl_data(context, entry, KDB_TL_AUXCLASS, aux);
+}
+
 krb5_error_code
 krb5_get_linkdn(krb5_context context, krb5_db_entry *entry, char ***link_dn)
 {
@@ -850,6 +875,93 @@ krb5_get_userdn(krb5_context context, krb5_db_entry *entry, char **userdn)
     return get_str_from_tl_data(context, entry, KDB_TL_USERDN, userdn);
 }
 
+/* Send a search of each base in bases[0..nbases-1] on ld before reading any
+ * of the results, then read the results into results[0..nbases-1] in order.
+ * Return an LDAP result code. */
+static int
+search_bases(LDAP *ld, char **bases, unsigned int nbases, int scope,
+             char *filter, char **attrs, LDAPMessage **results)
+{
+    int st = LDAP_SUCCESS, ret, *msgids;
+    unsigned int i, nsent = 0;
+
+    if (nbases == 0)
+        return LDAP_SUCCESS;
+    for (i = 0; i < nbases; i++)
+        results[i] = NULL;
+    msgids = calloc(nbases, sizeof(*msgids));
+    if (msgids == NULL)
+        return LDAP_NO_MEMORY;
+
+    for (nsent = 0; nsent < nbases; nsent++) {
+        st = ldap_search_ext(ld, bases[nsent], scope, filter, attrs, 0, NULL,
+                             NULL, &timelimit, LDAP_NO_LIMIT, &msgids[nsent]);
+        if (st != LDAP_SUCCESS)
+            goto cleanup;
+    }
+
+    for (i = 0; i < nbases; i++) {
+        ret = ldap_result(ld, msgids[i], LDAP_MSG_ALL, &timelimit,
+                          &results[i]);
+        if (ret <= 0) {
+            st = LDAP_TIMEOUT;
+            if (ret < 0)
+                ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &st);
+            goto cleanup;
+        }
+        ret = ldap_parse_result(ld, results[i], &st, NULL, NULL, NULL, NULL,
+                                0);
+        if (ret != LDAP_SUCCESS)
+            st = ret;
+        if (st != LDAP_SUCCESS)
+            goto cleanup;
+    }
+
+cleanup:
+    if (st != LDAP_SUCCESS) {
+        for (i = 0; i < nsent; i++) {
+            if (results[i] == NULL)
+                ldap_abandon_ext(ld, msgids[i], NULL, NULL);
+            ldap_msgfree(results[i]);
+            results[i] = NULL;
+        }
+    }
+    free(msgids);
+    return st;
+}
+
+/*
+ * Search each of bases[0..nbases-1] with the given scope, filter, and
+ * attributes, placing the result chains in results[0..nbases-1].  All of the
+ * searches are sent before any results are read, so a lookup across several
+ * subtrees costs one round trip to the directory server rather than one per
+ * subtree.  If the server is unavailable, rebind (possibly changing
+ * *ldap_server_handle) and try once more.
+ */
+krb5_error_code
+krb5_ldap_search_bases(krb5_context context, krb5_ldap_context *ldap_context,
+                       krb5_ldap_server_handle **ldap_server_handle,
+                       char **bases, unsigned int nbases, int scope,
+                       char *filter, char **attrs, LDAPMessage **results)
+{
+    int st;
+
+    st = search_bases((*ldap_server_handle)->ldap_handle, bases, nbases,
+                      scope, filter, attrs, results);
+    if (translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+        if (krb5_ldap_rebind(ldap_context, ldap_server_handle) != 0) {
+            k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                       "LDAP handle unavailable");
+            return KRB5_KDB_ACCESS_ERROR;
+        }
+        st = search_bases((*ldap_server_handle)->ldap_handle, bases, nbases,
+                          scope, filter, attrs, results);
+    }
+    if (st != LDAP_SUCCESS)
+        return set_ldap_error(context, st, OP_SEARCH);
+    return 0;
+}
+
 /*
  * If attribute or attrvalues is NULL, just check for the existence of dn.
  * Otherwise, read values for attribute from dn; then set the bit 1<<n in mask
@@ -1463,7 +1575,12 @@ populate_krb5_db_entry(krb5_context context, krb5_ldap_context *ldap_context,
                                         &objtype);
                     if (ret)
                         goto cleanup;
-                    break;
+                } else if (strcasecmp(ocvalues[i], "krbprincipalaux") == 0) {
+                    val = 1;
+                    ret = store_tl_data(&userinfo_tl_data, KDB_TL_AUXCLASS,
+                                        &val);
+                    if (ret)
+                        goto cleanup;
                 }
             }
         }
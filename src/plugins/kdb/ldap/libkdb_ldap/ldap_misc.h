@@ -44,6 +44,11 @@ is_principal_in_realm(krb5_ldap_context *, krb5_const_principal);
 krb5_error_code
 checkattributevalue(LDAP *, char *, char *, char **, int *);
 
+krb5_error_code
+krb5_ldap_search_bases(krb5_context, krb5_ldap_context *,
+                       krb5_ldap_server_handle **, char **, unsigned int, int,
+                       char *, char **, LDAPMessage **);
+
 krb5_error_code
 krb5_get_attributes_mask(krb5_context, krb5_db_entry *, int *);
 
@@ -53,6 +58,9 @@ krb5_get_princ_type(krb5_context, krb5_db_entry *, int *);
 krb5_error_code
 krb5_get_princ_count(krb5_context, krb5_db_entry *, int *);
 
+krb5_error_code
+krb5_get_princ_auxclass(krb5_context, krb5_db_entry *, int *);
+
 krb5_error_code
 krb5_get_linkdn(krb5_context, krb5_db_entry *, char ***);
 
@@ -64,6 +64,57 @@ char     *principal_attributes[] = { "krbprincipalname",
                                      "krbPwdHistory",
                                      NULL };
 
+/*
+ * The attributes needed by the KDC to look up a client principal.  Password
+ * history and the last password change time are only used by administrative
+ * operations, and krbUpEnabled is never decoded.
+ */
+char *principal_kdc_client_attributes[] = { "krbprincipalname",
+                                            "krbcanonicalname",
+                                            "objectclass",
+                                            "krbprincipalkey",
+                                            "krbmaxrenewableage",
+                                            "krbmaxticketlife",
+                                            "krbticketflags",
+                                            "krbprincipalexpiration",
+                                            "krbticketpolicyreference",
+                                            "krbpwdpolicyreference",
+                                            "krbpasswordexpiration",
+                                            "krbLastFailedAuth",
+                                            "krbLoginFailedCount",
+                                            "krbLastSuccessfulAuth",
+                                            "nsAccountLock",
+                                            "krbLastAdminUnlock",
+                                            "krbPrincipalAuthInd",
+                                            "krbExtraData",
+                                            "krbObjectReferences",
+                                            "krbAllowedToDelegateTo",
+                                            NULL };
+
+/* The attributes needed by the KDC to look up a server principal, which
+ * additionally omit the lockout state and password policy. */
+char *principal_kdc_server_attributes[] = { "krbprincipalname",
+                                            "krbcanonicalname",
+                                            "objectclass",
+                                            "krbprincipalkey",
+                                            "krbmaxrenewableage",
+                                            "krbmaxticketlife",
+                                            "krbticketflags",
+                                            "krbprincipalexpiration",
+                                            "krbticketpolicyreference",
+                                            "krbpasswordexpiration",
+                                            "nsAccountLock",
+                                            "krbPrincipalAuthInd",
+                                            "krbExtraData",
+                                            "krbObjectReferences",
+                                            "krbAllowedToDelegateTo",
+                                            NULL };
+
+/* The attributes needed for a names-only iteration. */
+static char *principal_name_attributes[] = { "krbprincipalname",
+                                             "krbcanonicalname",
+                                             NULL };
+
 /* Must match KDB_*_ATTR macros in ldap_principal.h.  */
 static char *attributes_set[] = { "krbmaxticketlife",
                                   "krbmaxrenewableage",
@@ -145,6 +196,8 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     krb5_ldap_context        *ldap_context=NULL;
     krb5_ldap_server_handle  *ldap_server_handle=NULL;
     char                     *default_match_expr = "*";
+    char                     **attrs;
+    krb5_boolean             names_only;
 
     /* Clear the global error string */
     krb5_clear_error_message(context);
@@ -168,6 +221,9 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     if (match_expr == NULL)
         match_expr = default_match_expr;
 
+    names_only = (iterflags & KRB5_DB_ITER_NAMES_ONLY) != 0;
+    attrs = names_only ? principal_name_attributes : principal_attributes;
+
     if (asprintf(&filter, FILTER"%s))", match_expr) < 0)
         filter = NULL;
     CHECK_NULL(filter);
@@ -179,7 +235,7 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
 
     for (tree=0; tree < ntree; ++tree) {
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
+        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, attrs);
         for (ent=ldap_first_entry(ld, result); ent != NULL; ent=ldap_next_entry(ld, ent)) {
             values=ldap_get_values(ld, ent, "krbcanonicalname");
             if (values == NULL)
@@ -194,6 +250,13 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
                         continue;
 
                     if (is_principal_in_realm(ldap_context, principal)) {
+                        if (names_only) {
+                            entry.princ = principal;
+                            (*func)(func_arg, &entry);
+                            entry.princ = NULL;
+                            krb5_free_principal(context, principal);
+                            break;
+                        }
                         st = populate_krb5_db_entry(context, ldap_context, ld,
                                                     ent, principal, &entry);
                         krb5_free_principal(context, principal);
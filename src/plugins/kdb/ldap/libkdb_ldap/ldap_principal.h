@@ -98,10 +98,18 @@ extern char *policyclass[];
 krb5_error_code
 krb5_ldap_put_principal(krb5_context, krb5_db_entry *, char **);
 
+krb5_error_code
+krb5_ldap_put_lockout(krb5_context, krb5_db_entry *);
+
 krb5_error_code
 krb5_ldap_get_principal(krb5_context , krb5_const_principal ,
                         unsigned int, krb5_db_entry **);
 
+krb5_error_code
+krb5_ldap_principal_from_entry(krb5_context, krb5_ldap_context *, LDAP *,
+                               LDAPMessage *, const char *,
+                               krb5_const_principal, krb5_db_entry **);
+
 krb5_error_code
 krb5_ldap_delete_principal(krb5_context, krb5_const_principal);
 
@@ -68,10 +68,13 @@
 #include "ldap_tkt_policy.h"
 #include "ldap_pwd_policy.h"
 #include "ldap_err.h"
+#include "ldap_sync.h"
 #include <kadm5/admin.h>
 #include <time.h>
 
 extern char* principal_attributes[];
+extern char* principal_kdc_client_attributes[];
+extern char* principal_kdc_server_attributes[];
 extern char* max_pwd_life_attr[];
 
 static char *
@@ -98,6 +101,84 @@ berval2tl_data(struct berval *in, krb5_tl_data **out)
     return 0;
 }
 
+/*
+ * If ent is the directory entry for the principal name user, set *entry_out
+ * to the corresponding DB entry, using the canonical name if user is an
+ * alias.  Otherwise set *entry_out to NULL.
+ */
+krb5_error_code
+krb5_ldap_principal_from_entry(krb5_context context,
+                               krb5_ldap_context *ldap_context, LDAP *ld,
+                               LDAPMessage *ent, const char *user,
+                               krb5_const_principal searchfor,
+                               krb5_db_entry **entry_out)
+{
+    krb5_error_code st = 0;
+    char **values = NULL, *cname = NULL;
+    krb5_principal cprinc = NULL;
+    krb5_boolean found = FALSE;
+    krb5_db_entry *entry = NULL;
+    int i;
+
+    *entry_out = NULL;
+
+    /* A wildcard in a principal name can match other principals (k* matches
+     * all principals starting with k), so look for an exact match. */
+    values = ldap_get_values(ld, ent, "krbprincipalname");
+    if (values == NULL)
+        return 0;
+    for (i = 0; values[i] != NULL && !found; i++)
+        found = (strcmp(values[i], user) == 0);
+    ldap_value_free(values);
+    values = NULL;
+    if (!found)
+        return 0;
+
+    values = ldap_get_values(ld, ent, "krbcanonicalname");
+    if (values != NULL && values[0] != NULL && strcmp(values[0], user) != 0) {
+        /* We matched an alias, not the canonical name. */
+        st = krb5_ldap_parse_principal_name(values[0], &cname);
+        if (st != 0)
+            goto cleanup;
+        st = krb5_parse_name(context, cname, &cprinc);
+        if (st != 0)
+            goto cleanup;
+    }
+
+    entry = k5alloc(sizeof(*entry), &st);
+    if (entry == NULL)
+        goto cleanup;
+    st = populate_krb5_db_entry(context, ldap_context, ld, ent,
+                                cprinc ? cprinc : searchfor, entry);
+    if (st != 0)
+        goto cleanup;
+    *entry_out = entry;
+    entry = NULL;
+
+cleanup:
+    if (values != NULL)
+        ldap_value_free(values);
+    krb5_db_free_principal(context, entry);
+    free(cname);
+    krb5_free_principal(context, cprinc);
+    return st;
+}
+
+/*
+ * Choose the attributes to fetch for a principal lookup.  Administrative
+ * lookups fetch everything, since the entry may be written back.  The KDC
+ * only writes lockout state, and only for clients.
+ */
+static char **
+lookup_attributes(krb5_ldap_context *ldap_context, unsigned int flags)
+{
+    if (!ldap_context->kdc)
+        return principal_attributes;
+    if (flags & KRB5_KDB_FLAG_CLIENT)
+        return principal_kdc_client_attributes;
+    return principal_kdc_server_attributes;
+}
+
 /*
  * look up a principal in the directory.
  */
@@ -108,15 +189,13 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
 {
     char                        *user=NULL, *filter=NULL, *filtuser=NULL;
     unsigned int                tree=0, ntrees=1, princlen=0;
-    krb5_error_code             tempst=0, st=0;
-    char                        **values=NULL, **subtree=NULL, *cname=NULL;
+    krb5_error_code             st=0;
+    char                        **subtree=NULL;
     LDAP                        *ld=NULL;
-    LDAPMessage                 *result=NULL, *ent=NULL;
+    LDAPMessage                 **results=NULL, *ent=NULL;
     krb5_ldap_context           *ldap_context=NULL;
     kdb5_dal_handle             *dal_handle=NULL;
     krb5_ldap_server_handle     *ldap_server_handle=NULL;
-    krb5_principal              cprinc=NULL;
-    krb5_boolean                found=FALSE;
     krb5_db_entry               *entry = NULL;
 
     *entry_ptr = NULL;
@@ -144,6 +223,14 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st=krb5_ldap_unparse_principal_name(user)) != 0)
         goto cleanup;
 
+    /* Answer from the replica cache if it is enabled and up to date. */
+    if (ldap_context->replica_cache) {
+        st = krb5_ldap_sync_lookup(context, ldap_context, user, searchfor,
+                                   entry_ptr);
+        if (st != KRB5_PLUGIN_NO_HANDLE)
+            goto cleanup;
+    }
+
     filtuser = ldap_filter_correct(user);
     if (filtuser == NULL) {
         st = ENOMEM;
@@ -160,67 +247,42 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntrees)) != 0)
         goto cleanup;
 
-    GET_HANDLE();
-    for (tree=0; tree < ntrees && !found; ++tree) {
-
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
-        for (ent=ldap_first_entry(ld, result); ent != NULL && !found; ent=ldap_next_entry(ld, ent)) {
-
-            /* get the associated directory user information */
-            if ((values=ldap_get_values(ld, ent, "krbprincipalname")) != NULL) {
-                int i;
-
-                /* a wild-card in a principal name can return a list of kerberos principals.
-                 * Make sure that the correct principal is returned.
-                 * NOTE: a principalname k* in ldap server will return all the principals starting with a k
-                 */
-                for (i=0; values[i] != NULL; ++i) {
-                    if (strcmp(values[i], user) == 0) {
-                        found = TRUE;
-                        break;
-                    }
-                }
-                ldap_value_free(values);
-
-                if (!found) /* no matching principal found */
-                    continue;
-            }
-
-            if ((values=ldap_get_values(ld, ent, "krbcanonicalname")) != NULL) {
-                if (values[0] && strcmp(values[0], user) != 0) {
-                    /* We matched an alias, not the canonical name. */
-                    st = krb5_ldap_parse_principal_name(values[0], &cname);
-                    if (st != 0)
-                        goto cleanup;
-                    st = krb5_parse_name(context, cname, &cprinc);
-                    if (st != 0)
-                        goto cleanup;
-                }
-                ldap_value_free(values);
-                if (!found)
-                    continue;
-            }
+    results = k5calloc(ntrees, sizeof(*results), &st);
+    if (results == NULL)
+        goto cleanup;
 
-            entry = k5alloc(sizeof(*entry), &st);
-            if (entry == NULL)
-                goto cleanup;
-            if ((st = populate_krb5_db_entry(context, ldap_context, ld, ent,
-                                             cprinc ? cprinc : searchfor,
-                                             entry)) != 0)
+    /* Search all of the subtrees at once, and take the first match in
+     * subtree order. */
+    GET_HANDLE();
+    st = krb5_ldap_search_bases(context, ldap_context, &ldap_server_handle,
+                                subtree, ntrees,
+                                ldap_context->lrparams->search_scope, filter,
+                                lookup_attributes(ldap_context, flags),
+                                results);
+    if (st)
+        goto cleanup;
+    ld = ldap_server_handle->ldap_handle;
+    for (tree=0; tree < ntrees && entry == NULL; ++tree) {
+        for (ent=ldap_first_entry(ld, results[tree]); ent != NULL && entry == NULL; ent=ldap_next_entry(ld, ent)) {
+            st = krb5_ldap_principal_from_entry(context, ldap_context, ld, ent,
+                                                user, searchfor, &entry);
+            if (st)
                 goto cleanup;
         }
-        ldap_msgfree(result);
-        result = NULL;
     } /* for (tree=0 ... */
 
-    if (found) {
+    if (entry != NULL) {
         *entry_ptr = entry;
         entry = NULL;
     } else
         st = KRB5_KDB_NOENTRY;
 
 cleanup:
-    ldap_msgfree(result);
+    if (results != NULL) {
+        for (tree = 0; tree < ntrees; tree++)
+            ldap_msgfree(results[tree]);
+        free(results);
+    }
     krb5_db_free_principal(context, entry);
 
     if (filter)
@@ -242,12 +304,6 @@ cleanup:
     if (filtuser)
         free(filtuser);
 
-    if (cname)
-        free(cname);
-
-    if (cprinc)
-        krb5_free_principal(context, cprinc);
-
     return st;
 }
 
@@ -757,6 +813,85 @@ validate_xargs(krb5_context context,
     return 0;
 }
 
+/*
+ * Add modifications to *mods for the lockout-related fields of entry which
+ * are set in entry->mask: the last successful and failed authentication times
+ * and the failed authentication count.
+ */
+static krb5_error_code
+add_lockout_mods(krb5_context context, krb5_db_entry *entry,
+                 int modify_increment, LDAPMod ***mods)
+{
+    krb5_error_code st;
+    char *strval[2] = { NULL };
+    int attr_mask = 0;
+    krb5_boolean has_fail_count;
+    krb5_kvno fail_auth_count;
+
+    if (entry->mask & KADM5_LAST_SUCCESS) {
+        strval[0] = getstringtime(entry->last_success);
+        if (strval[0] == NULL)
+            return ENOMEM;
+        st = krb5_add_str_mem_ldap_mod(mods, "krbLastSuccessfulAuth",
+                                       LDAP_MOD_REPLACE, strval);
+        free(strval[0]);
+        if (st != 0)
+            return st;
+    }
+
+    if (entry->mask & KADM5_LAST_FAILED) {
+        strval[0] = getstringtime(entry->last_failed);
+        if (strval[0] == NULL)
+            return ENOMEM;
+        st = krb5_add_str_mem_ldap_mod(mods, "krbLastFailedAuth",
+                                       LDAP_MOD_REPLACE, strval);
+        free(strval[0]);
+        if (st != 0)
+            return st;
+    }
+
+    if (entry->mask & KADM5_FAIL_AUTH_COUNT) {
+        fail_auth_count = entry->fail_auth_count;
+        if (entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT)
+            fail_auth_count++;
+
+        return krb5_add_int_mem_ldap_mod(mods, "krbLoginFailedCount",
+                                         LDAP_MOD_REPLACE, fail_auth_count);
+    }
+
+    if (!(entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT))
+        return 0;
+
+    /* Check if the krbLoginFailedCount attribute exists.  (Through krb5
+     * 1.8.1, it wasn't set in new entries.) */
+    st = krb5_get_attributes_mask(context, entry, &attr_mask);
+    if (st != 0)
+        return st;
+    has_fail_count = ((attr_mask & KDB_FAIL_AUTH_COUNT_ATTR) != 0);
+
+    /*
+     * If the client library and server supports RFC 4525, then use it to
+     * increment by one the value of the krbLoginFailedCount attribute.
+     * Otherwise, assert the (provided) old value by deleting it before adding.
+     */
+#ifdef LDAP_MOD_INCREMENT
+    if (modify_increment && has_fail_count) {
+        return krb5_add_int_mem_ldap_mod(mods, "krbLoginFailedCount",
+                                         LDAP_MOD_INCREMENT, 1);
+    }
+#endif /* LDAP_MOD_INCREMENT */
+    if (has_fail_count) {
+        st = krb5_add_int_mem_ldap_mod(mods, "krbLoginFailedCount",
+                                       LDAP_MOD_DELETE,
+                                       entry->fail_auth_count);
+        if (st != 0)
+            return st;
+    }
+    return krb5_add_int_mem_ldap_mod(mods, "krbLoginFailedCount",
+                                     LDAP_MOD_ADD,
+                                     entry->fail_auth_count + 1);
+}
+
 krb5_error_code
 krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
                         char **db_args)
@@ -1024,87 +1159,20 @@ krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
         establish_links = TRUE;
     }
 
-    if (entry->mask & KADM5_LAST_SUCCESS) {
-        memset(strval, 0, sizeof(strval));
-        if ((strval[0]=getstringtime(entry->last_success)) == NULL)
-            goto cleanup;
-        if ((st=krb5_add_str_mem_ldap_mod(&mods, "krbLastSuccessfulAuth", LDAP_MOD_REPLACE, strval)) != 0) {
-            free (strval[0]);
-            goto cleanup;
-        }
-        free (strval[0]);
-    }
-
-    if (entry->mask & KADM5_LAST_FAILED) {
-        memset(strval, 0, sizeof(strval));
-        if ((strval[0]=getstringtime(entry->last_failed)) == NULL)
-            goto cleanup;
-        if ((st=krb5_add_str_mem_ldap_mod(&mods, "krbLastFailedAuth", LDAP_MOD_REPLACE, strval)) != 0) {
-            free (strval[0]);
-            goto cleanup;
-        }
-        free(strval[0]);
-    }
-
-    if (entry->mask & KADM5_FAIL_AUTH_COUNT) {
-        krb5_kvno fail_auth_count;
-
-        fail_auth_count = entry->fail_auth_count;
-        if (entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT)
-            fail_auth_count++;
-
-        st = krb5_add_int_mem_ldap_mod(&mods, "krbLoginFailedCount",
-                                       LDAP_MOD_REPLACE,
-                                       fail_auth_count);
-        if (st != 0)
-            goto cleanup;
-    } else if (entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT) {
-        int attr_mask = 0;
-        krb5_boolean has_fail_count;
-
-        /* Check if the krbLoginFailedCount attribute exists.  (Through
-         * krb5 1.8.1, it wasn't set in new entries.) */
-        st = krb5_get_attributes_mask(context, entry, &attr_mask);
-        if (st != 0)
-            goto cleanup;
-        has_fail_count = ((attr_mask & KDB_FAIL_AUTH_COUNT_ATTR) != 0);
-
-        /*
-         * If the client library and server supports RFC 4525,
-         * then use it to increment by one the value of the
-         * krbLoginFailedCount attribute. Otherwise, assert the
-         * (provided) old value by deleting it before adding.
-         */
-#ifdef LDAP_MOD_INCREMENT
-        if (ldap_server_handle->server_info->modify_increment &&
-            has_fail_count) {
-            st = krb5_add_int_mem_ldap_mod(&mods, "krbLoginFailedCount",
-                                           LDAP_MOD_INCREMENT, 1);
-            if (st != 0)
-                goto cleanup;
-        } else {
-#endif /* LDAP_MOD_INCREMENT */
-            if (has_fail_count) {
-                st = krb5_add_int_mem_ldap_mod(&mods,
-                                               "krbLoginFailedCount",
-                                               LDAP_MOD_DELETE,
-                                               entry->fail_auth_count);
-                if (st != 0)
-                    goto cleanup;
-            }
-            st = krb5_add_int_mem_ldap_mod(&mods, "krbLoginFailedCount",
-                                           LDAP_MOD_ADD,
-                                           entry->fail_auth_count + 1);
-            if (st != 0)
-                goto cleanup;
-#ifdef LDAP_MOD_INCREMENT
-        }
-#endif
-    } else if (optype == ADD_PRINCIPAL) {
+    st = add_lockout_mods(context, entry,
+                          ldap_server_handle->server_info->modify_increment,
+                          &mods);
+    if (st != 0)
+        goto cleanup;
+    if (optype == ADD_PRINCIPAL &&
+        !(entry->mask & (KADM5_FAIL_AUTH_COUNT |
+                         KADM5_FAIL_AUTH_COUNT_INCREMENT))) {
         /* Initialize krbLoginFailedCount in new entries to help avoid a
          * race during the first failed login. */
         st = krb5_add_int_mem_ldap_mod(&mods, "krbLoginFailedCount",
                                        LDAP_MOD_ADD, 0);
+        if (st != 0)
+            goto cleanup;
     }
 
     if (entry->mask & KADM5_MAX_LIFE) {
@@ -1730,6 +1798,73 @@ cleanup:
     return err;
 }
 
+/*
+ * Write the lockout-related fields of entry (see add_lockout_mods()) to its
+ * directory object without waiting for the result, so that the KDC does not
+ * spend a round trip on each authentication attempt.  Fall back to
+ * krb5_ldap_put_principal() if the object might need the krbPrincipalAux
+ * object class added first.
+ */
+krb5_error_code
+krb5_ldap_put_lockout(krb5_context context, krb5_db_entry *entry)
+{
+    krb5_error_code st, tempst;
+    kdb5_dal_handle *dal_handle;
+    krb5_ldap_context *ldap_context;
+    krb5_ldap_server_handle *ldap_server_handle = NULL;
+    LDAPMod **mods = NULL;
+    char *dn = NULL;
+    int aux = 0;
+
+    SETUP_CONTEXT();
+
+    st = krb5_get_userdn(context, entry, &dn);
+    if (st)
+        return st;
+    st = krb5_get_princ_auxclass(context, entry, &aux);
+    if (st)
+        goto cleanup;
+    if (dn == NULL || !aux) {
+        st = krb5_ldap_put_principal(context, entry, NULL);
+        goto cleanup;
+    }
+
+    st = krb5_ldap_request_handle_from_pool(ldap_context,
+                                            &ldap_server_handle);
+    if (st) {
+        k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                   "LDAP handle unavailable");
+        st = KRB5_KDB_ACCESS_ERROR;
+        goto cleanup;
+    }
+
+    st = add_lockout_mods(context, entry,
+                          ldap_server_handle->server_info->modify_increment,
+                          &mods);
+    if (st)
+        goto cleanup;
+
+    st = krb5_ldap_modify_async(ldap_server_handle, dn, mods);
+    if (translate_ldap_error(st, OP_MOD) == KRB5_KDB_ACCESS_ERROR) {
+        tempst = krb5_ldap_rebind(ldap_context, &ldap_server_handle);
+        if (tempst == 0)
+            st = krb5_ldap_modify_async(ldap_server_handle, dn, mods);
+    }
+    if (st != LDAP_SUCCESS) {
+        st = set_ldap_error(context, st, OP_MOD);
+        goto cleanup;
+    }
+
+    if (entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT)
+        entry->fail_auth_count++;
+
+cleanup:
+    ldap_mods_free(mods, 1);
+    krb5_ldap_put_handle_to_pool(ldap_context, ldap_server_handle);
+    free(dn);
+    return st;
+}
+
 static char *
 getstringtime(krb5_timestamp epochtime)
 {
@@ -0,0 +1,599 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/ldap_sync.c - LDAP replica cache */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The replica cache keeps a copy of the principal entries in the Kerberos
+ * container in memory, so that the KDC can look up principals without a round
+ * trip to the directory.  It is fed by an RFC 4533 content synchronization
+ * search in refreshAndPersist mode on a private connection: the server first
+ * sends every entry in scope, then sends each change as it happens.  Changes
+ * are read without blocking at the start of each lookup.  Until the initial
+ * refresh has finished, or if the search fails, lookups fall back to
+ * searching the directory.
+ *
+ * Each cached entry holds the search result message for the entry, indexed by
+ * the entryUUID from its sync state control and by each of its principal
+ * names.  Lookups decode the message in the same way as a directory search
+ * result.  Writes always go to the directory, and come back to the cache
+ * through the persistent search.
+ */
+
+#include "ldap_main.h"
+#include "ldap_err.h"
+#include "ldap_principal.h"
+#include "ldap_sync.h"
+#include <k5-hashtab.h>
+
+/* Seconds to wait before restarting a failed synchronization. */
+#define SYNC_RETRY_INTERVAL 30
+
+#define SYNC_FILTER "(|(objectclass=krbprincipalaux)(objectclass=krbprincipal))"
+
+#define TRACE_LDAP_SYNC_UPDATE(c, name)                         \
+    TRACE(c, "LDAP replica cache updated {str}", name)
+#define TRACE_LDAP_SYNC_REMOVE(c, name)                         \
+    TRACE(c, "LDAP replica cache removed {str}", name)
+#define TRACE_LDAP_SYNC_HIT(c, name)                            \
+    TRACE(c, "LDAP replica cache hit for {str}", name)
+#define TRACE_LDAP_SYNC_NOENTRY(c, name)                        \
+    TRACE(c, "LDAP replica cache has no entry for {str}", name)
+
+extern char *principal_kdc_client_attributes[];
+
+struct sync_entry {
+    char *uuid;
+    size_t uuidlen;
+    LDAPMessage *msg;
+    char **names;
+    struct sync_entry *prev;
+    struct sync_entry *next;
+};
+
+struct ldap_sync_cache {
+    k5_mutex_t lock;
+    krb5_ldap_server_handle *handle;
+    pid_t pid;
+    time_t retry_time;
+    int *msgids;                /* one search per subtree */
+    krb5_boolean *refreshed;
+    unsigned int nsearches;
+    unsigned int nrefreshing;
+    struct k5_hashtab *by_uuid;
+    struct k5_hashtab *by_name;
+    struct sync_entry *entries;
+};
+
+static void
+free_entry(struct sync_entry *e)
+{
+    ldap_msgfree(e->msg);
+    if (e->names != NULL)
+        ldap_value_free(e->names);
+    free(e->uuid);
+    free(e);
+}
+
+/* Unindex e, unlink it from the entry list, and free it. */
+static void
+remove_entry(struct ldap_sync_cache *cache, struct sync_entry *e)
+{
+    size_t i;
+
+    /* Only unindex names which refer to this entry; a name claimed by two
+     * entries is indexed to the first one added. */
+    for (i = 0; e->names != NULL && e->names[i] != NULL; i++) {
+        if (k5_hashtab_get(cache->by_name, e->names[i],
+                           strlen(e->names[i])) == e) {
+            k5_hashtab_remove(cache->by_name, e->names[i],
+                              strlen(e->names[i]));
+        }
+    }
+    k5_hashtab_remove(cache->by_uuid, e->uuid, e->uuidlen);
+
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->entries = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    free_entry(e);
+}
+
+/* Link e into the entry list and index it. */
+static krb5_error_code
+add_entry(struct ldap_sync_cache *cache, struct sync_entry *e)
+{
+    size_t i;
+    int ret;
+
+    e->prev = NULL;
+    e->next = cache->entries;
+    if (cache->entries != NULL)
+        cache->entries->prev = e;
+    cache->entries = e;
+
+    ret = k5_hashtab_add(cache->by_uuid, e->uuid, e->uuidlen, e);
+    if (ret)
+        return ret;
+    for (i = 0; e->names != NULL && e->names[i] != NULL; i++) {
+        if (k5_hashtab_get(cache->by_name, e->names[i],
+                           strlen(e->names[i])) != NULL)
+            continue;
+        ret = k5_hashtab_add(cache->by_name, e->names[i],
+                             strlen(e->names[i]), e);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+/*
+ * Discard the cache contents and close the synchronization connection.  If
+ * inherited is true, the connection belongs to a parent process; close our
+ * copy of its socket without sending anything on it, and leak the LDAP handle
+ * since freeing it would unbind the parent's connection.
+ */
+static void
+stop_sync(struct ldap_sync_cache *cache, krb5_boolean inherited)
+{
+    struct sync_entry *e, *next;
+    int fd;
+
+    for (e = cache->entries; e != NULL; e = next) {
+        next = e->next;
+        free_entry(e);
+    }
+    cache->entries = NULL;
+    k5_hashtab_free(cache->by_uuid);
+    k5_hashtab_free(cache->by_name);
+    cache->by_uuid = cache->by_name = NULL;
+
+    if (cache->handle != NULL && inherited) {
+        if (ldap_get_option(cache->handle->ldap_handle, LDAP_OPT_DESC,
+                            &fd) == LDAP_OPT_SUCCESS && fd >= 0)
+            close(fd);
+        free(cache->handle);
+    } else {
+        krb5_ldap_close_private_handle(cache->handle);
+    }
+    cache->handle = NULL;
+
+    free(cache->msgids);
+    free(cache->refreshed);
+    cache->msgids = NULL;
+    cache->refreshed = NULL;
+    cache->nsearches = cache->nrefreshing = 0;
+}
+
+/* Open a private connection and start a refreshAndPersist search of each
+ * principal subtree on it. */
+static krb5_error_code
+start_sync(krb5_context context, krb5_ldap_context *ldap_context,
+           struct ldap_sync_cache *cache)
+{
+    krb5_error_code ret;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+    char **subtree = NULL;
+    unsigned int i, ntrees = 0;
+    BerElement *ber = NULL;
+    struct berval *ctrlval = NULL;
+    LDAPControl ctrl, *ctrls[2];
+    int st;
+
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        goto cleanup;
+    ret = k5_hashtab_create(seed, 0, &cache->by_uuid);
+    if (ret)
+        goto cleanup;
+    ret = k5_hashtab_create(seed, 0, &cache->by_name);
+    if (ret)
+        goto cleanup;
+
+    ret = krb5_get_subtree_info(ldap_context, &subtree, &ntrees);
+    if (ret)
+        goto cleanup;
+    cache->msgids = k5calloc(ntrees, sizeof(*cache->msgids), &ret);
+    if (cache->msgids == NULL)
+        goto cleanup;
+    cache->refreshed = k5calloc(ntrees, sizeof(*cache->refreshed), &ret);
+    if (cache->refreshed == NULL)
+        goto cleanup;
+
+    /* The sync request control value is SEQUENCE { mode ENUMERATED }, with
+     * no cookie, so that the server sends the full content first. */
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    if (ber_printf(ber, "{e}", (ber_int_t)LDAP_SYNC_REFRESH_AND_PERSIST) ==
+        -1 || ber_flatten(ber, &ctrlval) == -1) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    ctrl.ldctl_oid = LDAP_CONTROL_SYNC;
+    ctrl.ldctl_value = *ctrlval;
+    ctrl.ldctl_iscritical = 1;
+    ctrls[0] = &ctrl;
+    ctrls[1] = NULL;
+
+    ret = krb5_ldap_open_private_handle(ldap_context, &cache->handle);
+    if (ret)
+        goto cleanup;
+    cache->pid = getpid();
+
+    for (i = 0; i < ntrees; i++) {
+        st = ldap_search_ext(cache->handle->ldap_handle, subtree[i],
+                             ldap_context->lrparams->search_scope,
+                             SYNC_FILTER, principal_kdc_client_attributes,
+                             0, ctrls,
+                             NULL, NULL, LDAP_NO_LIMIT, &cache->msgids[i]);
+        if (st != LDAP_SUCCESS) {
+            ret = set_ldap_error(context, st, OP_SEARCH);
+            goto cleanup;
+        }
+        cache->nsearches++;
+    }
+    cache->nrefreshing = cache->nsearches;
+
+cleanup:
+    if (ret)
+        stop_sync(cache, FALSE);
+    ber_free(ber, 1);
+    if (ctrlval != NULL)
+        ber_bvfree(ctrlval);
+    for (i = 0; i < ntrees; i++)
+        free(subtree[i]);
+    free(subtree);
+    return ret;
+}
+
+/* Trace each principal name of e with the update or remove message. */
+static void
+trace_entry(krb5_context context, struct sync_entry *e, krb5_boolean removed)
+{
+    size_t i;
+
+    for (i = 0; e->names != NULL && e->names[i] != NULL; i++) {
+        if (removed)
+            TRACE_LDAP_SYNC_REMOVE(context, e->names[i]);
+        else
+            TRACE_LDAP_SYNC_UPDATE(context, e->names[i]);
+    }
+}
+
+/* Apply a search result entry carrying a sync state control.  Take ownership
+ * of msg. */
+static krb5_error_code
+process_entry(krb5_context context, struct ldap_sync_cache *cache,
+              LDAPMessage *msg)
+{
+    krb5_error_code ret = 0;
+    LDAP *ld = cache->handle->ldap_handle;
+    LDAPControl **ctrls = NULL, *ctrl;
+    BerElement *ber = NULL;
+    struct berval uuid;
+    ber_int_t state;
+    struct sync_entry *e;
+
+    if (ldap_get_entry_controls(ld, msg, &ctrls) != LDAP_SUCCESS) {
+        ret = KRB5_KDB_ACCESS_ERROR;
+        goto cleanup;
+    }
+    ctrl = ldap_control_find(LDAP_CONTROL_SYNC_STATE, ctrls, NULL);
+    if (ctrl == NULL) {
+        ret = KRB5_KDB_ACCESS_ERROR;
+        goto cleanup;
+    }
+    ber = ber_init(&ctrl->ldctl_value);
+    if (ber == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    if (ber_scanf(ber, "{em", &state, &uuid) == LBER_ERROR) {
+        ret = KRB5_KDB_ACCESS_ERROR;
+        goto cleanup;
+    }
+
+    /* A present state only says that the entry is unchanged. */
+    if (state == LDAP_SYNC_PRESENT)
+        goto cleanup;
+
+    e = k5_hashtab_get(cache->by_uuid, uuid.bv_val, uuid.bv_len);
+    if (e != NULL) {
+        if (state == LDAP_SYNC_DELETE)
+            trace_entry(context, e, TRUE);
+        remove_entry(cache, e);
+    }
+    if (state == LDAP_SYNC_DELETE)
+        goto cleanup;
+
+    e = k5alloc(sizeof(*e), &ret);
+    if (e == NULL)
+        goto cleanup;
+    e->uuid = k5memdup(uuid.bv_val, uuid.bv_len, &ret);
+    if (e->uuid == NULL) {
+        free(e);
+        goto cleanup;
+    }
+    e->uuidlen = uuid.bv_len;
+    e->names = ldap_get_values(ld, msg, "krbprincipalname");
+    e->msg = msg;
+    msg = NULL;
+    ret = add_entry(cache, e);
+    if (!ret)
+        trace_entry(context, e, FALSE);
+
+cleanup:
+    ber_free(ber, 1);
+    ldap_controls_free(ctrls);
+    ldap_msgfree(msg);
+    return ret;
+}
+
+/* Note that the refresh phase has finished for the search with msgid. */
+static void
+mark_refreshed(struct ldap_sync_cache *cache, int msgid)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->nsearches; i++) {
+        if (cache->msgids[i] == msgid && !cache->refreshed[i]) {
+            cache->refreshed[i] = TRUE;
+            cache->nrefreshing--;
+        }
+    }
+}
+
+/* Apply a sync info intermediate response. */
+static krb5_error_code
+process_info(krb5_context context, struct ldap_sync_cache *cache,
+             LDAPMessage *msg)
+{
+    krb5_error_code ret = 0;
+    LDAP *ld = cache->handle->ldap_handle;
+    char *oid = NULL;
+    struct berval *data = NULL, cookie;
+    BerElement *ber = NULL;
+    BerVarray uuids = NULL;
+    ber_tag_t tag;
+    ber_len_t len;
+    ber_int_t done = 1, deletes = 0;
+    struct sync_entry *e;
+    int i;
+
+    if (ldap_parse_intermediate(ld, msg, &oid, &data, NULL, 0) !=
+        LDAP_SUCCESS)
+        return KRB5_KDB_ACCESS_ERROR;
+    if (oid == NULL || strcmp(oid, LDAP_SYNC_INFO) != 0 || data == NULL)
+        goto cleanup;
+    ber = ber_init(data);
+    if (ber == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+
+    ret = KRB5_KDB_ACCESS_ERROR;
+    tag = ber_peek_tag(ber, &len);
+    if (tag == LDAP_TAG_SYNC_REFRESH_DELETE ||
+        tag == LDAP_TAG_SYNC_REFRESH_PRESENT) {
+        /* SEQUENCE { cookie OPTIONAL, refreshDone BOOLEAN DEFAULT TRUE } */
+        if (ber_scanf(ber, "{") == LBER_ERROR)
+            goto cleanup;
+        tag = ber_peek_tag(ber, &len);
+        if (tag == LDAP_TAG_SYNC_COOKIE) {
+            if (ber_scanf(ber, "m", &cookie) == LBER_ERROR)
+                goto cleanup;
+            tag = ber_peek_tag(ber, &len);
+        }
+        if (tag == LDAP_TAG_REFRESHDONE) {
+            if (ber_scanf(ber, "b", &done) == LBER_ERROR)
+                goto cleanup;
+        }
+        if (done)
+            mark_refreshed(cache, ldap_msgid(msg));
+    } else if (tag == LDAP_TAG_SYNC_ID_SET) {
+        /* SEQUENCE { cookie OPTIONAL, refreshDeletes BOOLEAN DEFAULT FALSE,
+         *            syncUUIDs SET OF OCTET STRING }.  We never send a
+         * cookie, so only a list of deleted entries is meaningful. */
+        if (ber_scanf(ber, "{") == LBER_ERROR)
+            goto cleanup;
+        tag = ber_peek_tag(ber, &len);
+        if (tag == LDAP_TAG_SYNC_COOKIE) {
+            if (ber_scanf(ber, "m", &cookie) == LBER_ERROR)
+                goto cleanup;
+            tag = ber_peek_tag(ber, &len);
+        }
+        if (tag == LDAP_TAG_REFRESHDELETES) {
+            if (ber_scanf(ber, "b", &deletes) == LBER_ERROR)
+                goto cleanup;
+        }
+        if (ber_scanf(ber, "[W]", &uuids) == LBER_ERROR)
+            goto cleanup;
+        for (i = 0; deletes && uuids != NULL && uuids[i].bv_val != NULL;
+             i++) {
+            e = k5_hashtab_get(cache->by_uuid, uuids[i].bv_val,
+                               uuids[i].bv_len);
+            if (e != NULL) {
+                trace_entry(context, e, TRUE);
+                remove_entry(cache, e);
+            }
+        }
+    }
+    ret = 0;
+
+cleanup:
+    ber_bvarray_free(uuids);
+    ber_free(ber, 1);
+    ber_bvfree(data);
+    ldap_memfree(oid);
+    return ret;
+}
+
+/* Apply the messages which have arrived on the synchronization connection,
+ * without blocking. */
+static krb5_error_code
+poll_sync(krb5_context context, struct ldap_sync_cache *cache)
+{
+    krb5_error_code ret;
+    struct timeval zero = { 0, 0 };
+    LDAPMessage *msg;
+    int st;
+
+    for (;;) {
+        msg = NULL;
+        st = ldap_result(cache->handle->ldap_handle, LDAP_RES_ANY,
+                         LDAP_MSG_ONE, &zero, &msg);
+        if (st == 0)
+            return 0;
+        if (st == -1)
+            return KRB5_KDB_ACCESS_ERROR;
+
+        switch (st) {
+        case LDAP_RES_SEARCH_ENTRY:
+            ret = process_entry(context, cache, msg);
+            break;
+        case LDAP_RES_INTERMEDIATE:
+            ret = process_info(context, cache, msg);
+            ldap_msgfree(msg);
+            break;
+        case LDAP_RES_SEARCH_RESULT:
+            /* A persistent search only ends if the server gives up on it,
+             * such as when it requires a new refresh. */
+            ldap_msgfree(msg);
+            ret = KRB5_KDB_ACCESS_ERROR;
+            break;
+        default:
+            ldap_msgfree(msg);
+            ret = 0;
+        }
+        if (ret)
+            return ret;
+    }
+}
+
+krb5_error_code
+krb5_ldap_sync_init(krb5_ldap_context *ldap_context)
+{
+    struct ldap_sync_cache *cache;
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+        return ENOMEM;
+    if (k5_mutex_init(&cache->lock) != 0) {
+        free(cache);
+        return KRB5_KDB_SERVER_INTERNAL_ERR;
+    }
+    ldap_context->sync_cache = cache;
+    return 0;
+}
+
+void
+krb5_ldap_sync_free(krb5_ldap_context *ldap_context)
+{
+    struct ldap_sync_cache *cache = ldap_context->sync_cache;
+
+    if (cache == NULL)
+        return;
+    stop_sync(cache, cache->handle != NULL && cache->pid != getpid());
+    k5_mutex_destroy(&cache->lock);
+    free(cache);
+    ldap_context->sync_cache = NULL;
+}
+
+/*
+ * Look up the principal name user (as unparsed for LDAP) in the replica
+ * cache, after applying any pending changes.  Return KRB5_PLUGIN_NO_HANDLE if
+ * the cache is not available and the directory must be searched instead.
+ */
+krb5_error_code
+krb5_ldap_sync_lookup(krb5_context context, krb5_ldap_context *ldap_context,
+                      const char *user, krb5_const_principal searchfor,
+                      krb5_db_entry **entry_out)
+{
+    krb5_error_code ret;
+    struct ldap_sync_cache *cache = ldap_context->sync_cache;
+    struct sync_entry *e;
+
+    *entry_out = NULL;
+    if (cache == NULL)
+        return KRB5_PLUGIN_NO_HANDLE;
+
+    k5_mutex_lock(&cache->lock);
+
+    /* A process forked after the search started (such as a KDC worker) must
+     * not read from its parent's connection; start its own search. */
+    if (cache->handle != NULL && cache->pid != getpid())
+        stop_sync(cache, TRUE);
+
+    if (cache->handle == NULL) {
+        ret = KRB5_PLUGIN_NO_HANDLE;
+        if (time(NULL) < cache->retry_time)
+            goto cleanup;
+        if (start_sync(context, ldap_context, cache) != 0) {
+            krb5_clear_error_message(context);
+            cache->retry_time = time(NULL) + SYNC_RETRY_INTERVAL;
+            goto cleanup;
+        }
+    }
+
+    if (poll_sync(context, cache) != 0) {
+        stop_sync(cache, FALSE);
+        cache->retry_time = time(NULL) + SYNC_RETRY_INTERVAL;
+        ret = KRB5_PLUGIN_NO_HANDLE;
+        goto cleanup;
+    }
+    if (cache->nrefreshing > 0) {
+        ret = KRB5_PLUGIN_NO_HANDLE;
+        goto cleanup;
+    }
+
+    e = k5_hashtab_get(cache->by_name, user, strlen(user));
+    if (e == NULL) {
+        TRACE_LDAP_SYNC_NOENTRY(context, user);
+        ret = KRB5_KDB_NOENTRY;
+        goto cleanup;
+    }
+    ret = krb5_ldap_principal_from_entry(context, ldap_context,
+                                         cache->handle->ldap_handle, e->msg,
+                                         user, searchfor, entry_out);
+    if (!ret && *entry_out == NULL)
+        ret = KRB5_KDB_NOENTRY;
+    if (!ret)
+        TRACE_LDAP_SYNC_HIT(context, user);
+
+cleanup:
+    k5_mutex_unlock(&cache->lock);
+    return ret;
+}
@@ -211,7 +211,7 @@ krb5_ldap_lockout_audit(krb5_context context,
     }
 
     if (entry->mask) {
-        code = krb5_ldap_put_principal(context, entry, NULL);
+        code = krb5_ldap_put_lockout(context, entry);
         if (code != 0)
             return code;
     }
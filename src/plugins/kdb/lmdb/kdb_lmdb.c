@@ -731,8 +731,10 @@ klmdb_get_principal(krb5_context context, krb5_const_principal searchfor,
     if (ret)
         goto cleanup;
 
+    /* The KDC only uses the current keys of client principals. */
     ret = klmdb_decode_princ(context, name, strlen(name),
-                             val.mv_data, val.mv_size, entry_out);
+                             val.mv_data, val.mv_size,
+                             (flags & KRB5_KDB_FLAG_CLIENT) != 0, entry_out);
     if (ret)
         goto cleanup;
 
@@ -836,8 +838,40 @@ klmdb_delete_principal(krb5_context context, krb5_const_principal searchfor)
     return ret;
 }
 
+/* Create an entry containing only the principal name stored in key. */
 static krb5_error_code
-klmdb_iterate(krb5_context context, char *match_expr,
+decode_princ_name(krb5_context context, MDB_val *key,
+                  krb5_db_entry **entry_out)
+{
+    krb5_error_code ret;
+    krb5_db_entry *entry;
+    char *name;
+
+    *entry_out = NULL;
+    entry = k5alloc(sizeof(*entry), &ret);
+    if (entry == NULL)
+        return ret;
+    name = k5memdup0(key->mv_data, key->mv_size, &ret);
+    if (name != NULL) {
+        ret = krb5_parse_name(context, name, &entry->princ);
+        free(name);
+    }
+    if (ret) {
+        free(entry);
+        return ret;
+    }
+    *entry_out = entry;
+    return 0;
+}
+
+/*
+ * Iterate over principal entries whose names begin with the literal prefix of
+ * match_expr and (if start is not NULL) sort after start.  When iterating
+ * forwards, position the cursor at the first key which could match and stop
+ * at the first key past the prefix range.
+ */
+static krb5_error_code
+iterate_range(krb5_context context, char *match_expr, const char *start,
               krb5_error_code (*func)(void *, krb5_db_entry *), void *arg,
               krb5_flags iterflags)
 {
@@ -848,11 +882,29 @@ klmdb_iterate(krb5_context context, char *match_expr,
     MDB_cursor *cursor = NULL;
     MDB_val key, val;
     MDB_cursor_op op = (iterflags & KRB5_DB_ITER_REV) ? MDB_PREV : MDB_NEXT;
+    MDB_cursor_op curop = op;
+    size_t plen = krb5_db_glob_prefix_len(match_expr);
+    size_t slen = (start != NULL) ? strlen(start) : 0;
+    krb5_boolean inrange, seek;
     int err;
 
     if (dbc == NULL)
         return KRB5_KDB_DBNOTINITED;
 
+    seek = (op == MDB_NEXT && (plen > 0 || start != NULL));
+    if (seek) {
+        /* Seek to start if it sorts at or after the prefix. */
+        if (start != NULL &&
+            (plen == 0 || strncmp(start, match_expr, plen) >= 0)) {
+            key.mv_data = (char *)start;
+            key.mv_size = slen;
+        } else {
+            key.mv_data = match_expr;
+            key.mv_size = plen;
+        }
+        curop = MDB_SET_RANGE;
+    }
+
     err = mdb_txn_begin(dbc->env, NULL, MDB_RDONLY, &txn);
     if (err)
         goto lmdb_error;
@@ -860,16 +912,32 @@ klmdb_iterate(krb5_context context, char *match_expr,
     if (err)
         goto lmdb_error;
     for (;;) {
-        err = mdb_cursor_get(cursor, &key, &val, op);
+        err = mdb_cursor_get(cursor, &key, &val, curop);
         if (err == MDB_NOTFOUND)
             break;
         if (err)
             goto lmdb_error;
-        ret = klmdb_decode_princ(context, key.mv_data, key.mv_size,
-                                 val.mv_data, val.mv_size, &entry);
-        if (ret)
-            goto cleanup;
-        fetch_lockout(context, &key, entry);
+        curop = op;
+        inrange = (plen == 0 || (key.mv_size >= plen &&
+                                 memcmp(key.mv_data, match_expr, plen) == 0));
+        if (!inrange && seek)
+            break;
+        if (!inrange)
+            continue;
+        if (start != NULL && key.mv_size == slen &&
+            memcmp(key.mv_data, start, slen) == 0)
+            continue;
+        if (iterflags & KRB5_DB_ITER_NAMES_ONLY) {
+            ret = decode_princ_name(context, &key, &entry);
+            if (ret)
+                goto cleanup;
+        } else {
+            ret = klmdb_decode_princ(context, key.mv_data, key.mv_size,
+                                     val.mv_data, val.mv_size, FALSE, &entry);
+            if (ret)
+                goto cleanup;
+            fetch_lockout(context, &key, entry);
+        }
         ret = (*func)(arg, entry);
         krb5_db_free_principal(context, entry);
         if (ret)
@@ -886,6 +954,25 @@ cleanup:
     return ret;
 }
 
+static krb5_error_code
+klmdb_iterate(krb5_context context, char *match_expr,
+              krb5_error_code (*func)(void *, krb5_db_entry *), void *arg,
+              krb5_flags iterflags)
+{
+    return iterate_range(context, match_expr, NULL, func, arg, iterflags);
+}
+
+static krb5_error_code
+klmdb_iterate_after(krb5_context context, char *match_expr, const char *start,
+                    krb5_error_code (*func)(void *, krb5_db_entry *),
+                    void *arg, krb5_flags iterflags)
+{
+    /* LMDB keys are ordered bytewise, so a forward iteration yields names in
+     * the order this method requires. */
+    iterflags &= ~KRB5_DB_ITER_REV;
+    return iterate_range(context, match_expr, start, func, arg, iterflags);
+}
+
 krb5_error_code
 klmdb_get_policy(krb5_context context, char *name, osa_policy_ent_t *policy)
 {
@@ -1121,7 +1208,7 @@ cleanup:
 
 kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_lmdb, kdb_function_table) = {
     .maj_ver = KRB5_KDB_DAL_MAJOR_VERSION,
-    .min_ver = 0,
+    .min_ver = 1,
     .init_library = klmdb_lib_init,
     .fini_library = klmdb_lib_cleanup,
     .init_module = klmdb_open,
@@ -1139,5 +1226,6 @@ kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_lmdb, kdb_function_table) = {
     .delete_policy = klmdb_delete_policy,
     .promote_db = klmdb_promote_db,
     .check_policy_as = klmdb_check_policy_as,
-    .audit_as_req = klmdb_audit_as_req
+    .audit_as_req = klmdb_audit_as_req,
+    .iterate_after = klmdb_iterate_after
 };
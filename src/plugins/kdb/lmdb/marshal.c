@@ -162,18 +162,99 @@ get_tl_data(struct k5input *in, size_t count, krb5_tl_data **tl)
     return 0;
 }
 
+/*
+ * Read the header of a key data record from in into kd, and return the
+ * position of its first key element.  Advance in past the record.
+ */
+static krb5_error_code
+skip_key_data(struct k5input *in, krb5_key_data *kd, struct k5input *start)
+{
+    int j;
+
+    kd->key_data_ver = k5_input_get_uint16_le(in);
+    kd->key_data_kvno = k5_input_get_uint16_le(in);
+    if (kd->key_data_ver < 0 ||
+        kd->key_data_ver > KRB5_KDB_V1_KEY_DATA_ARRAY)
+        return KRB5_KDB_BAD_VERSION;
+    *start = *in;
+    for (j = 0; j < kd->key_data_ver; j++) {
+        (void)k5_input_get_uint16_le(in);
+        (void)k5_input_get_bytes(in, k5_input_get_uint16_le(in));
+    }
+    return (in->status == 0) ? 0 : KRB5_KDB_TRUNCATED_RECORD;
+}
+
+/*
+ * Decode count key data records from in into entry.  If latest_only is true,
+ * skip the records for all but the highest kvno.  The records are scanned once
+ * without allocating so that the keys of older kvnos are never copied.
+ */
+static krb5_error_code
+get_key_data(struct k5input *in, int count, krb5_boolean latest_only,
+             krb5_db_entry *entry)
+{
+    krb5_error_code ret;
+    struct k5input scan = *in, elems;
+    krb5_key_data hdr, *kd;
+    const uint8_t *contents;
+    int i, j, nkeep = 0, max_kvno = -1;
+    size_t len;
+
+    for (i = 0; i < count; i++) {
+        ret = skip_key_data(&scan, &hdr, &elems);
+        if (ret)
+            return ret;
+        if (latest_only && hdr.key_data_kvno > max_kvno) {
+            max_kvno = hdr.key_data_kvno;
+            nkeep = 0;
+        }
+        if (!latest_only || hdr.key_data_kvno == max_kvno)
+            nkeep++;
+    }
+    if (nkeep == 0)
+        return 0;
+
+    entry->key_data = k5calloc(nkeep, sizeof(*entry->key_data), &ret);
+    if (entry->key_data == NULL)
+        return ret;
+    entry->n_key_data = nkeep;
+
+    kd = entry->key_data;
+    for (i = 0; i < count; i++) {
+        (void)skip_key_data(in, &hdr, &elems);
+        if (latest_only && hdr.key_data_kvno != max_kvno)
+            continue;
+        kd->key_data_ver = hdr.key_data_ver;
+        kd->key_data_kvno = hdr.key_data_kvno;
+        for (j = 0; j < kd->key_data_ver; j++) {
+            kd->key_data_type[j] = k5_input_get_uint16_le(&elems);
+            len = kd->key_data_length[j] = k5_input_get_uint16_le(&elems);
+            contents = k5_input_get_bytes(&elems, len);
+            if (len > 0) {
+                kd->key_data_contents[j] = k5memdup(contents, len, &ret);
+                if (kd->key_data_contents[j] == NULL)
+                    return ret;
+            }
+        }
+        kd++;
+    }
+    return 0;
+}
+
+/*
+ * Decode a principal entry.  If latest_keys_only is true, only decode the key
+ * data for the highest kvno, as the KDC does for client principals.
+ */
 krb5_error_code
 klmdb_decode_princ(krb5_context context, const void *key, size_t key_len,
-                   const void *enc, size_t enc_len, krb5_db_entry **entry_out)
+                   const void *enc, size_t enc_len,
+                   krb5_boolean latest_keys_only, krb5_db_entry **entry_out)
 {
     krb5_error_code ret;
     struct k5input in;
     krb5_db_entry *entry = NULL;
     char *princname = NULL;
-    const uint8_t *contents;
-    int i, j;
-    size_t len;
-    krb5_key_data *kd;
+    int n_key_data;
 
     *entry_out = NULL;
 
@@ -195,8 +276,8 @@ klmdb_decode_princ(krb5_context context, const void *key, size_t key_len,
     entry->expiration = k5_input_get_uint32_le(&in);
     entry->pw_expiration = k5_input_get_uint32_le(&in);
     entry->n_tl_data = k5_input_get_uint16_le(&in);
-    entry->n_key_data = k5_input_get_uint16_le(&in);
-    if (entry->n_tl_data < 0 || entry->n_key_data < 0) {
+    n_key_data = (krb5_int16)k5_input_get_uint16_le(&in);
+    if (entry->n_tl_data < 0 || n_key_data < 0) {
         ret = KRB5_KDB_TRUNCATED_RECORD;
         goto cleanup;
     }
@@ -205,36 +286,9 @@ klmdb_decode_princ(krb5_context context, const void *key, size_t key_len,
     if (ret)
         goto cleanup;
 
-    if (entry->n_key_data > 0) {
-        entry->key_data = k5calloc(entry->n_key_data, sizeof(*entry->key_data),
-                                   &ret);
-        if (entry->key_data == NULL)
-            goto cleanup;
-    }
-    for (i = 0; i < entry->n_key_data; i++) {
-        kd = &entry->key_data[i];
-        kd->key_data_ver = k5_input_get_uint16_le(&in);
-        kd->key_data_kvno = k5_input_get_uint16_le(&in);
-        if (kd->key_data_ver < 0 &&
-            kd->key_data_ver > KRB5_KDB_V1_KEY_DATA_ARRAY) {
-            ret = KRB5_KDB_BAD_VERSION;
-            goto cleanup;
-        }
-        for (j = 0; j < kd->key_data_ver; j++) {
-            kd->key_data_type[j] = k5_input_get_uint16_le(&in);
-            len = kd->key_data_length[j] = k5_input_get_uint16_le(&in);
-            contents = k5_input_get_bytes(&in, len);
-            if (contents == NULL) {
-                ret = KRB5_KDB_TRUNCATED_RECORD;
-                goto cleanup;
-            }
-            if (len > 0) {
-                kd->key_data_contents[j] = k5memdup(contents, len, &ret);
-                if (kd->key_data_contents[j] == NULL)
-                    goto cleanup;
-            }
-        }
-    }
+    ret = get_key_data(&in, n_key_data, latest_keys_only, entry);
+    if (ret)
+        goto cleanup;
 
     ret = in.status;
     if (ret)
@@ -41,12 +41,49 @@
 struct k5_tls_handle_st {
     SSL *ssl;
     char *servername;
+    char *anchors_key;
 };
 
 static int ex_context_id = -1;
 static int ex_handle_id = -1;
 
+/*
+ * With OpenSSL 1.1.1 or later, we keep a process-wide cache of SSL contexts,
+ * keyed by the trust anchors they were loaded with, so that each connection
+ * does not have to reload the anchors.  For each context we also remember the
+ * last verified session for each server name, so that later connections to
+ * the same proxy can resume it instead of performing a full handshake.  Cache
+ * entries are discarded after TLS_CACHE_LIFETIME seconds, so that changes to
+ * the anchor files are eventually noticed and idle sessions are not kept
+ * forever.
+ */
+#define TLS_CACHE_LIFETIME 300
+#define TLS_CACHE_MAX_SESSIONS 16
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define CACHE_SESSIONS
+#endif
+
+struct session_entry {
+    struct session_entry *next;
+    char *servername;
+    SSL_SESSION *session;
+    time_t stored;
+};
+
+struct ctx_entry {
+    struct ctx_entry *next;
+    char *anchors_key;
+    SSL_CTX *ctx;
+    time_t created;
+    struct session_entry *sessions;
+};
+
+static k5_mutex_t cache_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct ctx_entry *ctx_cache;
+
 MAKE_INIT_FUNCTION(init_openssl);
+MAKE_FINI_FUNCTION(fini_openssl);
 
 int
 init_openssl(void)
@@ -56,7 +93,44 @@ init_openssl(void)
     OpenSSL_add_all_algorithms();
     ex_context_id = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
     ex_handle_id = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
-    return 0;
+    return k5_mutex_finish_init(&cache_lock);
+}
+
+static void
+free_session_entry(struct session_entry *sent)
+{
+    SSL_SESSION_free(sent->session);
+    free(sent->servername);
+    free(sent);
+}
+
+static void
+free_ctx_entry(struct ctx_entry *cent)
+{
+    struct session_entry *sent, *next;
+
+    for (sent = cent->sessions; sent != NULL; sent = next) {
+        next = sent->next;
+        free_session_entry(sent);
+    }
+    SSL_CTX_free(cent->ctx);
+    free(cent->anchors_key);
+    free(cent);
+}
+
+void
+fini_openssl(void)
+{
+    struct ctx_entry *cent, *next;
+
+    if (!INITIALIZER_RAN(init_openssl) || PROGRAM_EXITING())
+        return;
+    for (cent = ctx_cache; cent != NULL; cent = next) {
+        next = cent->next;
+        free_ctx_entry(cent);
+    }
+    ctx_cache = NULL;
+    k5_mutex_destroy(&cache_lock);
 }
 
 static void
@@ -428,26 +502,17 @@ load_anchors(krb5_context context, char **anchors, SSL_CTX *sctx)
     return 0;
 }
 
-static krb5_error_code
-setup(krb5_context context, SOCKET fd, const char *servername,
-      char **anchors, k5_tls_handle *handle_out)
+/* Create an SSL context which verifies servers using anchors. */
+static SSL_CTX *
+new_ssl_ctx(krb5_context context, char **anchors)
 {
-    int e;
     long options = SSL_OP_NO_SSLv2;
-    SSL_CTX *ctx = NULL;
-    SSL *ssl = NULL;
-    k5_tls_handle handle = NULL;
-
-    *handle_out = NULL;
-
-    (void)CALL_INIT_FUNCTION(init_openssl);
-    if (ex_context_id == -1 || ex_handle_id == -1)
-        return KRB5_PLUGIN_OP_NOTSUPP;
+    SSL_CTX *ctx;
 
     /* Do general SSL library setup. */
     ctx = SSL_CTX_new(SSLv23_client_method());
     if (ctx == NULL)
-        goto error;
+        return NULL;
 
 #ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
     /*
@@ -464,8 +529,224 @@ setup(krb5_context context, SOCKET fd, const char *servername,
 
     SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, verify_callback);
     X509_STORE_set_flags(SSL_CTX_get_cert_store(ctx), 0);
-    e = load_anchors(context, anchors, ctx);
-    if (e != 0)
+    if (load_anchors(context, anchors, ctx) != 0) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/* Return a string identifying the anchor list, for use as a cache key. */
+static char *
+make_anchors_key(char **anchors)
+{
+    struct k5buf buf;
+    size_t i;
+
+    /* Anchor names begin with a type prefix, so "DEFAULT" cannot collide with
+     * a list of them. */
+    if (anchors == NULL)
+        return strdup("DEFAULT");
+    k5_buf_init_dynamic(&buf);
+    for (i = 0; anchors[i] != NULL; i++)
+        k5_buf_add_fmt(&buf, "%s\n", anchors[i]);
+    return k5_buf_cstring(&buf);
+}
+
+#ifdef CACHE_SESSIONS
+
+/* Remove any expired entries from the cache.  Call with cache_lock held. */
+static void
+expire_cache(time_t now)
+{
+    struct ctx_entry **cp, *cent;
+    struct session_entry **sp, *sent;
+
+    cp = &ctx_cache;
+    while (*cp != NULL) {
+        cent = *cp;
+        if (now - cent->created >= TLS_CACHE_LIFETIME) {
+            *cp = cent->next;
+            free_ctx_entry(cent);
+            continue;
+        }
+        sp = &cent->sessions;
+        while (*sp != NULL) {
+            sent = *sp;
+            if (now - sent->stored >= TLS_CACHE_LIFETIME) {
+                *sp = sent->next;
+                free_session_entry(sent);
+            } else {
+                sp = &sent->next;
+            }
+        }
+        cp = &cent->next;
+    }
+}
+
+/* Call with cache_lock held. */
+static struct ctx_entry *
+find_ctx_entry(const char *anchors_key)
+{
+    struct ctx_entry *cent;
+
+    for (cent = ctx_cache; cent != NULL; cent = cent->next) {
+        if (strcmp(cent->anchors_key, anchors_key) == 0)
+            return cent;
+    }
+    return NULL;
+}
+
+/*
+ * Get an SSL context for anchors, creating and caching it if necessary.  If
+ * we have a resumable session for servername made with that context, set
+ * *session_out to a new reference to it.  The caller must free the returned
+ * context (and the session, if set).
+ */
+static SSL_CTX *
+get_ssl_ctx(krb5_context context, char **anchors, const char *anchors_key,
+            const char *servername, SSL_SESSION **session_out)
+{
+    struct ctx_entry *cent;
+    struct session_entry *sent;
+    SSL_CTX *ctx = NULL;
+
+    *session_out = NULL;
+
+    k5_mutex_lock(&cache_lock);
+    expire_cache(time(NULL));
+    cent = find_ctx_entry(anchors_key);
+    if (cent == NULL) {
+        cent = calloc(1, sizeof(*cent));
+        if (cent == NULL)
+            goto done;
+        cent->anchors_key = strdup(anchors_key);
+        cent->ctx = new_ssl_ctx(context, anchors);
+        if (cent->anchors_key == NULL || cent->ctx == NULL) {
+            SSL_CTX_free(cent->ctx);
+            free(cent->anchors_key);
+            free(cent);
+            goto done;
+        }
+        cent->created = time(NULL);
+        cent->next = ctx_cache;
+        ctx_cache = cent;
+    }
+
+    ctx = cent->ctx;
+    SSL_CTX_up_ref(ctx);
+    for (sent = cent->sessions; sent != NULL; sent = sent->next) {
+        if (strcmp(sent->servername, servername) == 0) {
+            SSL_SESSION_up_ref(sent->session);
+            *session_out = sent->session;
+            break;
+        }
+    }
+
+done:
+    k5_mutex_unlock(&cache_lock);
+    return ctx;
+}
+
+/*
+ * Called when the server has finished sending its response.  If handle
+ * completed a verified handshake with a resumable session, remember the
+ * session for later connections to the same server.  The peer normally closes
+ * the stream without a close_notify alert, so mark the connection as shut
+ * down; otherwise SSL_free() would treat the session as bad and make it
+ * unresumable.
+ */
+static void
+save_session(k5_tls_handle handle)
+{
+    SSL *ssl = handle->ssl;
+    SSL_SESSION *session = SSL_get_session(ssl);
+    struct ctx_entry *cent;
+    struct session_entry **sp, *sent;
+    int count;
+
+    if (session == NULL || !SSL_is_init_finished(ssl) ||
+        SSL_get_verify_result(ssl) != X509_V_OK ||
+        !SSL_SESSION_is_resumable(session))
+        return;
+    SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+
+    k5_mutex_lock(&cache_lock);
+    cent = find_ctx_entry(handle->anchors_key);
+    if (cent == NULL || cent->ctx != SSL_get_SSL_CTX(ssl))
+        goto done;
+
+    /* Remove any previous session for this server, and the least recently
+     * stored session if the list is full. */
+    count = 0;
+    sp = &cent->sessions;
+    while (*sp != NULL) {
+        sent = *sp;
+        if (strcmp(sent->servername, handle->servername) == 0 ||
+            ++count >= TLS_CACHE_MAX_SESSIONS) {
+            *sp = sent->next;
+            free_session_entry(sent);
+        } else {
+            sp = &sent->next;
+        }
+    }
+
+    sent = malloc(sizeof(*sent));
+    if (sent == NULL)
+        goto done;
+    sent->servername = strdup(handle->servername);
+    if (sent->servername == NULL) {
+        free(sent);
+        goto done;
+    }
+    SSL_SESSION_up_ref(session);
+    sent->session = session;
+    sent->stored = time(NULL);
+    sent->next = cent->sessions;
+    cent->sessions = sent;
+
+done:
+    k5_mutex_unlock(&cache_lock);
+}
+
+#else /* not CACHE_SESSIONS */
+
+static SSL_CTX *
+get_ssl_ctx(krb5_context context, char **anchors, const char *anchors_key,
+            const char *servername, SSL_SESSION **session_out)
+{
+    *session_out = NULL;
+    return new_ssl_ctx(context, anchors);
+}
+
+static void
+save_session(k5_tls_handle handle)
+{
+}
+
+#endif /* not CACHE_SESSIONS */
+
+static krb5_error_code
+setup(krb5_context context, SOCKET fd, const char *servername,
+      char **anchors, k5_tls_handle *handle_out)
+{
+    SSL_CTX *ctx = NULL;
+    SSL *ssl = NULL;
+    SSL_SESSION *session = NULL;
+    k5_tls_handle handle = NULL;
+    char *anchors_key = NULL;
+
+    *handle_out = NULL;
+
+    (void)CALL_INIT_FUNCTION(init_openssl);
+    if (ex_context_id == -1 || ex_handle_id == -1)
+        return KRB5_PLUGIN_OP_NOTSUPP;
+
+    anchors_key = make_anchors_key(anchors);
+    if (anchors_key == NULL)
+        goto error;
+    ctx = get_ssl_ctx(context, anchors, anchors_key, servername, &session);
+    if (ctx == NULL)
         goto error;
 
     ssl = SSL_new(ctx);
@@ -478,6 +759,11 @@ setup(krb5_context context, SOCKET fd, const char *servername,
     if (!SSL_set_tlsext_host_name(ssl, servername))
         goto error;
 #endif
+    if (session != NULL) {
+        TRACE_TLS_SESSION_RESUME(context, servername);
+        if (!SSL_set_session(ssl, session))
+            goto error;
+    }
     SSL_set_connect_state(ssl);
 
     /* Create a handle and allow verify_callback to access it. */
@@ -486,17 +772,21 @@ setup(krb5_context context, SOCKET fd, const char *servername,
         goto error;
 
     handle->ssl = ssl;
+    handle->anchors_key = anchors_key;
     handle->servername = strdup(servername);
     if (handle->servername == NULL)
         goto error;
     *handle_out = handle;
+    SSL_SESSION_free(session);
     SSL_CTX_free(ctx);
     return 0;
 
 error:
     flush_errors(context);
     free(handle);
+    free(anchors_key);
     SSL_free(ssl);
+    SSL_SESSION_free(session);
     SSL_CTX_free(ctx);
     return KRB5_PLUGIN_OP_NOTSUPP;
 }
@@ -512,8 +802,11 @@ write_tls(krb5_context context, k5_tls_handle handle, const void *data,
         return ERROR_TLS;
     nwritten = SSL_write(handle->ssl, data, len);
     (void)SSL_set_ex_data(handle->ssl, ex_context_id, NULL);
-    if (nwritten > 0)
+    if (nwritten > 0) {
+        if (SSL_session_reused(handle->ssl))
+            TRACE_TLS_SESSION_RESUMED(context, handle->servername);
         return DONE;
+    }
 
     e = SSL_get_error(handle->ssl, nwritten);
     if (e == SSL_ERROR_WANT_READ)
@@ -549,8 +842,10 @@ read_tls(krb5_context context, k5_tls_handle handle, void *data,
     else if (e == SSL_ERROR_WANT_WRITE)
         return WANT_WRITE;
 
-    if (e == SSL_ERROR_ZERO_RETURN || (e == SSL_ERROR_SYSCALL && nread == 0))
+    if (e == SSL_ERROR_ZERO_RETURN || (e == SSL_ERROR_SYSCALL && nread == 0)) {
+        save_session(handle);
         return DONE;
+    }
 
     flush_errors(context);
     return ERROR_TLS;
@@ -561,6 +856,7 @@ free_handle(krb5_context context, k5_tls_handle handle)
 {
     SSL_free(handle->ssl);
     free(handle->servername);
+    free(handle->anchors_key);
     free(handle);
 }
 
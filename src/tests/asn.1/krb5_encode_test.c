@@ -72,6 +72,37 @@ encoder_print_results(krb5_data *code, char *typestring, char *description)
     ktest_destroy_data(&code);
 }
 
+/* Check that encoding rep with a hole for the enc-part ciphertext, then filling
+ * it in, matches the ordinary encoding. */
+static void
+check_hole_encoding(krb5_kdc_rep *rep)
+{
+    krb5_error_code retval;
+    krb5_data *code, *hcode, ciphertext = rep->enc_part.ciphertext;
+    uint8_t *hole;
+    char hole_data;
+
+    retval = encode_krb5_as_rep(rep, &code);
+    if (retval) {
+        com_err("krb5_encode_test", retval, "while encoding as_rep");
+        exit(1);
+    }
+    rep->enc_part.ciphertext.data = &hole_data;
+    retval = k5_encode_as_rep_hole(rep, &hole_data, &hcode, &hole);
+    rep->enc_part.ciphertext = ciphertext;
+    if (retval) {
+        com_err("krb5_encode_test", retval, "while encoding as_rep hole");
+        exit(1);
+    }
+    memcpy(hole, ciphertext.data, ciphertext.length);
+    if (!data_eq(*code, *hcode)) {
+        fprintf(stderr, "as_rep hole encoding does not match\n");
+        exit(1);
+    }
+    krb5_free_data(test_context, code);
+    krb5_free_data(test_context, hcode);
+}
+
 static void
 PRS(int argc, char **argv)
 {
@@ -232,6 +263,7 @@ main(int argc, char **argv)
 
         kdcr.msg_type = KRB5_AS_REP;
         encode_run(kdcr, "as_rep", "", encode_krb5_as_rep);
+        check_hole_encoding(&kdcr);
 
         ktest_destroy_pa_data_array(&(kdcr.padata));
         encode_run(kdcr, "as_rep", "(optionals NULL)", encode_krb5_as_rep);
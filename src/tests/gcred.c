@@ -33,7 +33,7 @@
 /*
  * This program is intended to be run from a python script as:
  *
- *     gcred [-f] [-t] nametype princname
+ *     gcred [-f] [-t] nametype princname [princname ...]
  *
  * where nametype is one of "unknown", "principal", "srv-inst", and "srv-hst",
  * and princname is the name of the service principal.  gcred acquires
@@ -44,6 +44,10 @@
  *
  * The -f and -t flags set the KRB5_GC_FORWARDABLE and KRB5_GC_NO_TRANSIT_CHECK
  * options respectively.
+ *
+ * If more than one princname is given, gcred acquires credentials for all of
+ * them concurrently using krb5_tkt_creds_get_multi(), and displays the server
+ * principal name of each obtained ticket in argument order.
  */
 
 #include "k5-int.h"
@@ -63,15 +67,84 @@ check(krb5_error_code code)
     }
 }
 
+static void
+display_server(krb5_creds *creds)
+{
+    krb5_ticket *ticket;
+    char *name;
+
+    check(krb5_decode_ticket(&creds->ticket, &ticket));
+    check(krb5_unparse_name(ctx, ticket->server, &name));
+    printf("%s\n", name);
+    krb5_free_ticket(ctx, ticket);
+    krb5_free_unparsed_name(ctx, name);
+}
+
+static void
+multi_done(krb5_context context, krb5_tkt_creds_context tctx,
+           krb5_error_code code, void *data)
+{
+    int *ndone = data;
+
+    check(code);
+    (*ndone)++;
+}
+
+static void
+parse_server(const char *nametype, const char *name, krb5_principal *server)
+{
+    check(krb5_parse_name(ctx, name, server));
+    if (strcmp(nametype, "unknown") == 0)
+        (*server)->type = KRB5_NT_UNKNOWN;
+    else if (strcmp(nametype, "principal") == 0)
+        (*server)->type = KRB5_NT_PRINCIPAL;
+    else if (strcmp(nametype, "srv-inst") == 0)
+        (*server)->type = KRB5_NT_SRV_INST;
+    else if (strcmp(nametype, "srv-hst") == 0)
+        (*server)->type = KRB5_NT_SRV_HST;
+    else
+        abort();
+}
+
+/* Get credentials for each of the n server names concurrently. */
+static void
+get_multi(krb5_ccache ccache, krb5_principal client, krb5_flags options,
+          const char *nametype, char **names, int n)
+{
+    krb5_tkt_creds_context *tctxs;
+    krb5_principal server;
+    krb5_creds in_creds, creds;
+    int i, ndone = 0;
+
+    tctxs = calloc(n, sizeof(*tctxs));
+    assert(tctxs != NULL);
+    memset(&in_creds, 0, sizeof(in_creds));
+    in_creds.client = client;
+    for (i = 0; i < n; i++) {
+        parse_server(nametype, names[i], &server);
+        in_creds.server = server;
+        check(krb5_tkt_creds_init(ctx, ccache, &in_creds, options,
+                                  &tctxs[i]));
+        krb5_free_principal(ctx, server);
+    }
+    check(krb5_tkt_creds_get_multi(ctx, tctxs, n, multi_done, &ndone));
+    assert(ndone == n);
+    for (i = 0; i < n; i++) {
+        check(krb5_tkt_creds_get_creds(ctx, tctxs[i], &creds));
+        display_server(&creds);
+        krb5_free_cred_contents(ctx, &creds);
+        krb5_tkt_creds_free(ctx, tctxs[i]);
+    }
+    free(tctxs);
+}
+
 int
 main(int argc, char **argv)
 {
     krb5_principal client, server;
     krb5_ccache ccache;
     krb5_creds in_creds, *creds;
-    krb5_ticket *ticket;
     krb5_flags options = 0;
-    char *name;
     int c;
 
     check(krb5_init_context(&ctx));
@@ -90,31 +163,25 @@ main(int argc, char **argv)
     }
     argc -= optind;
     argv += optind;
-    assert(argc == 2);
-    check(krb5_parse_name(ctx, argv[1], &server));
-    if (strcmp(argv[0], "unknown") == 0)
-        server->type = KRB5_NT_UNKNOWN;
-    else if (strcmp(argv[0], "principal") == 0)
-        server->type = KRB5_NT_PRINCIPAL;
-    else if (strcmp(argv[0], "srv-inst") == 0)
-        server->type = KRB5_NT_SRV_INST;
-    else if (strcmp(argv[0], "srv-hst") == 0)
-        server->type = KRB5_NT_SRV_HST;
-    else
-        abort();
+    assert(argc >= 2);
 
     check(krb5_cc_default(ctx, &ccache));
     check(krb5_cc_get_principal(ctx, ccache, &client));
+    if (argc > 2) {
+        get_multi(ccache, client, options, argv[0], argv + 1, argc - 1);
+        krb5_free_principal(ctx, client);
+        krb5_cc_close(ctx, ccache);
+        krb5_free_context(ctx);
+        return 0;
+    }
+
+    parse_server(argv[0], argv[1], &server);
     memset(&in_creds, 0, sizeof(in_creds));
     in_creds.client = client;
     in_creds.server = server;
     check(krb5_get_credentials(ctx, options, ccache, &in_creds, &creds));
-    check(krb5_decode_ticket(&creds->ticket, &ticket));
-    check(krb5_unparse_name(ctx, ticket->server, &name));
-    printf("%s\n", name);
+    display_server(creds);
 
-    krb5_free_ticket(ctx, ticket);
-    krb5_free_unparsed_name(ctx, name);
     krb5_free_creds(ctx, creds);
     krb5_free_principal(ctx, client);
     krb5_free_principal(ctx, server);
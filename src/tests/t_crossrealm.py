@@ -85,6 +85,14 @@ msgs = ('Requesting TGT krbtgt/B.X@X using TGT krbtgt/X@X',
         'Received TGT for service realm: krbtgt/B.X@X')
 r1.run([kvno, r3.host_princ], expected_trace=msgs)
 
+# Test concurrent TGS exchanges for services in each realm.
+mark('concurrent TGS exchanges')
+r1.kinit(r1.user_princ, password('user'))
+princs = [r1.host_princ, r2.host_princ, r3.host_princ]
+out = r1.run(['./gcred', 'principal'] + princs)
+if out.splitlines() != princs:
+    fail('gcred with multiple principals')
+
 stop(r1, r2, r3)
 
 # Test client capaths.  The client in A will ask for a cross TGT to D,
@@ -51,6 +51,97 @@ for i in range(200):
     realm.run_kadmin(['addprinc', '-randkey', 'foo%d' % i])
 realm.run_kadmin(['listprincs'], expected_msg='foo199')
 
+# Test listprincs with globs whose literal prefixes let the KDB module
+# seek to the first candidate.
+mark('listprincs prefix')
+def check_listprincs(glob, expected):
+    out = realm.run([kadminl, 'listprincs', glob])
+    names = sorted(out.splitlines())
+    if names != sorted(expected):
+        fail('Unexpected listprincs output for %s: %r' % (glob, names))
+check_listprincs('foo19*', ['foo19@KRBTEST.COM'] +
+                 ['foo19%d@KRBTEST.COM' % i for i in range(10)])
+check_listprincs('foo1?', ['foo1%d@KRBTEST.COM' % i for i in range(10)])
+check_listprincs('foo5', ['foo5@KRBTEST.COM'])
+check_listprincs('foo5*@KRBTEST.COM', ['foo5@KRBTEST.COM'] +
+                 ['foo5%d@KRBTEST.COM' % i for i in range(10)])
+check_listprincs('fooz*', [])
+check_listprincs('zzz', [])
+
+# Test listprincs results spanning more than one page.  Remote
+# listings are returned in sorted order.
+mark('paged listprincs')
+pagenames = ['page%04d@KRBTEST.COM' % i for i in range(1100)]
+def add_page_princs(realm):
+    cmds = ''.join('addprinc -nokey %s\n' % n for n in pagenames)
+    realm.run([kadminl], input=cmds)
+def check_paged(realm, glob, expected):
+    out = realm.run_kadmin(['listprincs', glob])
+    if out.splitlines() != expected:
+        fail('Unexpected paged listprincs output for %s' % glob)
+add_page_princs(realm)
+check_paged(realm, 'page*', pagenames)
+check_paged(realm, 'page10*', pagenames[1000:])
+check_paged(realm, 'page*9',
+            [n for n in pagenames if n.endswith('9@KRBTEST.COM')])
+
+# Test batch mode, with more changes than are sent in one request.
+mark('batch')
+batchfile = os.path.join(realm.testdir, 'batch')
+with open(batchfile, 'w') as f:
+    f.write('# Provision some service principals.\n\n')
+    for i in range(150):
+        f.write('addprinc -randkey batch/%d\n' % i)
+    f.write('addprinc -pw "pass word" -maxlife "2 hours" batch/pw\n')
+    f.write('addprinc -nokey batch/0\n')
+    f.write('modprinc -maxlife 1h +requires_preauth batch/1\n')
+    f.write('cpw -randkey -keepold batch/2\n')
+    f.write('delprinc -force batch/3\n')
+    f.write('delprinc batch/4\n')
+    f.write('addprinc batch/nopw\n')
+    f.write('frob batch/5\n')
+    f.write('modprinc +allow_tix batch/missing\n')
+out = realm.run_kadmin(['batch', batchfile], expected_code=1)
+for msg in ('Principal or policy already exists while creating '
+            '"batch/0@KRBTEST.COM" (line 154)',
+            'line 159: invalid addprinc command',
+            'line 160: invalid frob command',
+            'Principal does not exist while reading "batch/missing" '
+            '(line 161)'):
+    if msg not in out:
+        fail('Expected batch error: ' + msg)
+realm.run([kadminl, 'getprinc', 'batch/149'],
+          expected_msg='Principal: batch/149@KRBTEST.COM')
+realm.run([kadminl, 'getprinc', 'batch/pw'],
+          expected_msg='Maximum ticket life: 0 days 02:00:00')
+realm.kinit('batch/pw', 'pass word')
+out = realm.run([kadminl, 'getprinc', 'batch/1'])
+if 'Maximum ticket life: 0 days 01:00:00' not in out or \
+   'REQUIRES_PRE_AUTH' not in out:
+    fail('batch modprinc not applied')
+realm.run([kadminl, 'getprinc', 'batch/2'], expected_msg='vno 2')
+realm.run([kadminl, 'getprinc', 'batch/3'], expected_code=1)
+realm.run([kadminl, 'getprinc', 'batch/4'], expected_code=1)
+with open(batchfile, 'w') as f:
+    for i in range(150):
+        f.write('delprinc batch/%d\n' % i)
+realm.run([kadminl, 'batch', batchfile], expected_code=1,
+          expected_msg='deleting principal "batch/3@KRBTEST.COM" (line 4)')
+realm.run([kadminl, 'getprinc', 'batch/149'], expected_code=1)
+
+# Attribute flags in a modprinc line apply on top of earlier lines in
+# the same batch.
+with open(batchfile, 'w') as f:
+    f.write('addprinc -randkey -allow_tix batch/new\n')
+    f.write('modprinc +requires_preauth batch/new\n')
+    f.write('modprinc -allow_forwardable batch/new\n')
+realm.run_kadmin(['batch', batchfile])
+out = realm.run([kadminl, 'getprinc', 'batch/new'])
+for flag in ('DISALLOW_ALL_TIX', 'REQUIRES_PRE_AUTH', 'DISALLOW_FORWARDABLE'):
+    if flag not in out:
+        fail('batch modprinc attributes lost: ' + flag)
+realm.run([kadminl, 'delprinc', 'batch/new'])
+
 # Test kadmin -k with the default principal, with and without
 # fallback.  This operation requires canonicalization against the
 # keytab in krb5_get_init_creds_keytab() as the
@@ -63,4 +154,35 @@ no_canon_conf = {'libdefaults': {'dns_canonicalize_hostname': 'false'}}
 no_canon = realm.special_env('no_canon', False, krb5_conf=no_canon_conf)
 realm.run([kadmin, '-k', 'getprinc', realm.host_princ], env=no_canon)
 
+# Serve requests from several kadmind worker processes, each of which
+# sees changes made through the others.
+mark('kadmind worker processes')
+realm.stop_kadmind()
+realm.start_kadmind(['-w', '3'])
+for i in range(6):
+    realm.run_kadmin(['addprinc', '-randkey', 'worker/%d' % i])
+for i in range(6):
+    realm.run_kadmin(['cpw', '-pw', 'pw%d' % i, 'worker/%d' % i])
+    realm.kinit('worker/%d' % i, 'pw%d' % i)
+out = realm.run_kadmin(['listprincs', 'worker/*'])
+if sorted(out.split()) != ['worker/%d@KRBTEST.COM' % i for i in range(6)]:
+    fail('Unexpected listprincs output from kadmind workers')
+with open(os.path.join(realm.testdir, 'kadmind5.log')) as f:
+    if 'creating 3 worker processes' not in f.read():
+        fail('kadmind did not create worker processes')
+
+# A hash DB2 database cannot be iterated in name order, so kadmind
+# finds each page with a full scan.
+mark('paged listprincs with hash database')
+realm.stop()
+realm = K5Realm(bdb_only=True, create_host=False)
+dumpfile = os.path.join(realm.testdir, 'dump')
+realm.run([kdb5_util, 'dump', dumpfile])
+realm.run([kdb5_util, 'load', '-hash', dumpfile])
+add_page_princs(realm)
+realm.start_kadmind()
+realm.prep_kadmin()
+check_paged(realm, 'page*', pagenames)
+check_paged(realm, 'page10*', pagenames[1000:])
+
 success('kadmin and kpasswd tests')
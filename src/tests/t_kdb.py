@@ -93,6 +93,17 @@ else:
 if slap_add('include: file://%s\n' % schema) != 0:
     skip_rest('LDAP KDB tests', 'failed to load Kerberos schema')
 
+# Enable the content synchronization provider if we can, for testing
+# the replica cache.
+slap_add('dn: cn=module,cn=config\n'
+         'objectClass: olcModuleList\n'
+         'olcModuleLoad: syncprov\n')
+have_syncprov = slap_add('dn: olcOverlay=syncprov,olcDatabase={1}%s,'
+                         'cn=config\n'
+                         'objectClass: olcOverlayConfig\n'
+                         'objectClass: olcSyncProvConfig\n'
+                         'olcOverlay: syncprov\n' % dbtype) == 0
+
 # Load the core schema if we can.
 ldap_homes = ['/etc/ldap', '/etc/openldap', '/usr/local/etc/openldap',
               '/usr/local/etc/ldap']
@@ -317,6 +328,29 @@ realm.kinit(realm.user_princ, password('user'))
 realm.run([kvno, realm.host_princ])
 realm.klist(realm.user_princ, realm.host_princ)
 
+# Lockout attributes are written asynchronously by the KDC.
+mark('LDAP lockout')
+realm.run([kadminl, 'addpol', '-maxfailure', '2', '-failurecountinterval',
+           '5m', 'lockout'])
+realm.run([kadminl, 'addprinc', '-pw', 'lockpw', '+requires_preauth',
+           '-policy', 'lockout', 'lockuser'])
+msg = 'Password incorrect while getting initial credentials'
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1,
+          expected_msg=msg)
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1,
+          expected_msg=msg)
+realm.run([kadminl, 'getprinc', 'lockuser'],
+          expected_msg='Failed password attempts: 2')
+msg = 'credentials have been revoked while getting initial credentials'
+realm.run([kinit, 'lockuser'], input='lockpw\n', expected_code=1,
+          expected_msg=msg)
+realm.run([kadminl, 'modprinc', '-unlock', 'lockuser'])
+realm.kinit('lockuser', 'lockpw')
+realm.run([kadminl, 'getprinc', 'lockuser'],
+          expected_msg='Failed password attempts: 0')
+realm.run([kadminl, 'delprinc', 'lockuser'])
+realm.run([kadminl, 'delpol', 'lockout'])
+
 mark('LDAP auth indicator')
 
 # Test require_auth normalization.
@@ -536,6 +570,59 @@ realm.run([kadminl, 'cpw', '-pw', 'password_', 'pwuser'])
 realm.run([kadminl, 'getprinc', 'pwuser'],
           expected_msg='Password expiration date: [never]')
 
+# Serve KDC lookups from the replica cache, and check that changes
+# made through the directory reach it.  The KDC traces cache hits and
+# updates, which lets us tell cache lookups apart from directory ones.
+if have_syncprov:
+    mark('LDAP replica cache')
+    realm.stop_kdc()
+    cconf = {'dbmodules': {'ldap': {'ldap_replica_cache': 'true'}}}
+    cenv = realm.special_env('replica_cache', True, kdc_conf=cconf)
+    kdc_trace = os.path.join(realm.testdir, 'kdc_trace')
+    cenv['KRB5_TRACE'] = kdc_trace
+    realm.start_kdc(env=cenv)
+
+    # Return the KDC trace output written after offset start.
+    def kdc_trace_since(start):
+        with open(kdc_trace, 'r') as f:
+            f.seek(start)
+            return f.read()
+
+    # Authenticate as princ until the KDC traces msg while doing so.
+    # The cache refreshes and applies changes only as lookups are
+    # performed, so retry a bounded number of times.
+    def wait_for_kdc_trace(princ, pw, msg):
+        for i in range(50):
+            start = os.path.getsize(kdc_trace)
+            realm.kinit(princ, pw)
+            if msg in kdc_trace_since(start):
+                return
+            time.sleep(0.1)
+        fail('Expected string not found in KDC trace: ' + msg)
+
+    realm.addprinc('cacheuser', 'cachepw')
+    cprinc = 'cacheuser@' + realm.realm
+    wait_for_kdc_trace('cacheuser', 'cachepw',
+                       'LDAP replica cache hit for ' + cprinc)
+
+    realm.run([kadminl, 'cpw', '-pw', 'newpw', 'cacheuser'])
+    wait_for_kdc_trace(realm.user_princ, password('user'),
+                       'LDAP replica cache updated ' + cprinc)
+    start = os.path.getsize(kdc_trace)
+    realm.kinit('cacheuser', 'newpw')
+    if 'LDAP replica cache hit for ' + cprinc not in kdc_trace_since(start):
+        fail('changed principal not looked up in replica cache')
+
+    realm.run([kadminl, 'delprinc', 'cacheuser'])
+    wait_for_kdc_trace(realm.user_princ, password('user'),
+                       'LDAP replica cache removed ' + cprinc)
+    start = os.path.getsize(kdc_trace)
+    realm.run([kinit, 'cacheuser'], input='newpw\n', expected_code=1,
+              expected_msg='not found in Kerberos database')
+    if 'LDAP replica cache has no entry for ' + cprinc not in \
+       kdc_trace_since(start):
+        fail('deleted principal not looked up in replica cache')
+
 realm.stop()
 
 # Test dump and load.  Include a regression test for #8882
@@ -29,4 +29,19 @@ output = realm.run([kadminl, 'modprinc', '-allow_tix', p])
 if 'Cannot lock database' in output:
     fail('krb5kdc still holds a lock on the principal db')
 
+# The KDC keeps its database handle open between requests, but must
+# see changes made by other processes, including a database promoted
+# by kdb5_util load.
+realm.run([kadminl, 'modprinc', '+allow_tix', p])
+realm.kinit(p, p)
+realm.run([kadminl, 'cpw', '-pw', 'bar', p])
+realm.kinit(p, 'bar')
+dumpfile = os.path.join(realm.testdir, 'dump')
+realm.run([kdb5_util, 'dump', dumpfile])
+realm.run([kadminl, 'cpw', '-pw', 'baz', p])
+realm.kinit(p, 'baz')
+realm.run([kdb5_util, 'load', dumpfile])
+realm.kinit(p, 'bar')
+realm.kinit(p, 'baz', expected_code=1)
+
 success('KDB locking tests')
@@ -17,5 +17,19 @@ for line in f:
 f.close()
 if not found_skew:
     fail('Did not find KDC log line for expired-ticket TGS request')
+realm.stop()
+
+# Log through the asynchronous queue with worker processes, and check
+# that each AS request is logged by the time the KDC exits.
+conf = {'logging': {'queue_size': '64'}}
+realm = K5Realm(kdc_conf=conf, start_kdc=False)
+realm.start_kdc(['-w', '2'])
+for i in range(10):
+    realm.kinit(realm.user_princ, password('user'))
+realm.stop()
+with open(os.path.join(realm.testdir, 'kdc.log'), 'r') as f:
+    nreqs = sum(1 for line in f if 'AS_REQ' in line)
+if nreqs != 10:
+    fail('Expected 10 AS_REQ log lines with queued logging, saw %d' % nreqs)
 
 success('KDC logging tests')
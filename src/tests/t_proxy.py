@@ -115,7 +115,10 @@ realm = K5Realm(krb5_conf=anchored_name_krb5_conf, start_kadmind=True,
 proxy = start_proxy(realm, proxysubjectpem)
 realm.kinit(realm.user_princ, password=password('user'))
 realm.run([kvno, realm.host_princ])
-realm.run([kpasswd, realm.user_princ], input=kpasswd_input)
+# kpasswd makes two proxied exchanges; the second should resume the
+# TLS session established by the first.
+realm.run([kpasswd, realm.user_princ], input=kpasswd_input,
+          expected_trace=('Resumed TLS session with "localhost"',))
 stop_daemon(proxy)
 realm.stop()
 
@@ -38,6 +38,32 @@ realm.run([kadminl, 'addprinc', '-pw', 'p5', '-policy', 'pol', 'p5'],
 realm.run([kadminl, 'addprinc', '-pw', 'birdsoranges', 'p6'], expected_code=1,
           expected_msg='Password may not be a pair of dictionary words')
 
+mark('compiled dictionary')
+
+# Compile a larger dictionary and check words at either end of it, a
+# case variant, and a non-word.
+words = ['word%d' % i for i in range(5000)] + ['birds', 'bees']
+with open(dictfile, 'w') as f:
+    f.write('\n'.join(words + ['bees']))
+compiled = os.path.join(realm.testdir, 'dict.compiled')
+realm.run([kdb5_util, 'compile_dict', dictfile, compiled],
+          expected_msg='5002 words written')
+cconf = {'realms': {'$realm': {'dict_file': compiled}}}
+cenv = realm.special_env('compiled', True, kdc_conf=cconf)
+realm.run([kadminl, 'modprinc', '-policy', 'pol', 'p2'])
+for pw in ('word0', 'word4999', 'BEES'):
+    realm.run([kadminl, 'cpw', '-pw', pw, 'p2'], env=cenv, expected_code=1,
+              expected_msg='Password is in the password dictionary')
+realm.run([kadminl, 'cpw', '-pw', 'word5000', 'p2'], env=cenv)
+
+# A truncated compiled dictionary is rejected.
+with open(compiled, 'rb') as f:
+    data = f.read()
+with open(compiled, 'wb') as f:
+    f.write(data[:-4])
+realm.run([kadminl, 'cpw', '-pw', 'word5000', 'p2'], env=cenv,
+          expected_code=1, expected_msg='Invalid compiled dictionary file')
+
 # These plugin ordering tests aren't specifically related to the
 # password quality interface, but are convenient to put here.
 
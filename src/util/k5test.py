@@ -287,8 +287,9 @@ Scripts may use the following realm methods and attributes:
 * realm.stop_kdc(): Stop the krb5kdc process.  Errors if no KDC is
   running.
 
-* realm.start_kadmind(env=None): Start a kadmind process.  Errors if a
-  kadmind is already running.
+* realm.start_kadmind(args=[], env=None): Start a kadmind process.
+  Errors if a kadmind is already running.  If args is given, it
+  contains a list of additional kadmind arguments.
 
 * realm.stop_kadmind(): Stop the kadmind process.  Errors if no
   kadmind is running.
@@ -1079,7 +1080,7 @@ class K5Realm(object):
         stop_daemon(self._kdc_proc)
         self._kdc_proc = None
 
-    def start_kadmind(self, env=None):
+    def start_kadmind(self, args=[], env=None):
         global krb5kdc
         if env is None:
             env = self.env
@@ -1087,7 +1088,7 @@ class K5Realm(object):
         dump_path = os.path.join(self.testdir, 'dump')
         self._kadmind_proc = _start_daemon([kadmind, '-nofork',
                                             '-p', kdb5_util, '-K', kprop,
-                                            '-F', dump_path], env,
+                                            '-F', dump_path] + args, env,
                                            'starting...')
 
     def stop_kadmind(self):